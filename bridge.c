@@ -0,0 +1,330 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bridge.h"
+
+// Returns where the frame buffer of slot i starts
+static unsigned char* bridge_frame(channel_bridge_t* bridge, size_t i)
+{
+    return bridge->frames + i * bridge->config.max_frame;
+}
+
+// Writes the rest of a stream message that sendmmsg only sent part of, starting at byte done
+static bool bridge_finish(channel_bridge_t* bridge, struct msghdr* message, size_t done)
+{
+    for (size_t i = 0; i < message->msg_iovlen; i++) {
+        struct iovec* iov = &message->msg_iov[i];
+        while (done < iov->iov_len) {
+            ssize_t written = send(bridge->fd, (unsigned char*) iov->iov_base + done, iov->iov_len - done, MSG_NOSIGNAL);
+            if (written < 0 && errno != EINTR) {
+                return false;
+            }
+            done += written > 0 ? (size_t) written : 0;
+        }
+        done -= iov->iov_len;
+    }
+    return true;
+}
+
+// Serializes count messages into frames and writes them with as few sendmmsg calls as the socket allows
+static enum channel_status bridge_send_frames(channel_bridge_t* bridge, size_t count)
+{
+    const channel_serializer_t* serializer = &bridge->config.serializer;
+    bool stream = bridge->config.framing == CHANNEL_FRAMING_LENGTH;
+    enum channel_status status = SUCCESS;
+
+    size_t framed = 0;
+    for (; framed < count; framed++) {
+        size_t size = serializer->serialize(bridge->items[framed], bridge_frame(bridge, framed), bridge->config.max_frame, serializer->ctx);
+        if (serializer->release != NULL) {
+            serializer->release(bridge->items[framed], serializer->ctx);
+        }
+        // an empty datagram could not be told apart from the end of a SOCK_SEQPACKET connection
+        if (size > bridge->config.max_frame || (size == 0 && !stream)) {
+            status = GENERIC_ERROR;
+            break;
+        }
+        bridge->lengths[framed] = (uint32_t) size;
+        struct iovec* iov = &bridge->iovecs[2 * framed];
+        iov[0].iov_base = &bridge->lengths[framed];
+        iov[0].iov_len = sizeof(uint32_t);
+        iov[1].iov_base = bridge_frame(bridge, framed);
+        iov[1].iov_len = size;
+        memset(&bridge->headers[framed], 0, sizeof(struct mmsghdr));
+        bridge->headers[framed].msg_hdr.msg_iov = stream ? iov : iov + 1;
+        bridge->headers[framed].msg_hdr.msg_iovlen = stream ? 2 : 1;
+    }
+    // the messages after a bad one were taken from the channel, so they are released unsent
+    for (size_t i = framed + 1; i < count && serializer->release != NULL; i++) {
+        serializer->release(bridge->items[i], serializer->ctx);
+    }
+
+    size_t sent = 0;
+    while (sent < framed) {
+        int result = sendmmsg(bridge->fd, bridge->headers + sent, (unsigned int) (framed - sent), MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return GENERIC_ERROR;
+        }
+        // on a stream socket the last message sendmmsg got to may be cut short, but never one before it
+        struct mmsghdr* last = &bridge->headers[sent + (size_t) result - 1];
+        size_t expected = 0;
+        for (size_t i = 0; i < last->msg_hdr.msg_iovlen; i++) {
+            expected += last->msg_hdr.msg_iov[i].iov_len;
+        }
+        if (last->msg_len < expected && (!stream || !bridge_finish(bridge, &last->msg_hdr, last->msg_len))) {
+            return GENERIC_ERROR;
+        }
+        sent += (size_t) result;
+        bridge->moved += (size_t) result;
+    }
+
+    return status;
+}
+
+// Body of a sending bridge thread
+static void* channel_bridge_send_run(void* arg)
+{
+    channel_bridge_t* bridge = (channel_bridge_t*) arg;
+    size_t received = 0;
+    enum channel_status status;
+
+    while ((status = channel_receive_batch_wait(bridge->channel, bridge->items, bridge->config.batch, &received)) == SUCCESS) {
+        status = bridge_send_frames(bridge, received);
+        if (status != SUCCESS) {
+            channel_close(bridge->channel);
+            break;
+        }
+    }
+    shutdown(bridge->fd, SHUT_WR);
+    bridge->status = status;
+
+    return NULL;
+}
+
+// Delivers count rebuilt messages to the channel, waiting for room when it is full
+static enum channel_status bridge_deliver(channel_bridge_t* bridge, size_t count)
+{
+    size_t delivered = 0;
+    enum channel_status status = SUCCESS;
+    while (delivered < count) {
+        size_t sent = 0;
+        status = channel_send_batch(bridge->channel, bridge->items + delivered, count - delivered, &sent);
+        if (status == CHANNEL_FULL) {
+            status = channel_send(bridge->channel, bridge->items[delivered]);
+            sent = status == SUCCESS ? 1 : 0;
+        }
+        if (status != SUCCESS) {
+            break;
+        }
+        delivered += sent;
+    }
+    bridge->moved += delivered;
+
+    const channel_serializer_t* serializer = &bridge->config.serializer;
+    for (size_t i = delivered; i < count && serializer->release != NULL; i++) {
+        serializer->release(bridge->items[i], serializer->ctx);
+    }
+    return status;
+}
+
+// Reads the next batch of datagrams and rebuilds their messages, returns the number of messages, 0 at the end of the stream
+static ssize_t bridge_receive_datagrams(channel_bridge_t* bridge)
+{
+    for (size_t i = 0; i < bridge->config.batch; i++) {
+        bridge->iovecs[i].iov_base = bridge_frame(bridge, i);
+        bridge->iovecs[i].iov_len = bridge->config.max_frame;
+        memset(&bridge->headers[i], 0, sizeof(struct mmsghdr));
+        bridge->headers[i].msg_hdr.msg_iov = &bridge->iovecs[i];
+        bridge->headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int result;
+    do {
+        result = recvmmsg(bridge->fd, bridge->headers, (unsigned int) bridge->config.batch, MSG_WAITFORONE, NULL);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        return -1;
+    }
+
+    const channel_serializer_t* serializer = &bridge->config.serializer;
+    size_t count = 0;
+    for (; count < (size_t) result; count++) {
+        struct mmsghdr* header = &bridge->headers[count];
+        if (header->msg_len == 0) {
+            break;
+        }
+        if (header->msg_hdr.msg_flags & MSG_TRUNC) {
+            for (size_t i = 0; i < count && serializer->release != NULL; i++) {
+                serializer->release(bridge->items[i], serializer->ctx);
+            }
+            return -1;
+        }
+        bridge->items[count] = serializer->deserialize(bridge_frame(bridge, count), header->msg_len, serializer->ctx);
+    }
+    return (ssize_t) count;
+}
+
+// Rebuilds the messages of the complete frames at the start of the stream buffer, up to a batch of them
+// Returns the number of messages, or -1 if a frame is larger than max_frame
+static ssize_t bridge_parse_stream(channel_bridge_t* bridge)
+{
+    const channel_serializer_t* serializer = &bridge->config.serializer;
+    size_t count = 0;
+    size_t offset = 0;
+    while (count < bridge->config.batch && bridge->stream_len - offset >= sizeof(uint32_t)) {
+        uint32_t length;
+        memcpy(&length, bridge->stream + offset, sizeof(uint32_t));
+        if (length > bridge->config.max_frame) {
+            for (size_t i = 0; i < count && serializer->release != NULL; i++) {
+                serializer->release(bridge->items[i], serializer->ctx);
+            }
+            return -1;
+        }
+        if (bridge->stream_len - offset - sizeof(uint32_t) < length) {
+            break;
+        }
+        bridge->items[count++] = serializer->deserialize(bridge->stream + offset + sizeof(uint32_t), length, serializer->ctx);
+        offset += sizeof(uint32_t) + length;
+    }
+    memmove(bridge->stream, bridge->stream + offset, bridge->stream_len - offset);
+    bridge->stream_len -= offset;
+    return (ssize_t) count;
+}
+
+// Rebuilds the messages of the next complete frames of the stream, reading more of it if there are none
+// Returns the number of messages, 0 at the end of the stream
+static ssize_t bridge_receive_stream(channel_bridge_t* bridge)
+{
+    // without a complete frame in it, the buffer has less than a frame and its length prefix left, so a read always has room
+    size_t capacity = bridge->config.batch * (sizeof(uint32_t) + bridge->config.max_frame);
+    ssize_t count;
+
+    while ((count = bridge_parse_stream(bridge)) == 0) {
+        ssize_t result = read(bridge->fd, bridge->stream + bridge->stream_len, capacity - bridge->stream_len);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            // a frame cut off by the end of the stream is an error
+            return result == 0 && bridge->stream_len == 0 ? 0 : -1;
+        }
+        bridge->stream_len += (size_t) result;
+    }
+    return count;
+}
+
+// Body of a receiving bridge thread
+static void* channel_bridge_receive_run(void* arg)
+{
+    channel_bridge_t* bridge = (channel_bridge_t*) arg;
+    enum channel_status status;
+
+    while (true) {
+        ssize_t count = bridge->config.framing == CHANNEL_FRAMING_LENGTH ? bridge_receive_stream(bridge) : bridge_receive_datagrams(bridge);
+        if (count < 0) {
+            status = GENERIC_ERROR;
+            channel_close_write(bridge->channel);
+            break;
+        }
+        if (count == 0) {
+            channel_close_write(bridge->channel);
+            status = CLOSED_ERROR;
+            break;
+        }
+        status = bridge_deliver(bridge, (size_t) count);
+        if (status != SUCCESS) {
+            shutdown(bridge->fd, SHUT_RD);
+            break;
+        }
+    }
+    bridge->status = status;
+
+    return NULL;
+}
+
+// Frees all the memory allocated to the bridge
+static void bridge_free(channel_bridge_t* bridge)
+{
+    free(bridge->frames);
+    free(bridge->lengths);
+    free(bridge->headers);
+    free(bridge->iovecs);
+    free(bridge->items);
+    free(bridge->stream);
+    free(bridge);
+}
+
+// Creates a bridge and starts its thread
+static channel_bridge_t* bridge_start(channel_t* channel, int fd, const channel_bridge_config_t* config, bool sending)
+{
+    const channel_serializer_t* serializer = &config->serializer;
+    if (channel->unbuffered || config->batch == 0 || config->max_frame == 0 || config->max_frame > UINT32_MAX ||
+        serializer->serialize == NULL || serializer->deserialize == NULL) {
+        return NULL;
+    }
+
+    channel_bridge_t* bridge = (channel_bridge_t*) calloc(1, sizeof(channel_bridge_t));
+    if (bridge == NULL) {
+        return NULL;
+    }
+    bridge->channel = channel;
+    bridge->fd = fd;
+    bridge->config = *config;
+    bridge->sending = sending;
+    bridge->status = SUCCESS;
+
+    size_t batch = config->batch;
+    bridge->frames = (unsigned char*) malloc(batch * config->max_frame);
+    bridge->lengths = (uint32_t*) malloc(batch * sizeof(uint32_t));
+    bridge->headers = (struct mmsghdr*) malloc(batch * sizeof(struct mmsghdr));
+    bridge->iovecs = (struct iovec*) malloc(2 * batch * sizeof(struct iovec));
+    bridge->items = (void**) malloc(batch * sizeof(void*));
+    if (!sending && config->framing == CHANNEL_FRAMING_LENGTH) {
+        bridge->stream = (unsigned char*) malloc(batch * (sizeof(uint32_t) + config->max_frame));
+    }
+    if (bridge->frames == NULL || bridge->lengths == NULL || bridge->headers == NULL || bridge->iovecs == NULL ||
+        bridge->items == NULL || (!sending && config->framing == CHANNEL_FRAMING_LENGTH && bridge->stream == NULL)) {
+        bridge_free(bridge);
+        return NULL;
+    }
+
+    if (pthread_create(&bridge->thread, NULL, sending ? channel_bridge_send_run : channel_bridge_receive_run, bridge) != 0) {
+        bridge_free(bridge);
+        return NULL;
+    }
+
+    return bridge;
+}
+
+// Starts a thread that sends the messages of the channel over the socket
+channel_bridge_t* channel_bridge_sender(channel_t* channel, int fd, const channel_bridge_config_t* config)
+{
+    return bridge_start(channel, fd, config, true);
+}
+
+// Starts a thread that sends the messages read from the socket to the channel
+channel_bridge_t* channel_bridge_receiver(channel_t* channel, int fd, const channel_bridge_config_t* config)
+{
+    return bridge_start(channel, fd, config, false);
+}
+
+// Waits for the bridge thread to stop and frees the bridge
+enum channel_status channel_bridge_stop(channel_bridge_t* bridge, size_t* moved)
+{
+    if (pthread_join(bridge->thread, NULL) != 0) {
+        return GENERIC_ERROR;
+    }
+
+    enum channel_status status = bridge->status;
+    if (moved != NULL) {
+        *moved = bridge->moved;
+    }
+    bridge_free(bridge);
+
+    return status;
+}
@@ -0,0 +1,75 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include "channel.h"
+#include "spill.h"
+
+// Defines how messages are framed on the socket of a bridge
+enum channel_framing {
+    // one message per datagram, for SOCK_SEQPACKET or SOCK_DGRAM sockets, which keep message boundaries themselves
+    CHANNEL_FRAMING_DATAGRAM,
+    // every message is preceded by its length as a uint32_t, for SOCK_STREAM sockets
+    CHANNEL_FRAMING_LENGTH,
+};
+
+// Defines how a bridge turns messages into frames and back
+typedef struct {
+    // release is called with every message once it has been sent, and with received messages that could not be delivered
+    channel_serializer_t serializer;
+    enum channel_framing framing;
+    // largest serialized message in bytes, a larger one stops the bridge
+    size_t max_frame;
+    // number of messages per sendmmsg, recvmmsg or channel batch call
+    size_t batch;
+} channel_bridge_config_t;
+
+// Defines a bridge that carries the messages of a local channel over an AF_UNIX socket
+// A sending bridge drains its channel into batches of frames written with a single sendmmsg
+// A receiving bridge reads batches of frames and delivers the rebuilt messages into its channel
+// Both ends look like a plain channel_t* to their users, with the socket possibly leading to another process
+typedef struct {
+    pthread_t thread;
+    channel_t* channel;
+    int fd;
+    channel_bridge_config_t config;
+    bool sending;
+    // batch frame buffers of max_frame bytes each, and their length prefixes
+    unsigned char* frames;
+    uint32_t* lengths;
+    struct mmsghdr* headers;
+    struct iovec* iovecs;
+    void** items;
+    // bytes of the stream framing not parsed yet
+    unsigned char* stream;
+    size_t stream_len;
+    // set by the bridge thread, read after channel_bridge_stop has joined it
+    size_t moved;
+    enum channel_status status;
+} channel_bridge_t;
+
+// Starts a thread that sends every message received from the buffered channel over the connected socket fd,
+// and returns its handle to the caller
+// The bridge runs until the channel is closed, messages left in a channel closed with channel_close_write are sent first,
+// and then shuts down the writing side of the socket, which stops the receiving bridge at the other end
+// If the socket fails, the channel is closed so that its senders do not block forever
+// Returns NULL if the channel is unbuffered, the config is incomplete, or the thread could not be started
+channel_bridge_t* channel_bridge_sender(channel_t* channel, int fd, const channel_bridge_config_t* config);
+
+// Starts a thread that sends every message read from the connected socket fd to the buffered channel,
+// and returns its handle to the caller
+// When the other end shuts down, the channel is closed with channel_close_write, so its receivers still get every message
+// If the channel is closed first, the bridge stops with the next frame that arrives
+// Returns NULL if the channel is unbuffered, the config is incomplete, or the thread could not be started
+channel_bridge_t* channel_bridge_receiver(channel_t* channel, int fd, const channel_bridge_config_t* config);
+
+// Waits for the bridge thread to stop, frees the bridge and returns the number of messages it carried in moved
+// The socket is left open for the caller to close
+// Returns CLOSED_ERROR if the bridge stopped because the channel was closed or the other end shut down, and
+// GENERIC_ERROR if it stopped on a socket, framing or serialization error
+enum channel_status channel_bridge_stop(channel_bridge_t* bridge, size_t* moved);
+
+#endif // BRIDGE_H
@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include "broadcast.h"
+
+// Creates a new broadcast channel whose ring holds at least capacity messages and returns it to the caller
+broadcast_t* broadcast_create(size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    // a power of two capacity turns the ring index into a mask
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    broadcast_t* broadcast = (broadcast_t*) aligned_alloc(BROADCAST_CACHE_LINE, sizeof(broadcast_t));
+    if (broadcast == NULL) {
+        return NULL;
+    }
+    broadcast->ring = (void**) malloc(rounded * sizeof(void*));
+    broadcast->subscribers = list_create();
+    if (broadcast->ring == NULL || broadcast->subscribers == NULL) {
+        free(broadcast->ring);
+        if (broadcast->subscribers != NULL) {
+            list_destroy(broadcast->subscribers);
+        }
+        free(broadcast);
+        return NULL;
+    }
+
+    broadcast->capacity = rounded;
+    broadcast->mask = rounded - 1;
+    atomic_init(&broadcast->published, 0);
+    broadcast->gating = 0;
+    pthread_mutex_init(&broadcast->mutex, NULL);
+    pthread_cond_init(&broadcast->cond_published, NULL);
+    pthread_cond_init(&broadcast->cond_consumed, NULL);
+    atomic_init(&broadcast->subscribers_waiting, 0);
+    atomic_init(&broadcast->producer_waiting, false);
+    atomic_init(&broadcast->is_closed, false);
+
+    return broadcast;
+}
+
+// Adds a subscriber to the broadcast channel, starting with the next message that gets published
+broadcast_subscriber_t* broadcast_subscribe(broadcast_t* broadcast)
+{
+    broadcast_subscriber_t* subscriber = (broadcast_subscriber_t*) aligned_alloc(BROADCAST_CACHE_LINE, sizeof(broadcast_subscriber_t));
+    if (subscriber == NULL) {
+        return NULL;
+    }
+    subscriber->broadcast = broadcast;
+
+    pthread_mutex_lock(&broadcast->mutex);
+
+    if (atomic_load(&broadcast->is_closed)) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        free(subscriber);
+        return NULL;
+    }
+
+    // the cursor starts at or after the producer's cached gating sequence, so that cache stays a valid lower bound
+    atomic_init(&subscriber->cursor, atomic_load(&broadcast->published));
+    subscriber->node = list_insert(broadcast->subscribers, subscriber);
+
+    pthread_mutex_unlock(&broadcast->mutex);
+
+    if (subscriber->node == NULL) {
+        free(subscriber);
+        return NULL;
+    }
+
+    return subscriber;
+}
+
+// Removes the subscriber from its broadcast channel and frees it
+void broadcast_unsubscribe(broadcast_subscriber_t* subscriber)
+{
+    broadcast_t* broadcast = subscriber->broadcast;
+
+    pthread_mutex_lock(&broadcast->mutex);
+
+    list_remove(broadcast->subscribers, subscriber->node);
+
+    // the producer may have been waiting for this subscriber
+    pthread_cond_broadcast(&broadcast->cond_consumed);
+
+    pthread_mutex_unlock(&broadcast->mutex);
+
+    free(subscriber);
+}
+
+// Returns the lowest cursor of all subscribers, or next if there are none
+// Must be called with the mutex held
+size_t broadcast_slowest_cursor(broadcast_t* broadcast, size_t next)
+{
+    size_t slowest = next;
+    for (list_node_t* node = list_head(broadcast->subscribers); node != NULL; node = list_next(node)) {
+        size_t cursor = atomic_load(&((broadcast_subscriber_t*) list_data(node))->cursor);
+        if (cursor < slowest) {
+            slowest = cursor;
+        }
+    }
+    return slowest;
+}
+
+// Shared implementation of broadcast_publish and broadcast_non_blocking_publish
+enum channel_status broadcast_publish_from(broadcast_t* broadcast, void* data, bool block)
+{
+    if (atomic_load(&broadcast->is_closed)) {
+        return CLOSED_ERROR;
+    }
+
+    // only the producer writes published, so it can read it without ordering
+    size_t sequence = atomic_load_explicit(&broadcast->published, memory_order_relaxed);
+
+    // the cached gating sequence is only refreshed when the ring looks full, so the common case never touches the subscribers
+    if (sequence - broadcast->gating >= broadcast->capacity) {
+        pthread_mutex_lock(&broadcast->mutex);
+        broadcast->gating = broadcast_slowest_cursor(broadcast, sequence);
+        if (sequence - broadcast->gating >= broadcast->capacity) {
+            if (!block) {
+                pthread_mutex_unlock(&broadcast->mutex);
+                return CHANNEL_FULL;
+            }
+            // announce the wait before re-reading the cursors, a subscriber that advances afterwards sees the flag and wakes us
+            atomic_store(&broadcast->producer_waiting, true);
+            while (sequence - (broadcast->gating = broadcast_slowest_cursor(broadcast, sequence)) >= broadcast->capacity && !atomic_load(&broadcast->is_closed)) {
+                pthread_cond_wait(&broadcast->cond_consumed, &broadcast->mutex);
+            }
+            atomic_store(&broadcast->producer_waiting, false);
+        }
+        pthread_mutex_unlock(&broadcast->mutex);
+
+        if (atomic_load(&broadcast->is_closed)) {
+            return CLOSED_ERROR;
+        }
+    }
+
+    broadcast->ring[sequence & broadcast->mask] = data;
+    atomic_store(&broadcast->published, sequence + 1);
+
+    // only pay for the lock and the wakeup when some subscriber is actually waiting
+    if (atomic_load(&broadcast->subscribers_waiting) > 0) {
+        pthread_mutex_lock(&broadcast->mutex);
+        pthread_cond_broadcast(&broadcast->cond_published);
+        pthread_mutex_unlock(&broadcast->mutex);
+    }
+
+    return SUCCESS;
+}
+
+// Publishes data to every current subscriber, waiting for the slowest subscriber if the ring is full
+enum channel_status broadcast_publish(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish_from(broadcast, data, true);
+}
+
+// Publishes data to every current subscriber, returning CHANNEL_FULL if the ring is full
+enum channel_status broadcast_non_blocking_publish(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish_from(broadcast, data, false);
+}
+
+// Shared implementation of broadcast_receive and broadcast_non_blocking_receive
+enum channel_status broadcast_receive_from(broadcast_subscriber_t* subscriber, void** data, bool block)
+{
+    broadcast_t* broadcast = subscriber->broadcast;
+
+    // only this subscriber writes its cursor
+    size_t cursor = atomic_load_explicit(&subscriber->cursor, memory_order_relaxed);
+
+    if (atomic_load(&broadcast->published) == cursor) {
+        if (!block) {
+            return atomic_load(&broadcast->is_closed) ? CLOSED_ERROR : CHANNEL_EMPTY;
+        }
+
+        pthread_mutex_lock(&broadcast->mutex);
+        // announce the wait before re-reading published, a publish that happens afterwards sees the count and wakes us
+        atomic_fetch_add(&broadcast->subscribers_waiting, 1);
+        while (atomic_load(&broadcast->published) == cursor && !atomic_load(&broadcast->is_closed)) {
+            pthread_cond_wait(&broadcast->cond_published, &broadcast->mutex);
+        }
+        atomic_fetch_sub(&broadcast->subscribers_waiting, 1);
+        pthread_mutex_unlock(&broadcast->mutex);
+
+        if (atomic_load(&broadcast->published) == cursor) {
+            return CLOSED_ERROR;
+        }
+    }
+
+    *data = broadcast->ring[cursor & broadcast->mask];
+
+    // releasing the slot lets the producer overwrite it
+    atomic_store(&subscriber->cursor, cursor + 1);
+
+    if (atomic_load(&broadcast->producer_waiting)) {
+        pthread_mutex_lock(&broadcast->mutex);
+        pthread_cond_broadcast(&broadcast->cond_consumed);
+        pthread_mutex_unlock(&broadcast->mutex);
+    }
+
+    return SUCCESS;
+}
+
+// Reads the next message for the given subscriber, waiting until one is published
+enum channel_status broadcast_receive(broadcast_subscriber_t* subscriber, void** data)
+{
+    return broadcast_receive_from(subscriber, data, true);
+}
+
+// Reads the next message for the given subscriber, returning CHANNEL_EMPTY if none is published
+enum channel_status broadcast_non_blocking_receive(broadcast_subscriber_t* subscriber, void** data)
+{
+    return broadcast_receive_from(subscriber, data, false);
+}
+
+// Closes the broadcast channel and wakes up every waiting producer and subscriber
+enum channel_status broadcast_close(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->mutex);
+
+    if (atomic_load(&broadcast->is_closed)) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        return CLOSED_ERROR;
+    }
+    atomic_store(&broadcast->is_closed, true);
+
+    pthread_cond_broadcast(&broadcast->cond_published);
+    pthread_cond_broadcast(&broadcast->cond_consumed);
+
+    pthread_mutex_unlock(&broadcast->mutex);
+
+    return SUCCESS;
+}
+
+// Frees all the memory allocated to the broadcast channel, including subscribers that were not unsubscribed
+enum channel_status broadcast_destroy(broadcast_t* broadcast)
+{
+    if (!atomic_load(&broadcast->is_closed)) {
+        return DESTROY_ERROR;
+    }
+
+    for (list_node_t* node = list_head(broadcast->subscribers); node != NULL; node = list_next(node)) {
+        free(list_data(node));
+    }
+    list_destroy(broadcast->subscribers);
+    pthread_cond_destroy(&broadcast->cond_published);
+    pthread_cond_destroy(&broadcast->cond_consumed);
+    pthread_mutex_destroy(&broadcast->mutex);
+    free(broadcast->ring);
+    free(broadcast);
+
+    return SUCCESS;
+}
@@ -0,0 +1,87 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "channel.h"
+#include "linked_list.h"
+
+#define BROADCAST_CACHE_LINE 64
+
+// Defines a broadcast channel: every message is written once into a shared ring and read by every subscriber
+// Each subscriber advances its own cursor, and the producer only waits when the slowest subscriber is a full ring behind
+typedef struct {
+    void** ring;
+    size_t capacity;
+    size_t mask;
+    // next sequence number to publish, messages [0, published) are visible to subscribers
+    _Alignas(BROADCAST_CACHE_LINE) atomic_size_t published;
+    // lowest subscriber cursor seen by the producer, only the producer reads or writes it
+    size_t gating;
+    // protects the subscriber list and is held by waiting threads
+    _Alignas(BROADCAST_CACHE_LINE) pthread_mutex_t mutex;
+    pthread_cond_t cond_published;
+    pthread_cond_t cond_consumed;
+    list_t* subscribers;
+    atomic_size_t subscribers_waiting;
+    atomic_bool producer_waiting;
+    atomic_bool is_closed;
+} broadcast_t;
+
+// Defines a subscriber of a broadcast channel
+// A subscriber must only be used by one thread at a time
+typedef struct {
+    // next sequence number this subscriber reads, kept on its own cache line since the producer reads it
+    _Alignas(BROADCAST_CACHE_LINE) atomic_size_t cursor;
+    broadcast_t* broadcast;
+    list_node_t* node;
+} broadcast_subscriber_t;
+
+// Creates a new broadcast channel whose ring holds at least capacity messages and returns it to the caller
+// The capacity is rounded up to a power of two, a capacity of 0 is not supported
+broadcast_t* broadcast_create(size_t capacity);
+
+// Adds a subscriber to the broadcast channel, which can be done while messages are being published
+// The subscriber receives every message published after this call, starting with the next one
+// Returns NULL if the broadcast channel is closed or on an allocation failure
+broadcast_subscriber_t* broadcast_subscribe(broadcast_t* broadcast);
+
+// Removes the subscriber from its broadcast channel and frees it
+// Messages the subscriber has not read yet no longer hold back the producer
+void broadcast_unsubscribe(broadcast_subscriber_t* subscriber);
+
+// Publishes data to every current subscriber
+// There must be a single producer, i.e. publish must not be called from several threads at once
+// This is a blocking call that waits while the slowest subscriber still has a full ring of unread messages
+// Returns SUCCESS if the message was published,
+// CLOSED_ERROR if the broadcast channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status broadcast_publish(broadcast_t* broadcast, void* data);
+
+// Same as broadcast_publish, except that it returns CHANNEL_FULL instead of waiting for the slowest subscriber
+enum channel_status broadcast_non_blocking_publish(broadcast_t* broadcast, void* data);
+
+// Reads the next message for the given subscriber and stores it in data
+// This is a blocking call that waits until a message is published
+// Messages published before the broadcast channel was closed are still read, after that CLOSED_ERROR is returned
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the broadcast channel is closed and the subscriber has read every message, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status broadcast_receive(broadcast_subscriber_t* subscriber, void** data);
+
+// Same as broadcast_receive, except that it returns CHANNEL_EMPTY instead of waiting for a message
+enum channel_status broadcast_non_blocking_receive(broadcast_subscriber_t* subscriber, void** data);
+
+// Closes the broadcast channel, which should be done by the producer after its last publish
+// Subscribers can still read what was published, and then get CLOSED_ERROR
+// Returns SUCCESS if close is successful and CLOSED_ERROR if the broadcast channel is already closed
+enum channel_status broadcast_close(broadcast_t* broadcast);
+
+// Frees all the memory allocated to the broadcast channel, including subscribers that were not unsubscribed
+// The caller is responsible for calling broadcast_close and waiting for all threads to finish before calling broadcast_destroy
+// Returns SUCCESS if destroy is successful and DESTROY_ERROR if the broadcast channel is still open
+enum channel_status broadcast_destroy(broadcast_t* broadcast);
+
+#endif // BROADCAST_H
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "buffer.h"
 
 // Creates a buffer with the given capacity
@@ -5,13 +6,134 @@ buffer_t* buffer_create(size_t capacity)
 {
     buffer_t* buffer = (buffer_t*) malloc(sizeof(buffer_t));
     void** data  = (void**) malloc(capacity * sizeof(void*));
+    buffer_init(buffer, data, capacity);
+    return buffer;
+}
+
+// Initializes a buffer in place over data, an array of capacity values that the caller owns
+void buffer_init(buffer_t* buffer, void** data, size_t capacity)
+{
     buffer->size = 0;
     buffer->next = 0;
     buffer->capacity = capacity;
     buffer->data = data;
+    buffer->keys = NULL;
+}
+
+// Grows the buffer to capacity values over data, which starts with a copy of the buffer's current array
+void buffer_grow(buffer_t* buffer, void** data, size_t capacity)
+{
+    // values that wrapped around to the front of the old array stay where they are, and the older ones at its end move to the end of the new one
+    size_t head = buffer->capacity - buffer->next;
+    if (buffer->size > head) {
+        memmove(data + capacity - head, data + buffer->next, head * sizeof(void*));
+        buffer->next = capacity - head;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+// Creates a buffer with the given capacity that also tracks a key for every value
+buffer_t* buffer_create_keyed(size_t capacity)
+{
+    buffer_t* buffer = buffer_create(capacity);
+    buffer_track_keys(buffer);
     return buffer;
 }
 
+// The index of a keyed buffer follows its keys in the same allocation
+// It has the smallest power of two of entries that is at least twice the capacity, so probe sequences stay short
+// Every entry holds a slot + 1 of a value queued with a key, 0 marks a free entry
+static size_t index_entries(size_t capacity)
+{
+    if (capacity <= 1) {
+        return 2;
+    }
+    return (size_t)1 << (sizeof(unsigned long) * 8 - (size_t)__builtin_clzl(2 * capacity - 1));
+}
+
+static size_t* key_index(buffer_t* buffer)
+{
+    return (size_t*)(buffer->keys + buffer->capacity);
+}
+
+// Makes an empty buffer track a key for every value
+enum buffer_status buffer_track_keys(buffer_t* buffer)
+{
+    size_t entries = index_entries(buffer->capacity);
+    buffer->keys = (buffer_key_t*) malloc(buffer->capacity * sizeof(buffer_key_t) + entries * sizeof(size_t));
+    if (buffer->keys == NULL) {
+        return BUFFER_ERROR;
+    }
+    memset(key_index(buffer), 0, entries * sizeof(size_t));
+    return BUFFER_SUCCESS;
+}
+
+// Frees the keys of a buffer that tracks them
+void buffer_free_keys(buffer_t* buffer)
+{
+    free(buffer->keys);
+    buffer->keys = NULL;
+}
+
+// Returns the number of bytes used to track the keys
+size_t buffer_keys_size(buffer_t* buffer)
+{
+    if (buffer->keys == NULL) {
+        return 0;
+    }
+    return buffer->capacity * sizeof(buffer_key_t) + index_entries(buffer->capacity) * sizeof(size_t);
+}
+
+// Returns the index entry a key is looked up from first
+static size_t key_home(size_t key, size_t mask)
+{
+    // Fibonacci hashing spreads sequential keys over the whole index
+    return (size_t)((key * 11400714819323198485ull) >> 32) & mask;
+}
+
+// Returns the index entry that holds the slot of the key, or a free entry if the key is not queued
+static size_t key_find(buffer_t* buffer, size_t key)
+{
+    size_t* index = key_index(buffer);
+    size_t mask = index_entries(buffer->capacity) - 1;
+    size_t entry = key_home(key, mask);
+    while (index[entry] != 0 && buffer->keys[index[entry] - 1].key != key) {
+        entry = (entry + 1) & mask;
+    }
+    return entry;
+}
+
+// Removes the key queued in slot pos from the index, if the value there was added with a key
+// The entries after it in the same probe run are shifted back, so lookups never need tombstones
+static void key_forget(buffer_t* buffer, size_t pos)
+{
+    if (!buffer->keys[pos].valid) {
+        return;
+    }
+    buffer->keys[pos].valid = false;
+    size_t* index = key_index(buffer);
+    size_t mask = index_entries(buffer->capacity) - 1;
+    size_t hole = key_find(buffer, buffer->keys[pos].key);
+    if (index[hole] != pos + 1) {
+        return;
+    }
+    size_t entry = hole;
+    while (true) {
+        entry = (entry + 1) & mask;
+        if (index[entry] == 0) {
+            break;
+        }
+        // an entry may move back into the hole only if the hole lies between its home and where it is now
+        size_t home = key_home(buffer->keys[index[entry] - 1].key, mask);
+        if (((entry - home) & mask) >= ((entry - hole) & mask)) {
+            index[hole] = index[entry];
+            hole = entry;
+        }
+    }
+    index[hole] = 0;
+}
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
@@ -25,7 +147,11 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data)
         pos -= buffer->capacity;
     }
     buffer->data[pos] = data;
-    buffer->size++;
+    if (buffer->keys != NULL) {
+        buffer->keys[pos].valid = false;
+    }
+    // size is also read without the channel lock by buffer_current_size_relaxed, so it is stored atomically
+    __atomic_store_n(&buffer->size, buffer->size + 1, __ATOMIC_RELAXED);
     return BUFFER_SUCCESS;
 }
 
@@ -36,7 +162,10 @@ enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 {
     if (buffer->size > 0) {
         *data = buffer->data[buffer->next];
-        buffer->size--;
+        if (buffer->keys != NULL) {
+            key_forget(buffer, buffer->next);
+        }
+        __atomic_store_n(&buffer->size, buffer->size - 1, __ATOMIC_RELAXED);
         buffer->next++;
         if (buffer->next >= buffer->capacity) {
             buffer->next -= buffer->capacity;
@@ -46,9 +175,152 @@ enum buffer_status buffer_remove(buffer_t* buffer, void **data)
     return BUFFER_ERROR;
 }
 
+// Adds the value into a keyed buffer under the given key
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status buffer_add_keyed(buffer_t* buffer, size_t key, void* data)
+{
+    if (buffer->size >= buffer->capacity) {
+        return BUFFER_ERROR;
+    }
+    size_t pos = buffer->next + buffer->size;
+    if (pos >= buffer->capacity) {
+        pos -= buffer->capacity;
+    }
+    buffer->data[pos] = data;
+    buffer->keys[pos].key = key;
+    buffer->keys[pos].valid = true;
+    // a key that is already queued keeps pointing at its first value
+    size_t entry = key_find(buffer, key);
+    if (key_index(buffer)[entry] == 0) {
+        key_index(buffer)[entry] = pos + 1;
+    }
+    __atomic_store_n(&buffer->size, buffer->size + 1, __ATOMIC_RELAXED);
+    return BUFFER_SUCCESS;
+}
+
+// Replaces the value of a keyed buffer that is queued under the given key, keeping its position in FIFO order
+// The slot is looked up in the index, so the cost does not depend on how many values are queued
+// Returns BUFFER_SUCCESS if a value was replaced
+// Returns BUFFER_ERROR if no value is queued under the key
+enum buffer_status buffer_replace_keyed(buffer_t* buffer, size_t key, void* data, void** displaced)
+{
+    size_t entry = key_find(buffer, key);
+    if (key_index(buffer)[entry] == 0) {
+        return BUFFER_ERROR;
+    }
+    size_t pos = key_index(buffer)[entry] - 1;
+    *displaced = buffer->data[pos];
+    buffer->data[pos] = data;
+    return BUFFER_SUCCESS;
+}
+
+// Adds up to count values from items into the buffer in FIFO order
+// The values are copied in at most two contiguous segments, one up to the end of the array and one from its start
+// Returns the number of values that were added, which is less than count if the buffer ran out of space
+size_t buffer_add_bulk(buffer_t* buffer, void** items, size_t count)
+{
+    size_t free_slots = buffer->capacity - buffer->size;
+    if (count > free_slots) {
+        count = free_slots;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    size_t pos = buffer->next + buffer->size;
+    if (pos >= buffer->capacity) {
+        pos -= buffer->capacity;
+    }
+    size_t first = buffer->capacity - pos;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(&buffer->data[pos], items, first * sizeof(void*));
+    memcpy(buffer->data, &items[first], (count - first) * sizeof(void*));
+    if (buffer->keys != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            buffer->keys[(pos + i) % buffer->capacity].valid = false;
+        }
+    }
+    __atomic_store_n(&buffer->size, buffer->size + count, __ATOMIC_RELAXED);
+    return count;
+}
+
+// Removes up to max values from the buffer in FIFO order and stores them in out
+// The values are copied in at most two contiguous segments, one up to the end of the array and one from its start
+// Returns the number of values that were removed
+size_t buffer_remove_bulk(buffer_t* buffer, void** out, size_t max)
+{
+    size_t count = (max < buffer->size) ? max : buffer->size;
+    if (count == 0) {
+        return 0;
+    }
+    size_t first = buffer->capacity - buffer->next;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(out, &buffer->data[buffer->next], first * sizeof(void*));
+    memcpy(&out[first], buffer->data, (count - first) * sizeof(void*));
+    if (buffer->keys != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            key_forget(buffer, (buffer->next + i) % buffer->capacity);
+        }
+    }
+    buffer->next += count;
+    if (buffer->next >= buffer->capacity) {
+        buffer->next -= buffer->capacity;
+    }
+    __atomic_store_n(&buffer->size, buffer->size - count, __ATOMIC_RELAXED);
+    return count;
+}
+
+// Moves up to max values from the front of src to the back of dst in FIFO order
+// The values are copied ring to ring in contiguous segments, each ending where either array wraps around, so there are at most three
+// Returns the number of values that were moved
+size_t buffer_move(buffer_t* dst, buffer_t* src, size_t max)
+{
+    size_t count = buffer_current_size(src);
+    size_t room = dst->capacity - dst->size;
+    count = (count < max) ? count : max;
+    count = (count < room) ? count : room;
+    size_t from = src->next;
+    size_t to = dst->next + dst->size;
+    if (to >= dst->capacity) {
+        to -= dst->capacity;
+    }
+    for (size_t left = count; left > 0; ) {
+        size_t segment = left;
+        segment = (segment < src->capacity - from) ? segment : src->capacity - from;
+        segment = (segment < dst->capacity - to) ? segment : dst->capacity - to;
+        memcpy(&dst->data[to], &src->data[from], segment * sizeof(void*));
+        for (size_t i = 0; i < segment; i++) {
+            if (src->keys != NULL) {
+                key_forget(src, from + i);
+            }
+            if (dst->keys != NULL) {
+                dst->keys[to + i].valid = false;
+            }
+        }
+        left -= segment;
+        from += segment;
+        if (from >= src->capacity) {
+            from = 0;
+        }
+        to += segment;
+        if (to >= dst->capacity) {
+            to = 0;
+        }
+    }
+    src->next = from;
+    __atomic_store_n(&src->size, src->size - count, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->size, dst->size + count, __ATOMIC_RELAXED);
+    return count;
+}
+
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t *buffer)
 {
+    buffer_free_keys(buffer);
     free(buffer->data);
     free(buffer);
 }
@@ -65,6 +337,13 @@ size_t buffer_current_size(buffer_t* buffer)
     return buffer->size;
 }
 
+// Returns the current number of elements in the buffer without requiring the caller to hold the buffer's lock
+// The value may already be stale when it is returned, so it is only suitable as a hint
+size_t buffer_current_size_relaxed(buffer_t* buffer)
+{
+    return __atomic_load_n(&buffer->size, __ATOMIC_RELAXED);
+}
+
 // Peeks at a value in the buffer
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index)
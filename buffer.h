@@ -2,12 +2,23 @@
 #define BUFFER_H
 
 #include <stdlib.h>
+#include <stdbool.h>
+
+// Key of a buffered value, only tracked by buffers made with buffer_create_keyed
+typedef struct {
+    size_t key;
+    // false for values added without a key, which are never replaced
+    bool valid;
+} buffer_key_t;
 
 typedef struct {
     size_t size;
     size_t next;
     size_t capacity;
     void** data;
+    // Parallel to data, or NULL if the buffer does not track keys
+    // The same allocation continues with an open addressing index from the queued keys to their slot in data (see buffer.c)
+    buffer_key_t* keys;
 } buffer_t;
 
 enum buffer_status {
@@ -18,6 +29,28 @@ enum buffer_status {
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity);
 
+// Initializes a buffer in place over data, an array of capacity values that the caller owns
+// Such a buffer must not be given to buffer_free
+void buffer_init(buffer_t* buffer, void** data, size_t capacity);
+
+// Grows the buffer to capacity values over data, an array that starts with a copy of the buffer's current array (e.g. after realloc)
+// The values keep their FIFO order, capacity must not be smaller than the current capacity, and keyed buffers cannot grow
+void buffer_grow(buffer_t* buffer, void** data, size_t capacity);
+
+// Creates a buffer with the given capacity that also tracks a key for every value
+buffer_t* buffer_create_keyed(size_t capacity);
+
+// Makes an empty buffer track a key for every value, e.g. a buffer set up with buffer_init
+// Returns BUFFER_SUCCESS if the keys and their index were allocated
+// Returns BUFFER_ERROR otherwise
+enum buffer_status buffer_track_keys(buffer_t* buffer);
+
+// Frees the keys of a buffer that tracks them, the buffer itself is left to its owner
+void buffer_free_keys(buffer_t* buffer);
+
+// Returns the number of bytes used to track the keys, 0 if the buffer does not track them
+size_t buffer_keys_size(buffer_t* buffer);
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
@@ -28,6 +61,30 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data);
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void** data);
 
+// Adds the value into a keyed buffer under the given key
+// A key should only be queued once, buffer_replace_keyed finds the value that was queued under it first
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status buffer_add_keyed(buffer_t* buffer, size_t key, void* data);
+
+// Replaces the value of a keyed buffer that is queued under the given key, keeping its position in FIFO order
+// The value that was replaced is stored in displaced
+// Returns BUFFER_SUCCESS if a value was replaced
+// Returns BUFFER_ERROR if no value is queued under the key
+enum buffer_status buffer_replace_keyed(buffer_t* buffer, size_t key, void* data, void** displaced);
+
+// Adds up to count values from items into the buffer in FIFO order
+// Returns the number of values that were added, which is less than count if the buffer ran out of space
+size_t buffer_add_bulk(buffer_t* buffer, void** items, size_t count);
+
+// Removes up to max values from the buffer in FIFO order and stores them in out
+// Returns the number of values that were removed
+size_t buffer_remove_bulk(buffer_t* buffer, void** out, size_t max);
+
+// Moves up to max values from the front of src to the back of dst in FIFO order
+// Returns the number of values that were moved, which is limited by the values in src and the room in dst
+size_t buffer_move(buffer_t* dst, buffer_t* src, size_t max);
+
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t* buffer);
 
@@ -37,6 +94,10 @@ size_t buffer_capacity(buffer_t* buffer);
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer);
 
+// Returns the current number of elements in the buffer without requiring the caller to hold the buffer's lock
+// The value may already be stale when it is returned, so it is only suitable as a hint
+size_t buffer_current_size_relaxed(buffer_t* buffer);
+
 // Peeks at a value in the buffer
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index);
@@ -1,4 +1,9 @@
+#define _GNU_SOURCE
+#include <errno.h>
 #include "channel.h"
+#include "fast_rand.h"
+#include "placement.h"
+#include "slab.h"
 
 #define UNBUFFERED 1
 #define BUFFERED 0
@@ -6,53 +11,213 @@
 #define UNBUFFERED_RECEIVE 1
 #define NO_UNBUFFERED_OPERATION -1
 
-// Creates a new channel with the provided size and returns it to the caller
-channel_t* channel_create(size_t size)
+// Defines the single allocation behind a channel: the channel, its buffer and its ring, in that order
+typedef struct {
+    channel_t channel;
+    buffer_t buffer;
+    void* ring[];
+} channel_block_t;
+
+// Defines what a select registers in the select lists of its channels
+typedef struct {
+    sem_t semaphore;
+    // set while the select waits for a partner in an unbuffered rendezvous, so no other operation starts one against it meanwhile
+    bool busy;
+} select_waiter_t;
+
+// Returns the size of the allocation behind a channel of the given size
+size_t channel_block_size(size_t size)
 {
-    /* IMPLEMENT THIS */
+    return sizeof(channel_block_t) + size * sizeof(void*);
+}
+
+// Frees waiter state created by channel_waiters
+void channel_waiters_free(channel_waiters_t* waiters)
+{
+    pthread_cond_destroy(&waiters->cond_full);
+    pthread_cond_destroy(&waiters->cond_empty);
+    pthread_cond_destroy(&waiters->cond_waiting_stage);
+    pthread_cond_destroy(&waiters->cond_completed_stage);
+    pthread_mutex_destroy(&waiters->select_mutex);
+    list_clear(&waiters->semaphore_select_list_send);
+    list_clear(&waiters->semaphore_select_list_recv);
+    free(waiters);
+}
+
+// Returns the channel's waiter state, creating it on first use
+// Creation is lock-free, so it is safe with or without the channel's mutex held, and a thread that loses the race uses the winner's state
+channel_waiters_t* channel_waiters(channel_t* channel)
+{
+    channel_waiters_t* waiters = __atomic_load_n(&channel->waiters, __ATOMIC_ACQUIRE);
+    if (waiters != NULL)
+    {
+        return waiters;
+    }
+
+    waiters = (channel_waiters_t*) malloc(sizeof(channel_waiters_t));
+    if (waiters == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&waiters->select_mutex, NULL);
+    pthread_cond_init(&waiters->cond_full, NULL);
+    pthread_cond_init(&waiters->cond_empty, NULL);
+    pthread_cond_init(&waiters->cond_waiting_stage, NULL);
+    pthread_cond_init(&waiters->cond_completed_stage, NULL);
+    list_init(&waiters->semaphore_select_list_send);
+    list_init(&waiters->semaphore_select_list_recv);
+    waiters->unbuffered_operation = NO_UNBUFFERED_OPERATION;
+    waiters->unbuffered_stage = 0;
+    waiters->data = NULL;
+    waiters->producer = NULL;
+    waiters->send_waiting = 0;
+    waiters->recv_waiting = 0;
+
+    channel_waiters_t* expected = NULL;
+    if (!__atomic_compare_exchange_n(&channel->waiters, &expected, waiters, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        channel_waiters_free(waiters);
+        return expected;
+    }
+    return waiters;
+}
 
-    channel_t* channel = (channel_t*) malloc(sizeof(channel_t));
+// Returns the channel's waiter state, or NULL if no thread has needed it yet
+// A thread that waits or selects on the channel creates the state before it checks the channel under its mutex, so NULL means there is nobody to wake
+channel_waiters_t* channel_waiters_created(channel_t* channel)
+{
+    return __atomic_load_n(&channel->waiters, __ATOMIC_ACQUIRE);
+}
+
+// Initializes a channel of the given size in block, over ring, or over the ring in the block if ring is NULL
+// Returns false if the channel could not be initialized
+bool init_channel(channel_block_t* block, size_t size, void** ring)
+{
+    channel_t* channel = &block->channel;
     
     pthread_mutex_init(&channel->mutex, NULL);
-    pthread_mutex_init(&channel->select_mutex, NULL);
-    pthread_cond_init(&channel->cond_full, NULL);
-    pthread_cond_init(&channel->cond_empty, NULL);
-    pthread_cond_init(&channel->cond_waiting_stage, NULL);
-    pthread_cond_init(&channel->cond_completed_stage, NULL);
 
     channel->is_closed = false;
-    channel->semaphore_select_list_send = list_create();
-    channel->semaphore_select_list_recv = list_create();
-    channel->unbuffered_operation = NO_UNBUFFERED_OPERATION;
-    channel->unbuffered_stage = 0;
+    channel->write_closed = false;
+    channel->on_node = false;
+    channel->senders = 1;
+    channel->receivers = 1;
     channel->unbuffered = (size == 0) ? UNBUFFERED : BUFFERED;
+    channel->buffer = NULL;
+    channel->waiters = NULL;
     if (!channel->unbuffered){
-        channel->buffer = buffer_create(size);
+        buffer_init(&block->buffer, ring == NULL ? block->ring : ring, size);
+        channel->buffer = &block->buffer;
+    }
+    else
+    {
+        // every unbuffered operation goes through the waiter state, so there is nothing to save by deferring it
+        if (channel_waiters(channel) == NULL)
+        {
+            pthread_mutex_destroy(&channel->mutex);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Creates a channel of the given size over ring, or over a ring in the channel's own block if ring is NULL
+channel_t* create_channel(size_t size, void** ring)
+{
+    size_t block_size = channel_block_size(ring == NULL ? size : 0);
+    channel_block_t* block = (channel_block_t*) slab_alloc(block_size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    if (!init_channel(block, size, ring))
+    {
+        slab_free(block, block_size);
+        return NULL;
+    }
+
+    return &block->channel;
+}
+
+// Returns true if the channel's ring is a mapping of its own rather than part of the channel's block
+bool ring_mapped(channel_t* channel)
+{
+    return !channel->unbuffered && channel->buffer->data != ((channel_block_t*) channel)->ring;
+}
+
+// Creates a new channel with the provided size and returns it to the caller
+// Everything the channel needs comes from one block of the calling thread's slab, so creating and destroying channels rarely reaches malloc
+channel_t* channel_create(size_t size)
+{
+    /* IMPLEMENT THIS */
+
+    return create_channel(size, NULL);
+}
+
+// Creates a new buffered channel whose ring is an anonymous mapping and returns it to the caller
+channel_t* channel_create_mapped(size_t size, int flags)
+{
+    if (size == 0)
+    {
+        return NULL;
     }
-    channel->data = NULL;
 
-    channel->send_waiting = 0;
-    channel->recv_waiting = 0;
+    void** ring = ring_map(size, flags);
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    channel_t* channel = create_channel(size, ring);
+    if (channel == NULL)
+    {
+        ring_unmap(ring, size);
+        return NULL;
+    }
 
     return channel;
 }
 
+// Creates a new channel whose block, ring included, is placed on the given NUMA node and returns it to the caller
+channel_t* channel_create_on_node(size_t size, int node)
+{
+    channel_block_t* block = (channel_block_t*) placement_map(channel_block_size(size), node);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    if (!init_channel(block, size, NULL))
+    {
+        placement_unmap(block, channel_block_size(size));
+        return NULL;
+    }
+    block->channel.on_node = true;
+
+    return &block->channel;
+}
+
 // Signal all the semaphores in the select list with only send operations
 // This function is called whenever receive operation is successful
 // This function is also called when the channel is closed
 void signal_semaphore_select_send(channel_t* channel)
 {
-    pthread_mutex_lock(&channel->select_mutex);
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&waiters->select_mutex);
 
-    list_node_t* node = list_head(channel->semaphore_select_list_send);
+    list_node_t* node = list_head(&waiters->semaphore_select_list_send);
 
     while (node != NULL)
     {
-        sem_post((sem_t*)node->data);
+        sem_post(&((select_waiter_t*)node->data)->semaphore);
         node = node->next;
     }
         
-    pthread_mutex_unlock(&channel->select_mutex);
+    pthread_mutex_unlock(&waiters->select_mutex);
 }
 
 // Signal all the semaphores in the select list with only receieve operations
@@ -60,119 +225,253 @@ void signal_semaphore_select_send(channel_t* channel)
 // This function is also called when the channel is closed
 void signal_semaphore_select_recv(channel_t* channel)
 {
-    pthread_mutex_lock(&channel->select_mutex);
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters == NULL)
+    {
+        return;
+    }
 
-    list_node_t* node = list_head(channel->semaphore_select_list_recv);
+    pthread_mutex_lock(&waiters->select_mutex);
+
+    list_node_t* node = list_head(&waiters->semaphore_select_list_recv);
 
     while (node != NULL)
     {
-        sem_post((sem_t*)node->data);
+        sem_post(&((select_waiter_t*)node->data)->semaphore);
         node = node->next;
     }
         
-    pthread_mutex_unlock(&channel->select_mutex);
+    pthread_mutex_unlock(&waiters->select_mutex);
+}
+
+// Wakes up receivers after count messages were added to a buffered channel
+// The whole batch is announced with one select signal and one condition variable call
+void wake_receivers(channel_t* channel, size_t count)
+{
+    signal_semaphore_select_recv(channel);
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters == NULL)
+    {
+        return;
+    }
+    if (count == 1)
+    {
+        pthread_cond_signal(&waiters->cond_empty);
+    }
+    else
+    {
+        pthread_cond_broadcast(&waiters->cond_empty);
+    }
+}
+
+// Wakes up senders after count messages were removed from a buffered channel
+// The whole batch is announced with one select signal and one condition variable call
+void wake_senders(channel_t* channel, size_t count)
+{
+    signal_semaphore_select_send(channel);
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters == NULL)
+    {
+        return;
+    }
+    if (count == 1)
+    {
+        pthread_cond_signal(&waiters->cond_full);
+    }
+    else
+    {
+        pthread_cond_broadcast(&waiters->cond_full);
+    }
+}
+
+// Waits on the condition variable with the channel mutex held
+// If deadline is NULL the wait is unbounded, otherwise it ends at the absolute CLOCK_MONOTONIC deadline
+// The clock based waits used here and in select_from are deliberately left out of NOT_ALLOWED, see the Makefile
+// Returns false if the deadline passed
+bool wait_until(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* deadline)
+{
+    if (deadline == NULL)
+    {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_clockwait(cond, mutex, CLOCK_MONOTONIC, deadline) != ETIMEDOUT;
+}
+
+// Called whenever an unbuffered operation stops waiting in stage 2 or 3
+// A non-blocking operation of the opposite kind may be waiting for this operation to reach stage 1, so it has to re-check
+void unbuffered_waiter_left(channel_t* channel, int operation)
+{
+    if (operation == UNBUFFERED_SEND && channel->waiters->send_waiting == 0)
+    {
+        pthread_cond_broadcast(&channel->waiters->cond_empty);
+    }
+    else if (operation == UNBUFFERED_RECEIVE && channel->waiters->recv_waiting == 0)
+    {
+        pthread_cond_broadcast(&channel->waiters->cond_full);
+    }
+}
+
+// Checks if a select other than self waits on the channel for the given unbuffered operation
+// With idle set, a select that is busy waiting for a partner of its own does not count, since it cannot take part in a rendezvous now
+// Must be called with the channel's mutex held
+bool waiting_in_select(channel_t* channel, int operation, select_waiter_t* self, bool idle)
+{
+    list_t* list = operation == UNBUFFERED_SEND ? &channel->waiters->semaphore_select_list_send : &channel->waiters->semaphore_select_list_recv;
+    bool found = false;
+
+    pthread_mutex_lock(&channel->waiters->select_mutex);
+
+    for (list_node_t* node = list_head(list); node != NULL && !found; node = node->next)
+    {
+        select_waiter_t* waiter = (select_waiter_t*)node->data;
+        found = waiter != self && !(idle && __atomic_load_n(&waiter->busy, __ATOMIC_SEQ_CST));
+    }
+
+    pthread_mutex_unlock(&channel->waiters->select_mutex);
+
+    return found;
 }
 
 // synchronize the unbuffered operation between a send and a receive operation
 // This function is called by channel_send and channel_receive
-// This function is also called by channel_non_blocking_send and channel_non_blocking_receive but only when there is an opposite operation waiting in stage 1
+// This function is also called by channel_non_blocking_send, channel_non_blocking_receive and channel_select but only when there is an opposite operation waiting in stage 1
 // or when there is an opposite operation semaphore waiting in select list
-enum channel_status unbuffered_sync(channel_t* channel, int operation, void** data)
+// A tentative operation only waits in stage 1 for as long as a select other than self could still take part: if every such select picks another case
+// or gives up, it withdraws and returns CHANNEL_FULL (send) or CHANNEL_EMPTY (receive)
+// A send with a producer (a SEND_LAZY select case) only builds its message after a receiver has committed to the rendezvous in stage 2,
+// while that receiver waits for it, so nothing is produced for an offer that is withdrawn
+// If deadline is not NULL the operation gives up with TIMEOUT at that absolute CLOCK_MONOTONIC time, and withdraws its stage 1 state if no partner took it
+// The channel mutex must be held by the caller and is always released before returning
+enum channel_status unbuffered_sync(channel_t* channel, int operation, void** data, select_producer_t* producer, const struct timespec* deadline, bool tentative, select_waiter_t* self)
 {
     stage0:
+
+    // a closed channel never starts a new rendezvous, this also catches waiters woken up by channel_close
+    if (channel->is_closed)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
     
     // stage 1: the first stage of the unbuffered operation where the operation is initiated
-    if (channel->unbuffered_stage == 0)
+    if (channel->waiters->unbuffered_stage == 0)
     {
 
         /* IMPLEMENT THIS */
-        channel->unbuffered_stage = 1;
-        channel->unbuffered_operation = operation;
+        channel->waiters->unbuffered_stage = 1;
+        channel->waiters->unbuffered_operation = operation;
 
         //this data is used to store the data to be sent or received in the second stage of the unbuffered operation
-        channel->data = data;
+        channel->waiters->data = data;
+        channel->waiters->producer = producer;
 
         // signal the semaphore of the opposite operation in select list that the operation is initiated
         // signal the non-blocking operation that the opposite operation is available to proceed
         if (operation == UNBUFFERED_SEND)
         {
             signal_semaphore_select_recv(channel);
-            pthread_cond_broadcast(&channel->cond_empty);
+            pthread_cond_broadcast(&channel->waiters->cond_empty);
         }
         else if (operation == UNBUFFERED_RECEIVE)
         {
             signal_semaphore_select_send(channel);
-            pthread_cond_broadcast(&channel->cond_full);
+            pthread_cond_broadcast(&channel->waiters->cond_full);
         }
 
-        //this condition is just used to block the thread until the second stage operation is completed    
-        pthread_cond_wait(&channel->cond_completed_stage, &channel->mutex); 
+        //this condition is just used to block the thread until the second stage operation is completed
+        //the partner moves the channel to stage 2, anything else that ends the wait (spurious wakeup, close, deadline, the last select partner leaving) leaves it in stage 1
+        int partner = operation == UNBUFFERED_SEND ? UNBUFFERED_RECEIVE : UNBUFFERED_SEND;
+        bool in_time = true;
+        while (channel->waiters->unbuffered_stage == 1 && !channel->is_closed && in_time && (!tentative || waiting_in_select(channel, partner, self, false)))
+        {
+            in_time = wait_until(&channel->waiters->cond_completed_stage, &channel->mutex, deadline);
+        }
+
+        enum channel_status status = SUCCESS;
+
+        // no partner took part in the operation, so withdraw it before the channel is handed to the next operation
+        if (channel->waiters->unbuffered_stage == 1)
+        {
+            channel->waiters->unbuffered_operation = NO_UNBUFFERED_OPERATION;
+            channel->waiters->data = NULL;
+            channel->waiters->producer = NULL;
+            status = channel->is_closed ? CLOSED_ERROR : !in_time ? TIMEOUT : operation == UNBUFFERED_SEND ? CHANNEL_FULL : CHANNEL_EMPTY;
+        }
+        // the receiver is committed and waits for the message, which is only built now, into the place it left in data
+        else if (producer != NULL)
+        {
+            producer->produced = producer->produce(producer->ctx);
+            *channel->waiters->data = producer->produced;
+            channel->waiters->producer = NULL;
+            pthread_cond_broadcast(&channel->waiters->cond_completed_stage);
+        }
 
-        channel->unbuffered_stage = 0;
+        channel->waiters->unbuffered_stage = 0;
 
         // signal the operations waiting in stage 2 that the operation is completed and they can proceed with stage 1 again
-        pthread_cond_broadcast(&channel->cond_waiting_stage);
+        // selects skip a channel while a rendezvous is in progress on it, so they rescan as well
+        pthread_cond_broadcast(&channel->waiters->cond_waiting_stage);
+        signal_semaphore_select_send(channel);
+        signal_semaphore_select_recv(channel);
 
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
             return GENERIC_ERROR;
         }
         
-        return SUCCESS;
+        return status;
 
     }
     // stage 2: the second stage of the unbuffered operation where the operation is completed when one operation is already waiting to be completed
-    else if(channel->unbuffered_stage == 1)
+    else if(channel->waiters->unbuffered_stage == 1)
     {   
         /* IMPLEMENT THIS */
 
         // if the operation is the same as the operation that is already waiting to be completed that means it has to wait
-        if(channel->unbuffered_operation == operation)
+        if(channel->waiters->unbuffered_operation == operation)
         {
-
-            if(operation == UNBUFFERED_SEND)
-            {
-                channel->send_waiting++;
-            }
-            else if(operation == UNBUFFERED_RECEIVE)
-            {
-                channel->recv_waiting++;
-            }
-
-            // this condition is just used to block the thread until the compatible first stage operation is completed
-            pthread_cond_wait(&channel->cond_waiting_stage, &channel->mutex);
-
-            if(operation == UNBUFFERED_SEND)
-            {
-                channel->send_waiting--;
-            }
-            else if(operation == UNBUFFERED_RECEIVE)
-            {
-                channel->recv_waiting--;
-            }
-
-            // go to stage 0 again
-            goto stage0;
+            goto wait_stage;
         }
 
         // if the operation is different from the operation that is already waiting to be completed that means it has to complete the operation
-        if (channel->unbuffered_operation != operation)
+        if (channel->waiters->unbuffered_operation != operation)
         {
-            if (operation == UNBUFFERED_RECEIVE)
+            if (operation == UNBUFFERED_RECEIVE && channel->waiters->producer != NULL)
+            {
+                // a lazy sender builds its message only now that this receiver is committed, so it gets the place to put it and this receiver waits
+                // the channel may already carry the next rendezvous by the time this receiver wakes up, so it only waits while its own place is still pending
+                channel->waiters->data = data;
+                channel->waiters->unbuffered_stage = 2;
+                pthread_cond_broadcast(&channel->waiters->cond_completed_stage);
+                while (channel->waiters->data == data && channel->waiters->producer != NULL)
+                {
+                    pthread_cond_wait(&channel->waiters->cond_completed_stage, &channel->mutex);
+                }
+                if(pthread_mutex_unlock(&channel->mutex) != 0)
+                {
+                    return GENERIC_ERROR;
+                }
+                return SUCCESS;
+            }
+            else if (operation == UNBUFFERED_RECEIVE)
             {
-                *data = *channel->data;
+                *data = *channel->waiters->data;
 
             }
             else if (operation == UNBUFFERED_SEND)
             {   
-                *channel->data = *data;
+                *channel->waiters->data = *data;
             }
         }
 
         // this is a preventive measure to avoid any operation interfering with stage 1 or 2 while other operation is still in progress
         // this will allow any interfering operation to go directly to wait stage 3 if it interfered between cond_full is signaled and stage 1 grabs the locks again
-        channel->unbuffered_stage = 2;
-        pthread_cond_signal(&channel->cond_completed_stage);
+        channel->waiters->unbuffered_stage = 2;
+        pthread_cond_signal(&channel->waiters->cond_completed_stage);
 
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
@@ -183,43 +482,62 @@ enum channel_status unbuffered_sync(channel_t* channel, int operation, void** da
         
     }
     // stage 3: the third stage of the unbuffered operation where the operation is waiting for existing operation to complete
-    else if(channel->unbuffered_stage == 2){
+    else if(channel->waiters->unbuffered_stage == 2)
+    {
+        goto wait_stage;
+    }
 
-        if(operation == UNBUFFERED_SEND)
-        {
-            channel->send_waiting++;
-        }
-        else if(operation == UNBUFFERED_RECEIVE)
-        {
-            channel->recv_waiting++;
-        }
+    return GENERIC_ERROR;
 
-        // this condition is just used to block the thread until the compatible first stage operation is completed
-        pthread_cond_wait(&channel->cond_waiting_stage, &channel->mutex); 
+    // the operation waits here in stage 2 or 3 without touching the stage state, so it can simply leave if the deadline passes
+    wait_stage:
 
-        if(operation == UNBUFFERED_SEND)
-        {
-            channel->send_waiting--;
-        }
-        else if(operation == UNBUFFERED_RECEIVE)
+    if(operation == UNBUFFERED_SEND)
+    {
+        channel->waiters->send_waiting++;
+    }
+    else if(operation == UNBUFFERED_RECEIVE)
+    {
+        channel->waiters->recv_waiting++;
+    }
+
+    // this condition is just used to block the thread until the compatible first stage operation is completed
+    bool in_time = wait_until(&channel->waiters->cond_waiting_stage, &channel->mutex, deadline);
+
+    if(operation == UNBUFFERED_SEND)
+    {
+        channel->waiters->send_waiting--;
+    }
+    else if(operation == UNBUFFERED_RECEIVE)
+    {
+        channel->waiters->recv_waiting--;
+    }
+    unbuffered_waiter_left(channel, operation);
+
+    if (!in_time)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
-            channel->recv_waiting--;
+            return GENERIC_ERROR;
         }
+        return TIMEOUT;
+    }
 
-        // go to stage 0 again
-        goto stage0;
+    // go to stage 0 again
+    goto stage0;
 }
 
-    return GENERIC_ERROR;
+// Returns true if receive operations on the channel should return CLOSED_ERROR
+// A channel closed by channel_close_write still hands out its buffered messages until it is empty
+// Must be called with the channel's mutex held
+bool closed_for_receive(channel_t* channel)
+{
+    return channel->is_closed && !(channel->write_closed && !channel->unbuffered && buffer_current_size(channel->buffer) > 0);
 }
 
-// Writes data to the given channel
-// This is a blocking call i.e., the function only returns on a successful completion of send
-// In case the channel is full or no opposite unbuffered operation is waiting, the function waits till the channel has space to write the new data
-// Returns SUCCESS for successfully writing data to the channel or successfully completing the unbuffered operation,
-// CLOSED_ERROR if the channel is closed, and
-// GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_send(channel_t *channel, void* data)
+// Shared implementation of channel_send and channel_send_until
+// If deadline is NULL the call blocks until the data is written, otherwise it gives up with TIMEOUT at the absolute CLOCK_MONOTONIC deadline
+enum channel_status blocking_send(channel_t* channel, void* data, const struct timespec* deadline)
 {
     if(pthread_mutex_lock(&channel->mutex) != 0)
     {
@@ -238,7 +556,7 @@ enum channel_status channel_send(channel_t *channel, void* data)
     // if the channel is unbuffered
     if(channel->unbuffered)
     {
-        enum channel_status status = unbuffered_sync(channel, UNBUFFERED_SEND, &data);
+        enum channel_status status = unbuffered_sync(channel, UNBUFFERED_SEND, &data, NULL, deadline, false, NULL);
 
         return status;
     }
@@ -248,17 +566,25 @@ enum channel_status channel_send(channel_t *channel, void* data)
     {
         /* IMPLEMENT THIS */
 
+        // a timed out wait still retries the add once, since the wakeup may have raced with the deadline
+        bool in_time = true;
+        channel_waiters_t* waiters = NULL;
         while(buffer_add(channel->buffer, data) == BUFFER_ERROR)
         {
-            if (channel->is_closed)
+            if (channel->is_closed || !in_time)
             {
                 if(pthread_mutex_unlock(&channel->mutex) != 0)
                 {
                     return GENERIC_ERROR;
                 }
-                return CLOSED_ERROR;
+                return channel->is_closed ? CLOSED_ERROR : TIMEOUT;
+            }
+            if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+            {
+                pthread_mutex_unlock(&channel->mutex);
+                return GENERIC_ERROR;
             }
-            pthread_cond_wait(&channel->cond_full, &channel->mutex);
+            in_time = wait_until(&waiters->cond_full, &channel->mutex, deadline);
         }
 
         if(pthread_mutex_unlock(&channel->mutex) != 0)
@@ -266,8 +592,7 @@ enum channel_status channel_send(channel_t *channel, void* data)
             return GENERIC_ERROR;
         }
 
-        signal_semaphore_select_recv(channel);
-        pthread_cond_signal(&channel->cond_empty);
+        wake_receivers(channel, 1);
         
         return SUCCESS;
     }
@@ -275,22 +600,16 @@ enum channel_status channel_send(channel_t *channel, void* data)
 
 }
 
-// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
-// This is a blocking call i.e., the function only returns on a successful completion of receive
-// In case the channel is empty or no opposite unbuffered operation is waiting, the function waits till the channel has some data to read
-// Returns SUCCESS for successful retrieval of data or successfully completing the unbuffered operation,
-// CLOSED_ERROR if the channel is closed, and
-// GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_receive(channel_t* channel, void** data)
+// Shared implementation of channel_receive and channel_receive_until
+// If deadline is NULL the call blocks until data is read, otherwise it gives up with TIMEOUT at the absolute CLOCK_MONOTONIC deadline
+enum channel_status blocking_receive(channel_t* channel, void** data, const struct timespec* deadline)
 {
-    /* IMPLEMENT THIS */
-
     if(pthread_mutex_lock(&channel->mutex) != 0)
     {
         return GENERIC_ERROR;
     }
 
-    if(channel->is_closed)
+    if(closed_for_receive(channel))
     {
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
@@ -302,7 +621,7 @@ enum channel_status channel_receive(channel_t* channel, void** data)
     // if the channel is unbuffered
     if(channel->unbuffered)
     {
-        enum channel_status status = unbuffered_sync(channel, UNBUFFERED_RECEIVE, data);
+        enum channel_status status = unbuffered_sync(channel, UNBUFFERED_RECEIVE, data, NULL, deadline, false, NULL);
 
         return status;
 
@@ -312,19 +631,28 @@ enum channel_status channel_receive(channel_t* channel, void** data)
     else
     {
         /* IMPLEMENT THIS */
+
+        // a timed out wait still retries the remove once, since the wakeup may have raced with the deadline
+        bool in_time = true;
+        channel_waiters_t* waiters = NULL;
         while(buffer_remove(channel->buffer, data) == BUFFER_ERROR)
         {
 
-            if (channel->is_closed)
+            if (channel->is_closed || !in_time)
             {
                 if(pthread_mutex_unlock(&channel->mutex) != 0)
                 {
                     return GENERIC_ERROR;
                 }
-                return CLOSED_ERROR;
+                return channel->is_closed ? CLOSED_ERROR : TIMEOUT;
             }
 
-            pthread_cond_wait(&channel->cond_empty, &channel->mutex);
+            if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+            {
+                pthread_mutex_unlock(&channel->mutex);
+                return GENERIC_ERROR;
+            }
+            in_time = wait_until(&waiters->cond_empty, &channel->mutex, deadline);
         }
 
         if(pthread_mutex_unlock(&channel->mutex) != 0)
@@ -332,8 +660,7 @@ enum channel_status channel_receive(channel_t* channel, void** data)
             return GENERIC_ERROR;
         }
 
-        signal_semaphore_select_send(channel);
-        pthread_cond_signal(&channel->cond_full);
+        wake_senders(channel, 1);
 
         return SUCCESS;
     }
@@ -341,75 +668,172 @@ enum channel_status channel_receive(channel_t* channel, void** data)
 
 }
 
-// Checks if there is a send operation waiting in the select list
-bool send_waiting_in_select(channel_t* channel)
+// Writes data to the given channel
+// This is a blocking call i.e., the function only returns on a successful completion of send
+// In case the channel is full or no opposite unbuffered operation is waiting, the function waits till the channel has space to write the new data
+// Returns SUCCESS for successfully writing data to the channel or successfully completing the unbuffered operation,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send(channel_t *channel, void* data)
+{
+    return blocking_send(channel, data, NULL);
+}
+
+// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
+// This is a blocking call i.e., the function only returns on a successful completion of receive
+// In case the channel is empty or no opposite unbuffered operation is waiting, the function waits till the channel has some data to read
+// Returns SUCCESS for successful retrieval of data or successfully completing the unbuffered operation,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive(channel_t* channel, void** data)
 {
-    pthread_mutex_lock(&channel->select_mutex);
+    /* IMPLEMENT THIS */
+
+    return blocking_receive(channel, data, NULL);
+}
 
-    if(list_count(channel->semaphore_select_list_send) > 0)
+// Writes data to the given channel, waiting at most until the absolute CLOCK_MONOTONIC deadline
+// Returns TIMEOUT if the data could not be written before the deadline
+// For an unbuffered channel a timed out send withdraws its pending rendezvous, so the data is never delivered afterwards
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline)
+{
+    if (deadline == NULL)
     {
-        pthread_mutex_unlock(&channel->select_mutex);
-        return true;
+        return GENERIC_ERROR;
     }
 
-    pthread_mutex_unlock(&channel->select_mutex);
-
-    return false;
+    return blocking_send(channel, data, deadline);
 }
 
-// Checks if there is a send operation waiting in the select list
-bool recv_waiting_in_select(channel_t* channel)
+// Reads data from the given channel, waiting at most until the absolute CLOCK_MONOTONIC deadline
+// Returns TIMEOUT if no data could be read before the deadline, in which case data is not modified
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline)
 {
-    pthread_mutex_lock(&channel->select_mutex);
-
-    if(list_count(channel->semaphore_select_list_recv) > 0)
+    if (deadline == NULL)
     {
-        pthread_mutex_unlock(&channel->select_mutex);
-        return true;
+        return GENERIC_ERROR;
     }
 
-    pthread_mutex_unlock(&channel->select_mutex);
-
-    return false;
+    return blocking_receive(channel, data, deadline);
 }
 
-
-// Writes data to the given channel
-// This is a non-blocking call i.e., the function simply returns if the channel is full or no recv operation is available to complete the unbuffered operation
-// Returns SUCCESS for successfully writing data to the channel or successfully completing the unbuffered operation,
-// CHANNEL_FULL if the channel is full and the data was not added to the buffer or the unbuffered operation was not completed,
-// CLOSED_ERROR if the channel is closed, and
-// GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+// Writes data to the given conflating channel under key, replacing any message with the same key that has not been received yet
+// A replaced message keeps its position in the channel, so it does not need room and never blocks
+// A new key blocks while the channel is full, like channel_send
+enum channel_status channel_send_keyed(channel_t* channel, size_t key, void* data, void** displaced)
 {
-    /* IMPLEMENT THIS */
-
     if(pthread_mutex_lock(&channel->mutex) != 0)
     {
         return GENERIC_ERROR;
     }
 
-    if (channel->is_closed)
+    if(channel->unbuffered || channel->buffer->keys == NULL)
     {
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
             return GENERIC_ERROR;
         }
-        return CLOSED_ERROR;
+        return GENERIC_ERROR;
     }
 
-    // if the channel is unbuffered
-    if (channel->unbuffered){
-        // if the recv operation is waiting in stage 2 or 3, then wait for the operation to reach stage 1
-        while(channel->recv_waiting > 0 && channel->unbuffered_stage == 0 && recv_waiting_in_select(channel) == false)
-        {
-            pthread_cond_wait(&channel->cond_full, &channel->mutex);
-        }
-        // if the recv operation is waiting in stage 1 or in select list, then complete the operation
-        if ((channel->unbuffered_stage == 1 && channel->unbuffered_operation == UNBUFFERED_RECEIVE) || recv_waiting_in_select(channel) == true)
+    void* replaced = NULL;
+    channel_waiters_t* waiters = NULL;
+    while(!channel->is_closed)
+    {
+        // the replaced message was already counted and announced when it was first sent, so nobody needs to be woken
+        if(buffer_replace_keyed(channel->buffer, key, data, &replaced) == BUFFER_SUCCESS)
         {
-            enum channel_status status = unbuffered_sync(channel, UNBUFFERED_SEND, &data);
-            return status;
+            if(pthread_mutex_unlock(&channel->mutex) != 0)
+            {
+                return GENERIC_ERROR;
+            }
+            if(displaced != NULL)
+            {
+                *displaced = replaced;
+            }
+            return SUCCESS;
+        }
+
+        if(buffer_add_keyed(channel->buffer, key, data) == BUFFER_SUCCESS)
+        {
+            if(pthread_mutex_unlock(&channel->mutex) != 0)
+            {
+                return GENERIC_ERROR;
+            }
+            if(displaced != NULL)
+            {
+                *displaced = NULL;
+            }
+            wake_receivers(channel, 1);
+            return SUCCESS;
+        }
+
+        if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+        {
+            pthread_mutex_unlock(&channel->mutex);
+            return GENERIC_ERROR;
+        }
+        pthread_cond_wait(&waiters->cond_full, &channel->mutex);
+    }
+
+    if(pthread_mutex_unlock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+    return CLOSED_ERROR;
+}
+
+// Writes data to the given channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full or no recv operation is available to complete the unbuffered operation
+// A receiver waiting in a select is offered the data, and if that select picks another case or gives up the call backs out with CHANNEL_FULL
+// Returns SUCCESS for successfully writing data to the channel or successfully completing the unbuffered operation,
+// CHANNEL_FULL if the channel is full and the data was not added to the buffer or the unbuffered operation was not completed,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+{
+    /* IMPLEMENT THIS */
+
+    if(pthread_mutex_lock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (channel->is_closed)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
+
+    // if the channel is unbuffered
+    if (channel->unbuffered){
+        // if the recv operation is waiting in stage 2 or 3, then wait for the operation to reach stage 1
+        // these receivers are already on their way, so the wait is short and never waits for a receiver that has not arrived yet
+        while(!channel->is_closed && channel->waiters->recv_waiting > 0 && channel->waiters->unbuffered_stage != 1 &&
+              !(channel->waiters->unbuffered_stage == 0 && waiting_in_select(channel, UNBUFFERED_RECEIVE, NULL, true)))
+        {
+            pthread_cond_wait(&channel->waiters->cond_full, &channel->mutex);
+        }
+        if (channel->is_closed)
+        {
+            if(pthread_mutex_unlock(&channel->mutex) != 0)
+            {
+                return GENERIC_ERROR;
+            }
+            return CLOSED_ERROR;
+        }
+        // if the recv operation is waiting in stage 1, then complete the operation
+        if (channel->waiters->unbuffered_stage == 1 && channel->waiters->unbuffered_operation == UNBUFFERED_RECEIVE)
+        {
+            return unbuffered_sync(channel, UNBUFFERED_SEND, &data, NULL, NULL, false, NULL);
+        }
+        // if the recv operation is waiting in a select, then offer it the data, and back out with CHANNEL_FULL if the select picks another case or gives up
+        if (channel->waiters->unbuffered_stage == 0 && waiting_in_select(channel, UNBUFFERED_RECEIVE, NULL, true))
+        {
+            return unbuffered_sync(channel, UNBUFFERED_SEND, &data, NULL, NULL, true, NULL);
         }
         // if the recv operation is not waiting, then return channel full
         else
@@ -440,8 +864,7 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
             return GENERIC_ERROR;
         }
 
-        signal_semaphore_select_recv(channel);
-        pthread_cond_signal(&channel->cond_empty);
+        wake_receivers(channel, 1);
         
 
         return SUCCESS;
@@ -453,6 +876,7 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
 
 // Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
 // This is a non-blocking call i.e., the function simply returns if the channel is empty or no send operation is available to complete the unbuffered operation
+// A sender waiting in a select is offered to hand over its data, and if that select picks another case or gives up the call backs out with CHANNEL_EMPTY
 // Returns SUCCESS for successful retrieval of data or successfully completing the unbuffered operation,
 // CHANNEL_EMPTY if the channel is empty and nothing was stored in data or the unbuffered operation was not completed,
 // CLOSED_ERROR if the channel is closed, and
@@ -466,7 +890,7 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
         return GENERIC_ERROR;
     }
 
-    if (channel->is_closed)
+    if (closed_for_receive(channel))
     {
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
@@ -479,15 +903,29 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
     if (channel->unbuffered)
     {
         // if send operation is waiting in stage 2 or 3, then wait for the operation to reach stage 1
-        while(channel->send_waiting > 0 && channel->unbuffered_stage == 0 && recv_waiting_in_select(channel) == false)
+        // these senders are already on their way, so the wait is short and never waits for a sender that has not arrived yet
+        while(!channel->is_closed && channel->waiters->send_waiting > 0 && channel->waiters->unbuffered_stage != 1 &&
+              !(channel->waiters->unbuffered_stage == 0 && waiting_in_select(channel, UNBUFFERED_SEND, NULL, true)))
         {
-            pthread_cond_wait(&channel->cond_empty, &channel->mutex);
+            pthread_cond_wait(&channel->waiters->cond_empty, &channel->mutex);
         }
-        // if the send operation is waiting in stage 1 or in select list, then complete the operation
-        if((channel->unbuffered_stage == 1 && channel->unbuffered_operation == UNBUFFERED_SEND) || send_waiting_in_select(channel) == true)
+        if (channel->is_closed)
         {
-            enum channel_status status = unbuffered_sync(channel, UNBUFFERED_RECEIVE, data);
-            return status;
+            if(pthread_mutex_unlock(&channel->mutex) != 0)
+            {
+                return GENERIC_ERROR;
+            }
+            return CLOSED_ERROR;
+        }
+        // if the send operation is waiting in stage 1, then complete the operation
+        if(channel->waiters->unbuffered_stage == 1 && channel->waiters->unbuffered_operation == UNBUFFERED_SEND)
+        {
+            return unbuffered_sync(channel, UNBUFFERED_RECEIVE, data, NULL, NULL, false, NULL);
+        }
+        // if the send operation is waiting in a select, then offer to take its data, and back out with CHANNEL_EMPTY if the select picks another case or gives up
+        if(channel->waiters->unbuffered_stage == 0 && waiting_in_select(channel, UNBUFFERED_SEND, NULL, true))
+        {
+            return unbuffered_sync(channel, UNBUFFERED_RECEIVE, data, NULL, NULL, true, NULL);
         }
         // if the send operation is not waiting, then return channel empty
         else
@@ -518,8 +956,7 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
             return GENERIC_ERROR;
         }
 
-        signal_semaphore_select_send(channel);
-        pthread_cond_signal(&channel->cond_full);
+        wake_senders(channel, 1);
         
         return SUCCESS;
 
@@ -529,21 +966,45 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
     
 }
 
-// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
-// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
-// Returns SUCCESS if close is successful,
-// CLOSED_ERROR if the channel is already closed, and
-// GENERIC_ERROR in any other error case
-enum channel_status channel_close(channel_t* channel)
+// Writes up to count messages from items to the given channel in FIFO order, without blocking
+// A buffered channel takes as many messages as it has room for under a single lock acquisition
+// An unbuffered channel hands over one message per waiting receiver
+// sent is set to the number of messages written
+// Returns SUCCESS if at least one message was written (or count is 0),
+// CHANNEL_FULL if no message could be written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t count, size_t* sent)
 {
-    /* IMPLEMENT THIS */
+    if (items == NULL || sent == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+
+    *sent = 0;
+
+    // if the channel is unbuffered
+    if (channel->unbuffered)
+    {
+        while (*sent < count)
+        {
+            enum channel_status status = channel_non_blocking_send(channel, items[*sent]);
+            if (status != SUCCESS)
+            {
+                return (status == CHANNEL_FULL && *sent > 0) ? SUCCESS : status;
+            }
+            (*sent)++;
+        }
+        return SUCCESS;
+    }
 
+    // if the channel is buffered
     if(pthread_mutex_lock(&channel->mutex) != 0)
     {
         return GENERIC_ERROR;
     }
 
-    if(channel->is_closed)
+    if (channel->is_closed)
     {
         if(pthread_mutex_unlock(&channel->mutex) != 0)
         {
@@ -552,316 +1013,1126 @@ enum channel_status channel_close(channel_t* channel)
         return CLOSED_ERROR;
     }
 
-    channel->is_closed = true;
+    *sent = buffer_add_bulk(channel->buffer, items, count);
 
     if(pthread_mutex_unlock(&channel->mutex) != 0)
     {
         return GENERIC_ERROR;
     }
 
-    signal_semaphore_select_recv(channel);
-    signal_semaphore_select_send(channel);
-    pthread_cond_broadcast(&channel->cond_empty);
-    pthread_cond_broadcast(&channel->cond_full);
-    pthread_cond_broadcast(&channel->cond_waiting_stage);
-    pthread_cond_broadcast(&channel->cond_completed_stage);
+    if (*sent == 0)
+    {
+        return (count == 0) ? SUCCESS : CHANNEL_FULL;
+    }
+
+    wake_receivers(channel, *sent);
 
     return SUCCESS;
 }
 
-// Frees all the memory allocated to the channel
-// The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
-// Returns SUCCESS if destroy is successful,
-// DESTROY_ERROR if channel_destroy is called on an open channel, and
-// GENERIC_ERROR in any other error case
-enum channel_status channel_destroy(channel_t* channel)
+// Shared implementation of channel_receive_batch and channel_receive_batch_wait
+// If block is true the call waits until at least one message is available
+enum channel_status receive_batch(channel_t* channel, void** out, size_t max, size_t* received, bool block)
 {
-    /* IMPLEMENT THIS */
+    if (out == NULL || received == NULL)
+    {
+        return GENERIC_ERROR;
+    }
 
-    if (channel->is_closed == false)
+    *received = 0;
+
+    if (max == 0)
     {
-        return DESTROY_ERROR;
+        return SUCCESS;
     }
 
-    pthread_cond_destroy(&channel->cond_full);
-    pthread_cond_destroy(&channel->cond_empty);
-    pthread_cond_destroy(&channel->cond_waiting_stage);
-    pthread_cond_destroy(&channel->cond_completed_stage);
-    pthread_mutex_destroy(&channel->mutex);
-    pthread_mutex_destroy(&channel->select_mutex);
-    if (!channel->unbuffered)
+    // if the channel is unbuffered
+    if (channel->unbuffered)
     {
-        buffer_free(channel->buffer);
+        // the first message may wait for a sender, the rest only take senders that are already waiting
+        enum channel_status status = block ? channel_receive(channel, &out[0]) : channel_non_blocking_receive(channel, &out[0]);
+        if (status != SUCCESS)
+        {
+            return status;
+        }
+        *received = 1;
+        while (*received < max && channel_non_blocking_receive(channel, &out[*received]) == SUCCESS)
+        {
+            (*received)++;
+        }
+        return SUCCESS;
     }
-    list_destroy(channel->semaphore_select_list_send);
-    list_destroy(channel->semaphore_select_list_recv);
-    free(channel);
 
-    return SUCCESS;
-}
+    // if the channel is buffered
+    if(pthread_mutex_lock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
 
-// Add a semaphore to the select list with send operation
-void add_semaphore_select_list_send(channel_t* channel, sem_t* semaphore)
-{
-    pthread_mutex_lock(&channel->select_mutex);
+    channel_waiters_t* waiters = NULL;
+    while (!channel->is_closed && block && buffer_current_size(channel->buffer) == 0)
+    {
+        if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+        {
+            pthread_mutex_unlock(&channel->mutex);
+            return GENERIC_ERROR;
+        }
+        pthread_cond_wait(&waiters->cond_empty, &channel->mutex);
+    }
 
-    list_insert(channel->semaphore_select_list_send, semaphore);
+    if (closed_for_receive(channel))
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
 
-    pthread_mutex_unlock(&channel->select_mutex);
-}
+    *received = buffer_remove_bulk(channel->buffer, out, max);
 
-// Add a semaphore to the select list with recv operation
-void add_semaphore_select_list_recv(channel_t* channel, sem_t* semaphore)
-{
-    pthread_mutex_lock(&channel->select_mutex);
+    if(pthread_mutex_unlock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (*received == 0)
+    {
+        return CHANNEL_EMPTY;
+    }
 
-    list_insert(channel->semaphore_select_list_recv, semaphore);
+    wake_senders(channel, *received);
 
-    pthread_mutex_unlock(&channel->select_mutex);
+    return SUCCESS;
 }
 
-// Remove a semaphore from the select list with send operation
-void remove_semaphore_select_list_send(channel_t* channel, sem_t* semaphore)
+// Reads up to max messages from the given channel in FIFO order into out, without blocking
+// A buffered channel hands out as many messages as it holds under a single lock acquisition
+// received is set to the number of messages read
+// Returns SUCCESS if at least one message was read (or max is 0),
+// CHANNEL_EMPTY if no message was available,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* received)
 {
-    pthread_mutex_lock(&channel->select_mutex);
-
-    list_remove(channel->semaphore_select_list_send, list_find(channel->semaphore_select_list_send, semaphore));
-
-    pthread_mutex_unlock(&channel->select_mutex);
+    return receive_batch(channel, out, max, received, false);
 }
 
-// Remove a semaphore from the select list with recv operation
-void remove_semaphore_select_list_recv(channel_t* channel, sem_t* semaphore)
+// Reads up to max messages from the given channel in FIFO order into out
+// This is a blocking call that waits until at least one message is available, and then takes everything up to max that is available
+// received is set to the number of messages read
+// Returns SUCCESS if at least one message was read (or max is 0),
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch_wait(channel_t* channel, void** out, size_t max, size_t* received)
 {
-    pthread_mutex_lock(&channel->select_mutex);
-
-    list_remove(channel->semaphore_select_list_recv, list_find(channel->semaphore_select_list_recv, semaphore));
-
-    pthread_mutex_unlock(&channel->select_mutex);
+    return receive_batch(channel, out, max, received, true);
 }
 
-// Cleanup the select list by removing the provided semaphore
-void cleanup_semaphore_select(select_t* channel_list, size_t channel_count, sem_t* semaphore)
+// Locks both channels, always in address order so that opposite forwards cannot deadlock
+bool lock_channel_pair(channel_t* src, channel_t* dst)
 {
-    for (size_t i = 0; i < channel_count; i++)
+    channel_t* first = (src < dst) ? src : dst;
+    channel_t* second = (src < dst) ? dst : src;
+    if(pthread_mutex_lock(&first->mutex) != 0)
     {
-        if (channel_list[i].dir == SEND)
-        {
-            remove_semaphore_select_list_send(channel_list[i].channel, semaphore);
-        }
-        else if (channel_list[i].dir == RECV)
-        {
-            remove_semaphore_select_list_recv(channel_list[i].channel, semaphore);
-        }
+        return false;
     }
-}
-
-// Initialize the select list with the provided semaphore
-void init_semaphore_select(select_t* channel_list, size_t channel_count, sem_t* semaphore)
-{
-    for (size_t i = 0; i < channel_count; i++)
+    if(pthread_mutex_lock(&second->mutex) != 0)
     {
-        if (channel_list[i].dir == SEND)
-        {
-            add_semaphore_select_list_send(channel_list[i].channel, semaphore);
-        }
-        else if (channel_list[i].dir == RECV)
-        {
-            add_semaphore_select_list_recv(channel_list[i].channel, semaphore);
-        }
+        pthread_mutex_unlock(&first->mutex);
+        return false;
     }
+    return true;
 }
 
-
-// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
-// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
-// If multiple options are available, it selects the first option and performs its corresponding action
-// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
-// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
-// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
-// Additionally, selected_index is set to the index of the channel that generated the error
-enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+// Unlocks both channels locked by lock_channel_pair
+bool unlock_channel_pair(channel_t* src, channel_t* dst)
 {
-    /* IMPLEMENT THIS */
-
-    // Initialize the mutex and semaphore
-    pthread_mutex_t mutex;
-    sem_t semaphore;
-    pthread_mutex_init(&mutex, NULL);
-    sem_init(&semaphore, 0, 0);
-
-    // Check for invalid inputs
-    if (channel_count == 0)
-    {
-        return GENERIC_ERROR;
-    }
+    bool unlocked = pthread_mutex_unlock(&src->mutex) == 0;
+    return (pthread_mutex_unlock(&dst->mutex) == 0) && unlocked;
+}
 
-    if (channel_list == NULL)
+// Shared implementation of channel_forward and channel_forward_wait
+// If block is true the call waits until at least one message can be moved
+enum channel_status forward(channel_t* src, channel_t* dst, size_t max, size_t* forwarded, bool block)
+{
+    if (forwarded == NULL || src == dst || src->unbuffered || dst->unbuffered)
     {
         return GENERIC_ERROR;
     }
 
-    if(selected_index == NULL)
-    {
-        return GENERIC_ERROR;
-    }
+    *forwarded = 0;
 
-    if (pthread_mutex_lock(&mutex) != 0)
+    while (true)
     {
-        return GENERIC_ERROR;
-    }
-
-    // Initialize the select list with the provided semaphore
-    init_semaphore_select(channel_list, channel_count, &semaphore);
-    
-    while(1){
+        if (!lock_channel_pair(src, dst))
+        {
+            return GENERIC_ERROR;
+        }
 
-        // Iterate over the provided list and find the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
-        // If multiple options are available, it selects the first option and performs its corresponding action
-        for (size_t i = 0; i < channel_count; i++)
+        if (closed_for_receive(src) || dst->is_closed)
         {
-            // if the operation is send
-            if (channel_list[i].dir == SEND)
+            if (!unlock_channel_pair(src, dst))
             {
-                // if the channel is unbuffered
-                if (channel_list[i].channel->unbuffered){
-                    if(pthread_mutex_lock(&channel_list[i].channel->mutex) != 0)
-                    {
-                        return GENERIC_ERROR;
-                    }
-                    if (channel_list[i].channel->is_closed)
-                    {
-                        if(pthread_mutex_unlock(&channel_list[i].channel->mutex) != 0)
-                        {
-                            return GENERIC_ERROR;
-                        }
-                        return CLOSED_ERROR;
-                    }
-                    // if the receive operation is waiting in stage 1 or in select list of receive operation, then complete the operation
-                    if((channel_list[i].channel->unbuffered_stage == 1 && channel_list[i].channel->unbuffered_operation == UNBUFFERED_RECEIVE) || recv_waiting_in_select(channel_list[i].channel) == true)
-                    {
-                        enum channel_status status = unbuffered_sync(channel_list[i].channel, UNBUFFERED_SEND, &channel_list[i].data);
-                        *selected_index = i;
+                return GENERIC_ERROR;
+            }
+            return CLOSED_ERROR;
+        }
 
-                        cleanup_semaphore_select(channel_list, channel_count, &semaphore);
+        // the messages are copied straight from one ring to the other, nobody holds them in between
+        *forwarded = buffer_move(dst->buffer, src->buffer, max);
 
-                        if(pthread_mutex_unlock(&mutex) != 0)
-                        {
-                            return GENERIC_ERROR;
-                        }
+        bool src_empty = buffer_current_size(src->buffer) == 0;
 
-                        sem_destroy(&semaphore);
-                        pthread_mutex_destroy(&mutex);
+        if (!unlock_channel_pair(src, dst))
+        {
+            return GENERIC_ERROR;
+        }
 
-                        return status;
-                    }
-                    if(pthread_mutex_unlock(&channel_list[i].channel->mutex) != 0)
-                    {
-                        return GENERIC_ERROR;
-                    }
+        if (*forwarded > 0)
+        {
+            wake_senders(src, *forwarded);
+            wake_receivers(dst, *forwarded);
+            return SUCCESS;
+        }
 
-                }
-                // if the channel is buffered
-                else{
-                    enum channel_status status = channel_non_blocking_send(channel_list[i].channel, channel_list[i].data);
-                    if (status != CHANNEL_FULL)
-                    {
-                        *selected_index = i;
+        if (max == 0)
+        {
+            return SUCCESS;
+        }
 
-                        cleanup_semaphore_select(channel_list, channel_count, &semaphore);
+        if (!block)
+        {
+            return CHANNEL_EMPTY;
+        }
 
-                        if(pthread_mutex_unlock(&mutex) != 0)
-                        {
-                            return GENERIC_ERROR;
-                        }
+        // wait on whichever side stopped the move, with only that channel's lock held
+        channel_t* channel = src_empty ? src : dst;
+        if(pthread_mutex_lock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        channel_waiters_t* waiters = NULL;
+        if (src_empty)
+        {
+            while (!channel->is_closed && buffer_current_size(channel->buffer) == 0)
+            {
+                if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+                {
+                    pthread_mutex_unlock(&channel->mutex);
+                    return GENERIC_ERROR;
+                }
+                pthread_cond_wait(&waiters->cond_empty, &channel->mutex);
+            }
+        }
+        else
+        {
+            while (!channel->is_closed && buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer))
+            {
+                if (waiters == NULL && (waiters = channel_waiters(channel)) == NULL)
+                {
+                    pthread_mutex_unlock(&channel->mutex);
+                    return GENERIC_ERROR;
+                }
+                pthread_cond_wait(&waiters->cond_full, &channel->mutex);
+            }
+        }
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+    }
+}
 
-                        sem_destroy(&semaphore);
-                        pthread_mutex_destroy(&mutex);
+// Moves up to max messages from src to dst in FIFO order, without blocking
+enum channel_status channel_forward(channel_t* src, channel_t* dst, size_t max, size_t* forwarded)
+{
+    return forward(src, dst, max, forwarded, false);
+}
 
-                        return status;
-                    }
-                }
+// Moves up to max messages from src to dst in FIFO order, blocking until at least one message can be moved
+enum channel_status channel_forward_wait(channel_t* src, channel_t* dst, size_t max, size_t* forwarded)
+{
+    return forward(src, dst, max, forwarded, true);
+}
+
+// Shared implementation of channel_close and channel_close_write
+// If write_only is true the buffered messages stay available to receivers
+enum channel_status close_channel(channel_t* channel, bool write_only)
+{
+    if(pthread_mutex_lock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    // channel_close still completes a close started by channel_close_write
+    if(channel->is_closed && (write_only || !channel->write_closed))
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
+
+    channel->is_closed = true;
+    channel->write_closed = write_only;
+
+    if(pthread_mutex_unlock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    signal_semaphore_select_recv(channel);
+    signal_semaphore_select_send(channel);
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters != NULL)
+    {
+        pthread_cond_broadcast(&waiters->cond_empty);
+        pthread_cond_broadcast(&waiters->cond_full);
+        pthread_cond_broadcast(&waiters->cond_waiting_stage);
+        pthread_cond_broadcast(&waiters->cond_completed_stage);
+    }
+
+    return SUCCESS;
+}
+
+// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
+// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_close(channel_t* channel)
+{
+    /* IMPLEMENT THIS */
+
+    return close_channel(channel, false);
+}
+
+// Closes the channel for writing, receivers keep reading buffered messages until the channel is empty
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_close_write(channel_t* channel)
+{
+    return close_channel(channel, true);
+}
+
+// Returns the sender handle that the channel was created with
+channel_sender_t channel_sender(channel_t* channel)
+{
+    channel_sender_t sender = {channel};
+    return sender;
+}
+
+// Returns the receiver handle that the channel was created with
+channel_receiver_t channel_receiver(channel_t* channel)
+{
+    channel_receiver_t receiver = {channel};
+    return receiver;
+}
+
+// Returns a new sender handle for the same channel
+channel_sender_t channel_sender_clone(channel_sender_t sender)
+{
+    __atomic_add_fetch(&sender.channel->senders, 1, __ATOMIC_RELAXED);
+    return sender;
+}
+
+// Returns a new receiver handle for the same channel
+channel_receiver_t channel_receiver_clone(channel_receiver_t receiver)
+{
+    __atomic_add_fetch(&receiver.channel->receivers, 1, __ATOMIC_RELAXED);
+    return receiver;
+}
+
+// Releases one reference from count
+// Returns true if it was the last reference, and sets released to false if there was no reference left to release
+bool release_endpoint(uint32_t* count, bool* released)
+{
+    uint32_t current = __atomic_load_n(count, __ATOMIC_RELAXED);
+    do
+    {
+        if (current == 0)
+        {
+            *released = false;
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(count, &current, current - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    *released = true;
+    return current == 1;
+}
+
+// Releases a sender handle, closing the channel for writing when it was the last one
+enum channel_status channel_sender_drop(channel_sender_t sender)
+{
+    bool released;
+    if (release_endpoint(&sender.channel->senders, &released))
+    {
+        // the channel may have been closed already, which is just as good
+        if (close_channel(sender.channel, true) == GENERIC_ERROR)
+        {
+            return GENERIC_ERROR;
+        }
+    }
+    return released ? SUCCESS : GENERIC_ERROR;
+}
+
+// Releases a receiver handle, abandoning the channel when it was the last one
+enum channel_status channel_receiver_drop(channel_receiver_t receiver)
+{
+    bool released;
+    if (release_endpoint(&receiver.channel->receivers, &released))
+    {
+        // nobody can receive anymore, so a write close is turned into a full close as well
+        if (close_channel(receiver.channel, false) == GENERIC_ERROR)
+        {
+            return GENERIC_ERROR;
+        }
+    }
+    return released ? SUCCESS : GENERIC_ERROR;
+}
+
+// Grows the capacity of a mapped channel to size
+enum channel_status channel_grow(channel_t* channel, size_t size)
+{
+    if(pthread_mutex_lock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (channel->is_closed)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
+
+    size_t capacity = channel->unbuffered ? 0 : buffer_capacity(channel->buffer);
+    void** ring = NULL;
+    if (ring_mapped(channel) && size >= capacity)
+    {
+        ring = ring_remap(channel->buffer->data, capacity, size);
+    }
+    if (ring == NULL)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return GENERIC_ERROR;
+    }
+    buffer_grow(channel->buffer, ring, size);
+
+    if(pthread_mutex_unlock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (size > capacity)
+    {
+        wake_senders(channel, size - capacity);
+    }
+    return SUCCESS;
+}
+
+// Creates a new conflating channel with the provided size and returns it to the caller
+// Returns NULL for a 0 size, since an unbuffered channel has nothing to conflate
+channel_t* channel_create_conflating(size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    channel_t* channel = channel_create(size);
+    if (channel == NULL)
+    {
+        return NULL;
+    }
+    // only conflating channels pay for the keys and their index, so they live outside the channel's block
+    if (buffer_track_keys(channel->buffer) != BUFFER_SUCCESS)
+    {
+        channel_close(channel);
+        channel_destroy(channel);
+        return NULL;
+    }
+
+    return channel;
+}
+
+// Returns the number of bytes of memory the channel currently uses
+// Waiter state is counted once it exists, together with the select list nodes of any select currently registered on the channel
+size_t channel_footprint(channel_t* channel)
+{
+    size_t bytes = 0;
+    if (ring_mapped(channel))
+    {
+        bytes = slab_size(channel_block_size(0)) + ring_map_size(buffer_capacity(channel->buffer));
+    }
+    else if (channel->on_node)
+    {
+        bytes = placement_size(channel_block_size(channel->unbuffered ? 0 : buffer_capacity(channel->buffer)));
+    }
+    else
+    {
+        bytes = slab_size(channel_block_size(channel->unbuffered ? 0 : buffer_capacity(channel->buffer)));
+    }
+    if (!channel->unbuffered)
+    {
+        bytes += buffer_keys_size(channel->buffer);
+    }
+
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    if (waiters != NULL)
+    {
+        bytes += sizeof(channel_waiters_t);
+        pthread_mutex_lock(&waiters->select_mutex);
+        bytes += (list_count(&waiters->semaphore_select_list_send) + list_count(&waiters->semaphore_select_list_recv)) * sizeof(list_node_t);
+        pthread_mutex_unlock(&waiters->select_mutex);
+    }
+
+    return bytes;
+}
+
+// Frees all the memory allocated to the channel
+// The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
+// Returns SUCCESS if destroy is successful,
+// DESTROY_ERROR if channel_destroy is called on an open channel, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_destroy(channel_t* channel)
+{
+    /* IMPLEMENT THIS */
+
+    if (channel->is_closed == false)
+    {
+        return DESTROY_ERROR;
+    }
+
+    pthread_mutex_destroy(&channel->mutex);
+    if (channel->waiters != NULL)
+    {
+        channel_waiters_free(channel->waiters);
+    }
+    size_t size = 0;
+    if (ring_mapped(channel))
+    {
+        ring_unmap(channel->buffer->data, buffer_capacity(channel->buffer));
+    }
+    else if (!channel->unbuffered)
+    {
+        size = buffer_capacity(channel->buffer);
+        buffer_free_keys(channel->buffer);
+    }
+    if (channel->on_node)
+    {
+        placement_unmap(channel, channel_block_size(size));
+    }
+    else
+    {
+        slab_free(channel, channel_block_size(size));
+    }
+
+    return SUCCESS;
+}
+
+// Called after a select removed itself from one of the channel's select lists
+// An operation waiting in stage 1 of an unbuffered channel may have been waiting for this select only, so it has to re-check
+void select_waiter_left(channel_t* channel)
+{
+    if (!channel->unbuffered)
+    {
+        return;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    pthread_cond_broadcast(&channel->waiters->cond_completed_stage);
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+// Add a semaphore to the select list with send operation
+// Returns false if the channel's waiter state could not be created
+bool add_semaphore_select_list_send(channel_t* channel, select_waiter_t* waiter)
+{
+    channel_waiters_t* waiters = channel_waiters(channel);
+    if (waiters == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&waiters->select_mutex);
+
+    list_insert(&waiters->semaphore_select_list_send, waiter);
+
+    pthread_mutex_unlock(&waiters->select_mutex);
+    return true;
+}
+
+// Add a semaphore to the select list with recv operation
+// Returns false if the channel's waiter state could not be created
+bool add_semaphore_select_list_recv(channel_t* channel, select_waiter_t* waiter)
+{
+    channel_waiters_t* waiters = channel_waiters(channel);
+    if (waiters == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&waiters->select_mutex);
+
+    list_insert(&waiters->semaphore_select_list_recv, waiter);
+
+    pthread_mutex_unlock(&waiters->select_mutex);
+    return true;
+}
+
+// Remove a semaphore from the select list with send operation
+void remove_semaphore_select_list_send(channel_t* channel, select_waiter_t* waiter)
+{
+    // the matching add created the waiter state
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    pthread_mutex_lock(&waiters->select_mutex);
+
+    list_remove(&waiters->semaphore_select_list_send, list_find(&waiters->semaphore_select_list_send, waiter));
+
+    pthread_mutex_unlock(&waiters->select_mutex);
+
+    select_waiter_left(channel);
+}
+
+// Remove a semaphore from the select list with recv operation
+void remove_semaphore_select_list_recv(channel_t* channel, select_waiter_t* waiter)
+{
+    // the matching add created the waiter state
+    channel_waiters_t* waiters = channel_waiters_created(channel);
+    pthread_mutex_lock(&waiters->select_mutex);
+
+    list_remove(&waiters->semaphore_select_list_recv, list_find(&waiters->semaphore_select_list_recv, waiter));
+
+    pthread_mutex_unlock(&waiters->select_mutex);
+
+    select_waiter_left(channel);
+}
+
+// Cleanup the select list by removing the provided waiter
+void cleanup_semaphore_select(select_t* channel_list, size_t channel_count, select_waiter_t* waiter)
+{
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        if (channel_list[i].dir == SEND || channel_list[i].dir == SEND_LAZY)
+        {
+            remove_semaphore_select_list_send(channel_list[i].channel, waiter);
+        }
+        else if (channel_list[i].dir == RECV)
+        {
+            remove_semaphore_select_list_recv(channel_list[i].channel, waiter);
+        }
+    }
+}
+
+// Initialize the select list with the provided waiter
+// Returns false if some channel's waiter state could not be created, the waiter is then not registered anywhere
+bool init_semaphore_select(select_t* channel_list, size_t channel_count, select_waiter_t* waiter)
+{
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        bool added = true;
+        if (channel_list[i].dir == SEND || channel_list[i].dir == SEND_LAZY)
+        {
+            added = add_semaphore_select_list_send(channel_list[i].channel, waiter);
+        }
+        else if (channel_list[i].dir == RECV)
+        {
+            added = add_semaphore_select_list_recv(channel_list[i].channel, waiter);
+        }
+        if (!added)
+        {
+            cleanup_semaphore_select(channel_list, i, waiter);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Writes the payload of a SEND_LAZY select case to a buffered channel
+// The payload is only produced once a slot in the buffer is known to be free, the channel mutex is held while produce runs
+// Unbuffered channels have no slot to reserve, their SEND_LAZY cases go through the rendezvous in select_from instead, which produces once a receiver is committed
+// Returns SUCCESS, CHANNEL_FULL, CLOSED_ERROR or GENERIC_ERROR like channel_non_blocking_send
+enum channel_status non_blocking_send_lazy(channel_t* channel, select_producer_t* producer)
+{
+    if (channel->unbuffered)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if(pthread_mutex_lock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (channel->is_closed)
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CLOSED_ERROR;
+    }
+
+    if (buffer_current_size(channel->buffer) >= buffer_capacity(channel->buffer))
+    {
+        if(pthread_mutex_unlock(&channel->mutex) != 0)
+        {
+            return GENERIC_ERROR;
+        }
+        return CHANNEL_FULL;
+    }
+
+    // the slot is reserved by holding the mutex, so the add below cannot fail
+    producer->produced = producer->produce(producer->ctx);
+    buffer_add(channel->buffer, producer->produced);
+
+    if(pthread_mutex_unlock(&channel->mutex) != 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    wake_receivers(channel, 1);
+
+    return SUCCESS;
+}
+
+// Shared implementation of channel_select, channel_select_fair and channel_select_until
+// Every scan over channel_list begins at index start and wraps around, so start decides which ready case wins
+// If deadline is NULL the call blocks until a case completes, otherwise it gives up with TIMEOUT once the absolute CLOCK_MONOTONIC deadline has passed
+enum channel_status select_from(select_t* channel_list, size_t channel_count, size_t* selected_index, size_t start, const struct timespec* deadline)
+{
+    // Check for invalid inputs
+    if (channel_count == 0)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if (channel_list == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+
+    if(selected_index == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+
+    // Initialize the semaphore that every channel in the list signals when its state changes
+    select_waiter_t waiter;
+    sem_init(&waiter.semaphore, 0, 0);
+    waiter.busy = false;
+
+    enum channel_status status = GENERIC_ERROR;
+    size_t index = 0;
+
+    // Initialize the select list with the provided semaphore
+    if (!init_semaphore_select(channel_list, channel_count, &waiter))
+    {
+        sem_destroy(&waiter.semaphore);
+        return GENERIC_ERROR;
+    }
+    
+    while(1){
+
+        // Iterate over the provided list and find the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
+        // If multiple options are available, it selects the first option after start and performs its corresponding action
+        for (size_t k = 0; k < channel_count; k++)
+        {
+            index = start + k;
+            if (index >= channel_count)
+            {
+                index -= channel_count;
             }
-            // if the operation is receive
-            else if (channel_list[i].dir == RECV)
+
+            channel_t* channel = channel_list[index].channel;
+
+            // if the channel is unbuffered
+            if (channel->unbuffered)
             {
-                // if the channel is unbuffered
-                if (channel_list[i].channel->unbuffered){
-                    if(pthread_mutex_lock(&channel_list[i].channel->mutex) != 0)
+                if(pthread_mutex_lock(&channel->mutex) != 0)
+                {
+                    status = GENERIC_ERROR;
+                    goto selected;
+                }
+                if (channel->is_closed)
+                {
+                    status = (pthread_mutex_unlock(&channel->mutex) != 0) ? GENERIC_ERROR : CLOSED_ERROR;
+                    goto selected;
+                }
+
+                int operation = channel_list[index].dir == RECV ? UNBUFFERED_RECEIVE : UNBUFFERED_SEND;
+                int partner = channel_list[index].dir == RECV ? UNBUFFERED_SEND : UNBUFFERED_RECEIVE;
+                void** data = &channel_list[index].data;
+
+                // if the opposite operation is waiting in stage 1, then complete the operation
+                // a receiver in stage 1 is committed to the rendezvous, so this is where a SEND_LAZY case builds its payload
+                if (channel->waiters->unbuffered_stage == 1 && channel->waiters->unbuffered_operation == partner)
+                {
+                    if (channel_list[index].dir == SEND_LAZY)
                     {
-                        return GENERIC_ERROR;
+                        select_producer_t* producer = channel_list[index].data;
+                        producer->produced = producer->produce(producer->ctx);
+                        data = &producer->produced;
                     }
-                    if (channel_list[i].channel->is_closed)
+                    status = unbuffered_sync(channel, operation, data, NULL, deadline, false, NULL);
+                    goto selected;
+                }
+
+                // if the opposite operation is waiting in another select, then offer it the rendezvous, with the other cases of this select on hold meanwhile
+                // two selects may do this against each other at once: each sets its busy flag before it checks the other's, so at most one of them waits for the other
+                if (channel->waiters->unbuffered_stage == 0 && waiting_in_select(channel, partner, &waiter, true))
+                {
+                    __atomic_store_n(&waiter.busy, true, __ATOMIC_SEQ_CST);
+                    if (waiting_in_select(channel, partner, &waiter, true))
                     {
-                        if(pthread_mutex_unlock(&channel_list[i].channel->mutex) != 0)
+                        // the other select is not reserved by the offer, so a SEND_LAZY case leaves its payload to be built once that select commits
+                        select_producer_t* producer = channel_list[index].dir == SEND_LAZY ? channel_list[index].data : NULL;
+                        status = unbuffered_sync(channel, operation, producer != NULL ? &producer->produced : data, producer, deadline, true, &waiter);
+                        __atomic_store_n(&waiter.busy, false, __ATOMIC_SEQ_CST);
+                        if (status != CHANNEL_FULL)
                         {
-                            return GENERIC_ERROR;
+                            goto selected;
                         }
-                        return CLOSED_ERROR;
+                        // the other select picked another case or gave up, the cases passed over meanwhile are scanned again before waiting
+                        sem_post(&waiter.semaphore);
+                        continue;
                     }
+                    // the other select is busy offering a rendezvous of its own, scan again once it is done
+                    __atomic_store_n(&waiter.busy, false, __ATOMIC_SEQ_CST);
+                    sem_post(&waiter.semaphore);
+                }
 
-                    // // if the send operation is waiting in stage 1 or in select list of send operation, then complete the operation
-                    if((channel_list[i].channel->unbuffered_stage == 1 && channel_list[i].channel->unbuffered_operation == UNBUFFERED_SEND) || send_waiting_in_select(channel_list[i].channel) == true)
+                if(pthread_mutex_unlock(&channel->mutex) != 0)
+                {
+                    status = GENERIC_ERROR;
+                    goto selected;
+                }
+            }
+            // if the channel is buffered
+            else
+            {
+                if (channel_list[index].dir == SEND)
+                {
+                    status = channel_non_blocking_send(channel, channel_list[index].data);
+                    if (status != CHANNEL_FULL)
                     {
-                        enum channel_status status = unbuffered_sync(channel_list[i].channel, UNBUFFERED_RECEIVE, &channel_list[i].data);
-
-                        *selected_index = i;
-
-                        cleanup_semaphore_select(channel_list, channel_count, &semaphore);
-
-                        if(pthread_mutex_unlock(&mutex) != 0)
-                        {
-                            return GENERIC_ERROR;
-                        }
-
-                        sem_destroy(&semaphore);
-                        pthread_mutex_destroy(&mutex);
-
-                        return status;
+                        goto selected;
                     }
-                    if(pthread_mutex_unlock(&channel_list[i].channel->mutex) != 0)
+                }
+                else if (channel_list[index].dir == SEND_LAZY)
+                {
+                    status = non_blocking_send_lazy(channel, channel_list[index].data);
+                    if (status != CHANNEL_FULL)
                     {
-                        return GENERIC_ERROR;
+                        goto selected;
                     }
                 }
-                // if the channel is buffered
-                else{
-                    enum channel_status status = channel_non_blocking_receive(channel_list[i].channel, &channel_list[i].data);
+                else if (channel_list[index].dir == RECV)
+                {
+                    status = channel_non_blocking_receive(channel, &channel_list[index].data);
                     if (status != CHANNEL_EMPTY)
                     {
-                        *selected_index = i;
-                        
-                        cleanup_semaphore_select(channel_list, channel_count, &semaphore);
-
-                        if(pthread_mutex_unlock(&mutex) != 0)
-                        {
-                            return GENERIC_ERROR;
-                        }
-
-                        sem_destroy(&semaphore);
-                        pthread_mutex_destroy(&mutex);
-
-                        return status;
+                        goto selected;
                     }
                 }
             }
         }
+
         // If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
-        sem_wait(&semaphore);
-    
+        if (deadline == NULL)
+        {
+            sem_wait(&waiter.semaphore);
+        }
+        // the wait ends exactly at the deadline, a failed wait for any other reason (e.g. EINTR) just rescans the list
+        else if (sem_clockwait(&waiter.semaphore, CLOCK_MONOTONIC, deadline) != 0 && errno == ETIMEDOUT)
+        {
+            status = TIMEOUT;
+            goto done;
+        }
+    }
+
+    // a case completed or failed, report its index together with its status
+    // an unbuffered rendezvous that was withdrawn at the deadline reports TIMEOUT like any other timed out select
+    selected:
+    if (status != TIMEOUT)
+    {
+        *selected_index = index;
+    }
+
+    // remove the semaphore from every channel before it goes out of scope
+    done:
+    cleanup_semaphore_select(channel_list, channel_count, &waiter);
+    sem_destroy(&waiter.semaphore);
+
+    return status;
+}
+
+// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
+// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
+// If multiple options are available, it selects the first option and performs its corresponding action
+// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
+// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
+// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
+// Additionally, selected_index is set to the index of the channel that generated the error
+enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    return select_from(channel_list, channel_count, selected_index, 0, NULL);
+}
+
+// Same as channel_select, except that the scan starts at a random case drawn from the calling thread's generator
+// If multiple options are available, every ready case has a chance to be selected instead of always the first one
+enum channel_status channel_select_fair(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    if (channel_count == 0)
+    {
+        return GENERIC_ERROR;
     }
 
-    // if loops exits in any other way
-    cleanup_semaphore_select(channel_list, channel_count, &semaphore);
+    return select_from(channel_list, channel_count, selected_index, fast_rand_n(channel_count), NULL);
+}
 
-    if(pthread_mutex_unlock(&mutex) != 0)
+// Same as channel_select, except that the call gives up once the absolute CLOCK_MONOTONIC deadline has passed
+// The wait ends at the deadline itself rather than polling, and the select registrations are removed from every channel before returning
+// Returns TIMEOUT if no case could be completed before the deadline, in which case selected_index is not modified
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline)
+{
+    if (deadline == NULL)
     {
         return GENERIC_ERROR;
     }
 
-    sem_destroy(&semaphore);
-    pthread_mutex_destroy(&mutex);
+    return select_from(channel_list, channel_count, selected_index, 0, deadline);
+}
+
+// Compares how full two channels are without taking their locks
+// Returns true if channel a is less loaded than channel b, comparing the fraction of the buffer in use
+// Unbuffered channels have no buffer to spread load over, so they count as full here and are only reached by the fallback scan
+bool channel_less_loaded(channel_t* a, channel_t* b)
+{
+    if (a->unbuffered || b->unbuffered)
+    {
+        return !a->unbuffered && b->unbuffered;
+    }
 
+    size_t size_a = buffer_current_size_relaxed(a->buffer);
+    size_t size_b = buffer_current_size_relaxed(b->buffer);
 
-    return GENERIC_ERROR;
-}
\ No newline at end of file
+    // size_a / capacity_a < size_b / capacity_b without the division
+    return size_a * buffer_capacity(b->buffer) < size_b * buffer_capacity(a->buffer);
+}
+
+// Writes data to one of the given channels, preferring a lightly loaded one
+// Two channels are picked at random and the data goes to the less loaded of the two (power of two choices)
+// If both turn out to be full, the remaining channels are tried in turn, and only if all of them are full does the call block like channel_select
+// chosen is set to the index of the channel that received the data, or that reported an error
+enum channel_status channel_send_balanced(channel_t** channels, size_t channel_count, void* data, size_t* chosen)
+{
+    if (channels == NULL || channel_count == 0 || chosen == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+
+    size_t pick = fast_rand_n(channel_count);
+    if (channel_count > 1)
+    {
+        // draw a second candidate that differs from the first
+        size_t other = fast_rand_n(channel_count - 1);
+        if (other >= pick)
+        {
+            other++;
+        }
+        if (channel_less_loaded(channels[other], channels[pick]))
+        {
+            pick = other;
+        }
+    }
+
+    // the occupancy reads may be stale, so every attempt is a regular non-blocking send that rechecks under the lock
+    for (size_t k = 0; k < channel_count; k++)
+    {
+        size_t index = pick + k;
+        if (index >= channel_count)
+        {
+            index -= channel_count;
+        }
+
+        enum channel_status status = channel_non_blocking_send(channels[index], data);
+        if (status != CHANNEL_FULL)
+        {
+            *chosen = index;
+            return status;
+        }
+    }
+
+    // every channel is full, so wait for the first one that frees up
+    select_t* channel_list = (select_t*) malloc(sizeof(select_t) * channel_count);
+    if (channel_list == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        channel_list[i].channel = channels[i];
+        channel_list[i].dir = SEND;
+        channel_list[i].data = data;
+    }
+
+    enum channel_status status = select_from(channel_list, channel_count, chosen, pick, NULL);
+
+    free(channel_list);
+
+    return status;
+}
+
+// Sorts the indices of the given channels by channel address, so that their locks can be taken in a global order
+// Insertion sort, fan-out lists are short
+void sort_by_channel_address(channel_t** channels, size_t* order, size_t channel_count)
+{
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        size_t index = i;
+        size_t j = i;
+        while (j > 0 && (uintptr_t)channels[order[j - 1]] > (uintptr_t)channels[index])
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = index;
+    }
+}
+
+// Unlocks the distinct buffered channels among the first count targets of channel_send_multi, taken in address order
+// Returns false if any unlock failed, the remaining channels are still unlocked
+bool unlock_in_order(channel_t** channels, size_t* order, size_t count)
+{
+    bool unlocked = true;
+    channel_t* last_unlocked = NULL;
+    for (size_t k = 0; k < count; k++)
+    {
+        channel_t* channel = channels[order[k]];
+        if (!channel->unbuffered && channel != last_unlocked)
+        {
+            if(pthread_mutex_unlock(&channel->mutex) != 0)
+            {
+                unlocked = false;
+            }
+            last_unlocked = channel;
+        }
+    }
+    return unlocked;
+}
+
+// Writes the same data to every one of the given channels
+// All buffered targets are locked at once in address order, and every target with room gets the data in that single pass
+// The remaining targets (full buffered channels and unbuffered channels) are then sent to one by one in list order,
+// blocking on each of them unless flags contains MULTI_NON_BLOCKING
+// delivered[i] is set to whether channels[i] received the data, so a partial completion can be resumed by the caller
+// Returns SUCCESS if every target received the data,
+// CHANNEL_FULL if MULTI_NON_BLOCKING was given and some target had no room,
+// CLOSED_ERROR if some target is closed (the other targets are still written to), and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_multi(channel_t** channels, size_t channel_count, void* data, int flags, bool* delivered)
+{
+    if (channels == NULL || delivered == NULL)
+    {
+        return GENERIC_ERROR;
+    }
+
+    // order holds the targets sorted by address, closed marks the buffered targets found closed while they were locked
+    size_t* order = (size_t*) malloc(sizeof(size_t) * (channel_count + 1));
+    bool* closed = (bool*) malloc(sizeof(bool) * (channel_count + 1));
+    if (order == NULL || closed == NULL)
+    {
+        free(order);
+        free(closed);
+        return GENERIC_ERROR;
+    }
+    sort_by_channel_address(channels, order, channel_count);
+
+    enum channel_status status = SUCCESS;
+
+    // lock every distinct buffered target in address order, a channel listed twice is only locked once
+    // if a lock fails, the targets already locked (the ones before it in order) are unlocked again and nothing is sent
+    channel_t* last_locked = NULL;
+    for (size_t k = 0; k < channel_count; k++)
+    {
+        channel_t* channel = channels[order[k]];
+        if (!channel->unbuffered && channel != last_locked)
+        {
+            if(pthread_mutex_lock(&channel->mutex) != 0)
+            {
+                unlock_in_order(channels, order, k);
+                free(order);
+                free(closed);
+                return GENERIC_ERROR;
+            }
+            last_locked = channel;
+        }
+    }
+
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        delivered[i] = false;
+        closed[i] = false;
+        if (channels[i]->unbuffered)
+        {
+            continue;
+        }
+        if (channels[i]->is_closed)
+        {
+            closed[i] = true;
+            status = CLOSED_ERROR;
+            continue;
+        }
+        delivered[i] = (buffer_add(channels[i]->buffer, data) == BUFFER_SUCCESS);
+    }
+
+    // an unlock failure is reported, but the buffered pass already happened, so wake its receivers and finish the rest first
+    if (!unlock_in_order(channels, order, channel_count))
+    {
+        status = GENERIC_ERROR;
+    }
+
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        if (delivered[i])
+        {
+            wake_receivers(channels[i], 1);
+        }
+    }
+
+    // the targets that could not take the data in the locked pass
+    for (size_t i = 0; i < channel_count; i++)
+    {
+        if (delivered[i] || closed[i])
+        {
+            continue;
+        }
+
+        enum channel_status send_status = (flags & MULTI_NON_BLOCKING) ? channel_non_blocking_send(channels[i], data) : channel_send(channels[i], data);
+        if (send_status == SUCCESS)
+        {
+            delivered[i] = true;
+        }
+        else if (send_status == CLOSED_ERROR || send_status == GENERIC_ERROR)
+        {
+            status = (status == GENERIC_ERROR) ? GENERIC_ERROR : send_status;
+        }
+        else if (status == SUCCESS)
+        {
+            status = CHANNEL_FULL;
+        }
+    }
+
+    free(order);
+    free(closed);
+
+    return status;
+}
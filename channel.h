@@ -7,9 +7,12 @@
 #include <semaphore.h>
 #include "buffer.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
 #include "linked_list.h"
+#include "ring_map.h"
 
 // Defines possible return values from channel functions
 enum channel_status {
@@ -19,55 +22,119 @@ enum channel_status {
     GENERIC_ERROR = -1, // Generic error
     GEN_ERROR = -1,     // Unused: for instructor testing
     CLOSED_ERROR = -2,  // Channel has been closed
-    DESTROY_ERROR = -3  // Error during destroy
+    DESTROY_ERROR = -3, // Error during destroy
+    TIMEOUT = -4        // Deadline passed before the operation could complete
 };
 
-// Defines channel object
+// Defines the state that only matters once a thread blocks, selects or completes an unbuffered handoff on a channel
+// Most channels in a large deployment sit idle, so this lives outside the channel and is only allocated on first use
 typedef struct {
-    // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
-    // YOU MUST USE buffer TO STORE YOUR CHANNEL MESSAGES
-    buffer_t* buffer;
-
-    /* ADD ANY STRUCT ENTRIES YOU NEED HERE */
-    /* IMPLEMENT THIS */
-    pthread_mutex_t mutex;
     pthread_mutex_t select_mutex;
     pthread_cond_t cond_full;
     pthread_cond_t cond_empty;
     pthread_cond_t cond_waiting_stage;
     pthread_cond_t cond_completed_stage;
-    bool is_closed;
-    list_t* semaphore_select_list_send;
-    list_t* semaphore_select_list_recv;
+    list_t semaphore_select_list_send;
+    list_t semaphore_select_list_recv;
     int unbuffered_operation;
     int unbuffered_stage;
-    int unbuffered;
-    int send_waiting_count;
-    int recv_waiting_count;
     void** data;
+    // set while a SEND_LAZY select case waits in stage 1, its message is only built once a receiver commits
+    struct select_producer* producer;
     int send_waiting;
     int recv_waiting;
+} channel_waiters_t;
+
+// Defines channel object
+typedef struct {
+    // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
+    // YOU MUST USE buffer TO STORE YOUR CHANNEL MESSAGES
+    buffer_t* buffer;
+
+    /* ADD ANY STRUCT ENTRIES YOU NEED HERE */
+    /* IMPLEMENT THIS */
+    pthread_mutex_t mutex;
+    // NULL until the channel first needs it, see channel_waiters_t; unbuffered channels always have it
+    channel_waiters_t* waiters;
+    // endpoint reference counts, both start at 1 for the endpoints every channel is created with
+    // 32 bits keep the channel and its buffer within 128 bytes
+    uint32_t senders;
+    uint32_t receivers;
+    bool is_closed;
+    bool write_closed;
+    bool unbuffered;
+    // the channel's block was mapped by channel_create_on_node instead of coming from the slab
+    bool on_node;
 } channel_t;
 
 // Defines channel list structure for channel_select function
 enum direction {
     SEND,
     RECV,
+    SEND_LAZY,
 };
 typedef struct {
     // Channel on which we want to perform operation
     channel_t* channel;
-    // Specifies whether we want to receive (RECV) or send (SEND) on the channel
+    // Specifies whether we want to receive (RECV) or send (SEND or SEND_LAZY) on the channel
     enum direction dir;
     // If dir is RECV, then the message received from the channel is stored as an output in this parameter, data
     // If dir is SEND, then the message that needs to be sent is given as input in this parameter, data
+    // If dir is SEND_LAZY, then data points to a select_producer_t that builds the message once this case is selected
     void* data;
 } select_t;
 
+// Defines the payload source of a SEND_LAZY case in channel_select
+// produce(ctx) is only called for the case that wins the select, after a buffer slot or an unbuffered partner has been reserved
+// produce runs with the channel's lock held, so it must not operate on that channel
+typedef struct select_producer {
+    // Builds the message to send, given ctx as input
+    void* (*produce)(void* ctx);
+    // Passed to produce as is
+    void* ctx;
+    // Output: the message that produce returned, left untouched if produce was not called
+    // If the select then fails with TIMEOUT or CLOSED_ERROR on an unbuffered channel, this message was not delivered and still belongs to the caller
+    void* produced;
+} select_producer_t;
+
+// Defines the sending and receiving endpoints of a channel
+// Every handle holds one reference on its side of the channel, the channel is closed automatically when a side loses its last reference
+typedef struct {
+    channel_t* channel;
+} channel_sender_t;
+typedef struct {
+    channel_t* channel;
+} channel_receiver_t;
+
 // Creates a new channel with the provided size and returns it to the caller
 // A 0 size indicates an unbuffered channel, whereas a positive size indicates a buffered channel
 channel_t* channel_create(size_t size);
 
+// Creates a new conflating channel with the provided size and returns it to the caller
+// A conflating channel behaves like a buffered channel, except that messages sent with channel_send_keyed collapse by key
+// Returns NULL if size is 0
+channel_t* channel_create_conflating(size_t size);
+
+// Creates a new buffered channel of the given size whose ring is an anonymous mapping instead of part of the channel's allocation, and returns it to the caller
+// Meant for rings with millions of slots: the mapping is made of whole 2 MiB huge pages, so the ring costs few TLB entries
+// flags is a combination of ring_map_flags, RING_MAP_HUGETLB asks for reserved huge pages and RING_MAP_PREFAULT faults the ring in up front instead of on first use
+// Returns NULL if size is 0 or if the mapping failed
+channel_t* channel_create_mapped(size_t size, int flags);
+
+// Creates a new channel with the provided size whose block, ring included, is placed on the given NUMA node, and returns it to the caller
+// Use the node of the threads that operate on the channel most, e.g. the receiver's, so the channel is not placed wherever it is first touched
+// The block is a mapping of its own in whole pages, so this is meant for long lived channels rather than for channels created in large numbers
+// Returns NULL if the node does not exist or the mapping failed
+channel_t* channel_create_on_node(size_t size, int node);
+
+// Grows the capacity of a channel created with channel_create_mapped to size, keeping the buffered messages in FIFO order
+// The ring is extended in place through mremap where possible, and its pages are moved rather than copied otherwise
+// Blocked senders are woken up to use the new room
+// Returns SUCCESS if the channel has the new capacity,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the channel was not created with channel_create_mapped, if size is smaller than its capacity, or if the mapping could not grow
+enum channel_status channel_grow(channel_t* channel, size_t size);
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -100,13 +167,112 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
 
+// Writes data to the given channel, blocking at most until deadline, an absolute CLOCK_MONOTONIC time
+// Behaves like channel_send, except that it returns TIMEOUT if the data could not be written before the deadline
+// A timed out send on an unbuffered channel is withdrawn completely, so its data is never delivered afterwards
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline);
+
+// Reads data from the given channel, blocking at most until deadline, an absolute CLOCK_MONOTONIC time
+// Behaves like channel_receive, except that it returns TIMEOUT if no data could be read before the deadline
+// On TIMEOUT nothing is stored in data
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline);
+
+// Writes data to the given conflating channel under key
+// If a message sent under the same key has not been received yet, it is replaced by data and keeps its place in the channel, so receivers only see the latest message per key
+// Otherwise data is written like channel_send, blocking while the channel is full
+// Messages written with any other send function have no key and are never replaced
+// displaced, unless NULL, is set to the replaced message so the caller can reuse it, or to NULL if nothing was replaced
+// Returns SUCCESS for successfully writing data to the channel,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the channel was not created with channel_create_conflating or on any other generic error of any sort
+enum channel_status channel_send_keyed(channel_t* channel, size_t key, void* data, void** displaced);
+
+// Writes up to count messages from items to the given channel in FIFO order
+// This is a non-blocking call that writes as many messages as the channel has room for, under a single lock acquisition and with a single wakeup
+// sent is set to the number of messages written, which may be less than count
+// Returns SUCCESS if at least one message was written (or count is 0),
+// CHANNEL_FULL if no message could be written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t count, size_t* sent);
+
+// Reads up to max messages from the given channel in FIFO order and stores them in out
+// This is a non-blocking call that reads everything available up to max, under a single lock acquisition and with a single wakeup
+// received is set to the number of messages read
+// Returns SUCCESS if at least one message was read (or max is 0),
+// CHANNEL_EMPTY if no message was available,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* received);
+
+// Same as channel_receive_batch, except that the call blocks until at least one message is available
+// Returns SUCCESS if at least one message was read (or max is 0),
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch_wait(channel_t* channel, void** out, size_t max, size_t* received);
+
+// Moves up to max messages from src to dst in FIFO order, for relaying between pipeline stages without a thread in between
+// Both channels must be buffered, and both locks are taken in address order while the messages are copied directly from one ring to the other
+// This is a non-blocking call that moves as many messages as src has and dst has room for, with a single wakeup on each side
+// forwarded is set to the number of messages moved
+// Returns SUCCESS if at least one message was moved (or max is 0),
+// CHANNEL_EMPTY if src had no message or dst had no room,
+// CLOSED_ERROR if either channel is closed (messages left in a src closed by channel_close_write are still moved), and
+// GENERIC_ERROR if src and dst are the same or unbuffered, or on encountering any other generic error of any sort
+enum channel_status channel_forward(channel_t* src, channel_t* dst, size_t max, size_t* forwarded);
+
+// Same as channel_forward, except that the call blocks until at least one message can be moved
+// Returns SUCCESS if at least one message was moved (or max is 0),
+// CLOSED_ERROR if either channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_forward_wait(channel_t* src, channel_t* dst, size_t max, size_t* forwarded);
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
-// Returns SUCCESS if close is successful,
+// Returns SUCCESS if close is successful (including on a channel closed by channel_close_write),
 // CLOSED_ERROR if the channel is already closed, and
 // GENERIC_ERROR in any other error case
 enum channel_status channel_close(channel_t* channel);
 
+// Closes the channel for writing only, so that shutdown needs no sentinel messages
+// Send/select send operations behave as after channel_close, but receivers keep reading the messages still in the buffer
+// Receive/select receive operations only return CLOSED_ERROR once the buffer is empty
+// A later channel_close completes the close, after which the remaining messages can no longer be received
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_close_write(channel_t* channel);
+
+// Returns the sender handle that the channel was created with
+// This does not take a new reference, so it must only be used once per channel; use channel_sender_clone for every further sender
+channel_sender_t channel_sender(channel_t* channel);
+
+// Returns the receiver handle that the channel was created with
+// This does not take a new reference, so it must only be used once per channel; use channel_receiver_clone for every further receiver
+channel_receiver_t channel_receiver(channel_t* channel);
+
+// Returns a new sender handle for the same channel, which must eventually be given to channel_sender_drop
+channel_sender_t channel_sender_clone(channel_sender_t sender);
+
+// Returns a new receiver handle for the same channel, which must eventually be given to channel_receiver_drop
+channel_receiver_t channel_receiver_clone(channel_receiver_t receiver);
+
+// Releases a sender handle
+// Dropping the last sender closes the channel with channel_close_write, so receivers drain what is buffered and then get CLOSED_ERROR
+// Returns SUCCESS if the handle was released, and
+// GENERIC_ERROR if every sender handle was already dropped or on encountering any other generic error of any sort
+enum channel_status channel_sender_drop(channel_sender_t sender);
+
+// Releases a receiver handle
+// Dropping the last receiver abandons the channel: it is closed with channel_close, so blocked and future senders get CLOSED_ERROR instead of waiting forever
+// Returns SUCCESS if the handle was released, and
+// GENERIC_ERROR if every receiver handle was already dropped or on encountering any other generic error of any sort
+enum channel_status channel_receiver_drop(channel_receiver_t receiver);
+
+// Returns the number of bytes of memory the channel currently uses, including its ring and any waiter state it has allocated
+// An idle buffered channel that was never waited on or selected costs its block only, waiter state is added on first use
+size_t channel_footprint(channel_t* channel);
+
 // Frees all the memory allocated to the channel
 // The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
 // Returns SUCCESS if destroy is successful,
@@ -123,4 +289,37 @@ enum channel_status channel_destroy(channel_t* channel);
 // Additionally, selected_index is set to the index of the channel that generated the error
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 
+// Same as channel_select, except that the scan over channel_list starts at a randomly chosen case on every call
+// If multiple options are available, any of them may be selected, so cases near the front of the list cannot starve the rest
+// The start is drawn from a per-thread generator, so this adds no shared state or locking over channel_select
+enum channel_status channel_select_fair(select_t* channel_list, size_t channel_count, size_t* selected_index);
+
+// Same as channel_select, except that the call blocks at most until deadline, an absolute CLOCK_MONOTONIC time
+// Ready cases are still taken even if the deadline has already passed, so a past deadline behaves like a non-blocking select
+// Returns TIMEOUT if no case could be completed before the deadline, in which case selected_index is not modified
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline);
+
+// Writes data to the least loaded of the given channels, for dispatching work over a pool of workers
+// Two channels are chosen at random and their occupancy is compared without taking any lock (power of two choices)
+// If those are full, the remaining channels are tried, and the call only blocks when every channel is full
+// chosen is set to the index of the channel that received the data, or to the index of the channel that reported an error
+// Returns SUCCESS, CLOSED_ERROR or GENERIC_ERROR like channel_send
+enum channel_status channel_send_balanced(channel_t** channels, size_t channel_count, void* data, size_t* chosen);
+
+// Defines the flags for channel_send_multi
+enum multi_flags {
+    MULTI_BLOCKING = 0,     // Wait for room on every target
+    MULTI_NON_BLOCKING = 1, // Skip targets that have no room
+};
+
+// Writes the same data to every one of the given channels in a single call
+// Every buffered target with room gets the data in one pass, with all target locks taken together in address order
+// The remaining targets are then sent to one by one, blocking on each of them unless flags contains MULTI_NON_BLOCKING
+// delivered must have room for channel_count entries, delivered[i] is set to whether channels[i] received the data
+// Returns SUCCESS if every target received the data,
+// CHANNEL_FULL if MULTI_NON_BLOCKING was given and some target had no room,
+// CLOSED_ERROR if some target is closed (the data is still written to the other targets), and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_multi(channel_t** channels, size_t channel_count, void* data, int flags, bool* delivered);
+
 #endif // CHANNEL_H
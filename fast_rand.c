@@ -0,0 +1,41 @@
+#include <pthread.h>
+#include <time.h>
+#include "fast_rand.h"
+
+// Per-thread generator state, 0 means the thread has not been seeded yet
+static __thread uint64_t rand_state;
+
+// Mixes the seed material with splitmix64 so that nearby thread ids and addresses give unrelated sequences
+static uint64_t fast_rand_seed(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t seed = (uint64_t)pthread_self() ^ (uint64_t)(uintptr_t)&rand_state ^ (uint64_t)now.tv_nsec;
+    seed += 0x9e3779b97f4a7c15ull;
+    seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+    seed ^= seed >> 31;
+    // xorshift must never be seeded with 0
+    return (seed == 0) ? 1 : seed;
+}
+
+// Returns the next value from the calling thread's generator
+uint32_t fast_rand(void)
+{
+    uint64_t x = rand_state;
+    if (x == 0) {
+        x = fast_rand_seed();
+    }
+    // xorshift64*
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rand_state = x;
+    return (uint32_t)((x * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+// Returns a value in the range [0, n) from the calling thread's generator
+size_t fast_rand_n(size_t n)
+{
+    return (size_t)(((uint64_t)fast_rand() * (uint64_t)n) >> 32);
+}
@@ -0,0 +1,15 @@
+#ifndef FAST_RAND_H
+#define FAST_RAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns the next value from the calling thread's generator
+// Each thread owns its own xorshift state, which is seeded lazily on first use, so no locking or sharing is involved
+uint32_t fast_rand(void);
+
+// Returns a value in the range [0, n) from the calling thread's generator
+// Uses a multiply-shift reduction instead of a modulo, n must be smaller than 2^32
+size_t fast_rand_n(size_t n);
+
+#endif // FAST_RAND_H
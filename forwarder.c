@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include "forwarder.h"
+
+// Body of the forwarder thread
+void* channel_forwarder_run(void* arg)
+{
+    channel_forwarder_t* forwarder = (channel_forwarder_t*) arg;
+    size_t forwarded = 0;
+    enum channel_status status;
+
+    while ((status = channel_forward_wait(forwarder->src, forwarder->dst, forwarder->batch, &forwarded)) == SUCCESS) {
+        forwarder->forwarded += forwarded;
+    }
+    forwarder->status = status;
+
+    return NULL;
+}
+
+// Starts a thread that forwards messages from src to dst
+channel_forwarder_t* channel_forwarder_start(channel_t* src, channel_t* dst, size_t batch)
+{
+    if (batch == 0 || src == dst || src->unbuffered || dst->unbuffered) {
+        return NULL;
+    }
+
+    channel_forwarder_t* forwarder = (channel_forwarder_t*) malloc(sizeof(channel_forwarder_t));
+    if (forwarder == NULL) {
+        return NULL;
+    }
+    forwarder->src = src;
+    forwarder->dst = dst;
+    forwarder->batch = batch;
+    forwarder->forwarded = 0;
+    forwarder->status = SUCCESS;
+
+    if (pthread_create(&forwarder->thread, NULL, channel_forwarder_run, forwarder) != 0) {
+        free(forwarder);
+        return NULL;
+    }
+
+    return forwarder;
+}
+
+// Waits for the forwarder thread to stop and frees the forwarder
+enum channel_status channel_forwarder_stop(channel_forwarder_t* forwarder, size_t* forwarded)
+{
+    if (pthread_join(forwarder->thread, NULL) != 0) {
+        return GENERIC_ERROR;
+    }
+
+    enum channel_status status = forwarder->status;
+    if (forwarded != NULL) {
+        *forwarded = forwarder->forwarded;
+    }
+    free(forwarder);
+
+    return status;
+}
@@ -0,0 +1,32 @@
+#ifndef FORWARDER_H
+#define FORWARDER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "channel.h"
+
+// Defines a background forwarder that keeps moving messages from one buffered channel to another
+// Each wakeup of its thread moves everything that is available at once, instead of receiving and re-sending every message
+typedef struct {
+    pthread_t thread;
+    channel_t* src;
+    channel_t* dst;
+    size_t batch;
+    // set by the forwarder thread, read after channel_forwarder_stop has joined it
+    size_t forwarded;
+    enum channel_status status;
+} channel_forwarder_t;
+
+// Starts a thread that forwards messages from src to dst, up to batch messages per move, and returns its handle to the caller
+// The thread runs until either channel is closed, so closing src is how a forwarder is stopped
+// If src is closed with channel_close_write, the messages still in it are moved before the forwarder stops
+// Closing only dst stops it too, but not before it finds a message to move
+// Returns NULL if batch is 0, if src and dst are the same or unbuffered, or if the thread could not be started
+channel_forwarder_t* channel_forwarder_start(channel_t* src, channel_t* dst, size_t batch);
+
+// Waits for the forwarder thread to stop, frees the forwarder and returns the number of messages it moved in forwarded
+// Returns CLOSED_ERROR if the forwarder stopped because a channel was closed, and
+// GENERIC_ERROR if it stopped on any other generic error of any sort
+enum channel_status channel_forwarder_stop(channel_forwarder_t* forwarder, size_t* forwarded);
+
+#endif // FORWARDER_H
@@ -106,6 +106,33 @@ add_test_case_channel("test_stress_mixed_size1_size0", iters_one, timeout_channe
 add_test_case_sanitize("test_stress_mixed_size1_size0", iters_one, timeout_sanitize * 3)
 add_test_case_valgrind("test_stress_mixed_size1_size0", iters_one, timeout_valgrind * 3)
 
+# Extension tests
+add_test_cases("test_select_fairness", iters_one)
+add_test_cases("test_select_until", iters_slow)
+add_test_cases("test_send_receive_until", iters_slow)
+add_test_cases("test_select_lazy_send", iters_slow)
+add_test_cases("test_send_balanced", iters_slow)
+add_test_cases("test_batch_send_receive", iters_slow)
+add_test_cases("test_send_multi", iters_slow)
+add_test_cases("test_broadcast", iters_slow)
+add_test_cases("test_send_keyed", iters_slow)
+add_test_cases("test_watch", iters_slow)
+add_test_cases("test_channel_writer", iters_slow)
+add_test_cases("test_channel_forward", iters_slow)
+add_test_cases("test_close_write", iters_slow)
+add_test_cases("test_endpoint_handles", iters_slow)
+add_test_cases("test_channel_call", iters_slow)
+add_test_cases("test_msg_pool", iters_slow)
+add_test_cases("test_channel_churn", iters_one)
+add_test_cases("test_channel_footprint", iters_one)
+add_test_cases("test_mapped_channel", iters_one)
+add_test_cases("test_msg_ref", iters_slow)
+add_test_cases("test_numa_placement", iters_one)
+add_test_cases("test_channel_spill", iters_slow)
+add_test_cases("test_log_channel", iters_slow)
+add_test_cases("test_shared_channel", iters_slow)
+add_test_cases("test_channel_bridge", iters_slow)
+
 # Score distribution
 point_breakdown_checkpoint = [
     # Basic (100 pts)
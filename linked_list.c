@@ -19,10 +19,25 @@ list_t* list_create()
     return new_list;
 }
 
+// Initializes a list that is embedded in another structure
+void list_init(list_t* list)
+{
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+}
+
 // Destroys a list
 void list_destroy(list_t* list)
 {
     /* IMPLEMENT THIS IF YOU WANT TO USE LINKED LISTS */
+    list_clear(list);
+    free(list);
+}
+
+// Removes every node of a list without freeing the list itself
+void list_clear(list_t* list)
+{
     list_node_t* current = list->head;
     list_node_t* next;
     while (current) {
@@ -30,7 +45,7 @@ void list_destroy(list_t* list)
         free(current);
         current = next;
     }
-    free(list);
+    list_init(list);
 }
 
 // Returns head of the list
@@ -18,9 +18,15 @@ typedef struct {
 // Creates and returns a new list
 list_t* list_create();
 
+// Initializes a list that is embedded in another structure instead of created with list_create
+void list_init(list_t* list);
+
 // Destroys a list
 void list_destroy(list_t* list);
 
+// Removes every node of a list without freeing the list itself, for lists set up with list_init
+void list_clear(list_t* list);
+
 // Returns head of the list
 list_node_t* list_head(list_t* list);
 
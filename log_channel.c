@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "log_channel.h"
+
+// Every record is a header followed by the message, padded to 8 bytes
+// A 0 size marks the unused end of a segment, which is why segments are created zero filled
+typedef struct {
+    uint32_t size;
+    uint32_t checksum;
+} log_record_t;
+
+#define LOG_ALIGN 8
+#define LOG_COMMIT_FILE "commit"
+
+// Returns the space a message of size bytes takes in a segment
+static size_t log_record_size(size_t size)
+{
+    return sizeof(log_record_t) + (size + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN;
+}
+
+// FNV-1a, enough to tell a torn record from a complete one
+static uint32_t log_checksum(const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t log_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+static uint64_t log_slot_checksum(const log_commit_slot_t* slot)
+{
+    return log_checksum(slot, offsetof(log_commit_slot_t, checksum));
+}
+
+// Maps segment index of the log, creating a zero filled file for it if create is true
+static log_segment_t* log_segment_map(log_channel_t* log, uint64_t index, bool create)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%020llu.seg", log->dir, (unsigned long long) index);
+
+    log_segment_t* segment = (log_segment_t*) malloc(sizeof(log_segment_t));
+    if (segment == NULL) {
+        return NULL;
+    }
+    segment->index = index;
+    segment->fd = open(path, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644);
+    if (segment->fd < 0) {
+        free(segment);
+        return NULL;
+    }
+    struct stat file;
+    if ((create && ftruncate(segment->fd, (off_t) log->segment_size) != 0) ||
+        fstat(segment->fd, &file) != 0 || (size_t) file.st_size != log->segment_size) {
+        close(segment->fd);
+        free(segment);
+        return NULL;
+    }
+    segment->base = (unsigned char*) mmap(NULL, log->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (segment->base == MAP_FAILED) {
+        close(segment->fd);
+        free(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+// Unmaps a segment, deleting its file if remove is true
+static void log_segment_unmap(log_channel_t* log, log_segment_t* segment, bool remove)
+{
+    munmap(segment->base, log->segment_size);
+    close(segment->fd);
+    if (remove) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%020llu.seg", log->dir, (unsigned long long) segment->index);
+        unlink(path);
+    }
+    free(segment);
+}
+
+// Returns the offset right after the last complete record of a segment that was written before a restart
+// A record that was only partly written back before a crash fails its checksum, and it and everything after it are cleared
+static size_t log_segment_end(log_channel_t* log, log_segment_t* segment)
+{
+    size_t offset = 0;
+    while (offset + sizeof(log_record_t) <= log->segment_size) {
+        log_record_t* record = (log_record_t*) (segment->base + offset);
+        if (record->size == 0 || offset + log_record_size(record->size) > log->segment_size ||
+            log_checksum(record + 1, record->size) != record->checksum) {
+            break;
+        }
+        offset += log_record_size(record->size);
+    }
+    memset(segment->base + offset, 0, log->segment_size - offset);
+    return offset;
+}
+
+static int log_compare_index(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Opens the commit file of the log and restores the last committed position from it
+static bool log_open_commits(log_channel_t* log)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/" LOG_COMMIT_FILE, log->dir);
+    log->commit_fd = open(path, O_RDWR | O_CREAT, 0644);
+    size_t size = 2 * sizeof(log_commit_slot_t);
+    if (log->commit_fd < 0) {
+        return false;
+    }
+    if (ftruncate(log->commit_fd, (off_t) size) != 0) {
+        close(log->commit_fd);
+        return false;
+    }
+    log->commit_slots = (log_commit_slot_t*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, log->commit_fd, 0);
+    if (log->commit_slots == MAP_FAILED) {
+        close(log->commit_fd);
+        return false;
+    }
+
+    log->commits = 0;
+    log->committed.segment = 0;
+    log->committed.offset = 0;
+    for (size_t i = 0; i < 2; i++) {
+        log_commit_slot_t* slot = &log->commit_slots[i];
+        if (slot->sequence > log->commits && slot->checksum == log_slot_checksum(slot)) {
+            log->commits = slot->sequence;
+            log->committed = slot->position;
+        }
+    }
+    return true;
+}
+
+// Maps the segments that are not fully committed, deleting the ones that are
+static bool log_open_segments(log_channel_t* log)
+{
+    DIR* dir = opendir(log->dir);
+    if (dir == NULL) {
+        return false;
+    }
+    size_t count = 0;
+    size_t capacity = 16;
+    uint64_t* indexes = (uint64_t*) malloc(capacity * sizeof(uint64_t));
+    struct dirent* entry;
+    while (indexes != NULL && (entry = readdir(dir)) != NULL) {
+        unsigned long long index;
+        char suffix[8];
+        if (sscanf(entry->d_name, "%20llu.%7s", &index, suffix) != 2 || strcmp(suffix, "seg") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            uint64_t* grown = (uint64_t*) realloc(indexes, capacity * sizeof(uint64_t));
+            if (grown == NULL) {
+                free(indexes);
+                indexes = NULL;
+                break;
+            }
+            indexes = grown;
+        }
+        indexes[count++] = index;
+    }
+    closedir(dir);
+    if (indexes == NULL) {
+        return false;
+    }
+    qsort(indexes, count, sizeof(uint64_t), log_compare_index);
+
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        log_segment_t* segment = log_segment_map(log, indexes[i], false);
+        if (segment == NULL) {
+            ok = false;
+        } else if (segment->index < log->committed.segment) {
+            // a commit that was written back before its segments were deleted
+            log_segment_unmap(log, segment, true);
+        } else {
+            ok = list_insert(log->segments, segment) != NULL;
+        }
+    }
+    free(indexes);
+    if (ok && list_count(log->segments) == 0) {
+        log_segment_t* segment = log_segment_map(log, log->committed.segment, true);
+        ok = segment != NULL && list_insert(log->segments, segment) != NULL;
+    }
+    return ok;
+}
+
+// Opens the log channel kept in dir
+log_channel_t* log_channel_open(const char* dir, size_t segment_size, size_t sync_interval_ms)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    segment_size = (segment_size + page - 1) / page * page;
+    if (segment_size == 0 || segment_size > UINT32_MAX) {
+        return NULL;
+    }
+
+    log_channel_t* log = (log_channel_t*) calloc(1, sizeof(log_channel_t));
+    if (log == NULL) {
+        return NULL;
+    }
+    log->dir = strdup(dir);
+    log->segments = list_create();
+    log->segment_size = segment_size;
+    log->sync_interval_ns = (uint64_t) sync_interval_ms * 1000000ull;
+    if (log->dir == NULL || log->segments == NULL || !log_open_commits(log)) {
+        if (log->segments != NULL) {
+            list_destroy(log->segments);
+        }
+        free(log->dir);
+        free(log);
+        return NULL;
+    }
+    if (!log_open_segments(log)) {
+        log_channel_destroy(log);
+        return NULL;
+    }
+
+    // the reader resumes at the committed position, and appends continue after the last complete record
+    // the commit page can reach the disk before the data it covers, so a reader in the last segment never resumes past its end
+    log->read_segment = list_head(log->segments);
+    log_segment_t* first = (log_segment_t*) list_data(log->read_segment);
+    log->read_offset = first->index == log->committed.segment ? log->committed.offset : 0;
+    log->write_segment = list_tail(log->segments);
+    log->write_offset = log_segment_end(log, (log_segment_t*) list_data(log->write_segment));
+    if (log->read_segment == log->write_segment && log->read_offset > log->write_offset) {
+        log->read_offset = log->write_offset;
+    }
+    log->synced_offset = 0;
+    log->last_sync = log_now();
+    pthread_mutex_init(&log->mutex, NULL);
+    pthread_cond_init(&log->cond_append, NULL);
+
+    return log;
+}
+
+// Writes back the appends and commits since the last write back, with the log's mutex held
+static bool log_sync_locked(log_channel_t* log)
+{
+    bool ok = true;
+    log_segment_t* segment = (log_segment_t*) list_data(log->write_segment);
+    if (log->write_offset > log->synced_offset) {
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        size_t start = log->synced_offset / page * page;
+        ok = msync(segment->base + start, log->write_offset - start, MS_SYNC) == 0;
+        log->synced_offset = log->write_offset;
+    }
+    if (log->commit_dirty) {
+        ok = msync(log->commit_slots, 2 * sizeof(log_commit_slot_t), MS_SYNC) == 0 && ok;
+        log->commit_dirty = false;
+    }
+    log->last_sync = log_now();
+    return ok;
+}
+
+// Writes back once the sync interval has passed, with the log's mutex held
+static bool log_maybe_sync(log_channel_t* log)
+{
+    if (log->sync_interval_ns > 0 && log_now() - log->last_sync < log->sync_interval_ns) {
+        return true;
+    }
+    return log_sync_locked(log);
+}
+
+// Appends a copy of the size bytes at data to the log
+enum channel_status log_channel_send(log_channel_t* log, const void* data, size_t size)
+{
+    size_t record_size = log_record_size(size);
+    if (size == 0 || record_size > log->segment_size) {
+        return GENERIC_ERROR;
+    }
+
+    pthread_mutex_lock(&log->mutex);
+
+    if (log->is_closed) {
+        pthread_mutex_unlock(&log->mutex);
+        return CLOSED_ERROR;
+    }
+
+    if (log->write_offset + record_size > log->segment_size) {
+        // the rest of the segment stays zero, which tells the reader to move on
+        // the full segment is written back before the next one exists, so only the last segment can end in a torn record
+        log->synced_offset = 0;
+        if (!log_sync_locked(log)) {
+            pthread_mutex_unlock(&log->mutex);
+            return GENERIC_ERROR;
+        }
+        log_segment_t* current = (log_segment_t*) list_data(log->write_segment);
+        log_segment_t* next = log_segment_map(log, current->index + 1, true);
+        if (next == NULL || list_insert(log->segments, next) == NULL) {
+            if (next != NULL) {
+                log_segment_unmap(log, next, true);
+            }
+            pthread_mutex_unlock(&log->mutex);
+            return GENERIC_ERROR;
+        }
+        log->write_segment = list_tail(log->segments);
+        log->write_offset = 0;
+        log->synced_offset = 0;
+    }
+
+    log_segment_t* segment = (log_segment_t*) list_data(log->write_segment);
+    log_record_t* record = (log_record_t*) (segment->base + log->write_offset);
+    memcpy(record + 1, data, size);
+    record->checksum = log_checksum(data, size);
+    record->size = (uint32_t) size;
+    log->write_offset += record_size;
+
+    bool synced = log_maybe_sync(log);
+    pthread_cond_signal(&log->cond_append);
+    pthread_mutex_unlock(&log->mutex);
+
+    return synced ? SUCCESS : GENERIC_ERROR;
+}
+
+// Takes the next message of the log, waiting for one if there is none
+enum channel_status log_channel_receive(log_channel_t* log, const void** data, size_t* size, log_position_t* position)
+{
+    pthread_mutex_lock(&log->mutex);
+
+    while (true) {
+        log_segment_t* segment = (log_segment_t*) list_data(log->read_segment);
+        bool last = log->read_segment == log->write_segment;
+        log_record_t* record = (log_record_t*) (segment->base + log->read_offset);
+        if (last ? log->read_offset < log->write_offset :
+                   log->read_offset + sizeof(log_record_t) <= log->segment_size && record->size != 0) {
+            *data = record + 1;
+            *size = record->size;
+            log->read_offset += log_record_size(record->size);
+            if (position != NULL) {
+                position->segment = segment->index;
+                position->offset = log->read_offset;
+            }
+            pthread_mutex_unlock(&log->mutex);
+            return SUCCESS;
+        }
+        if (!last) {
+            log->read_segment = list_next(log->read_segment);
+            log->read_offset = 0;
+            continue;
+        }
+        if (log->is_closed) {
+            pthread_mutex_unlock(&log->mutex);
+            return CLOSED_ERROR;
+        }
+        pthread_cond_wait(&log->cond_append, &log->mutex);
+    }
+}
+
+// Marks every message up to position as consumed
+enum channel_status log_channel_commit(log_channel_t* log, log_position_t position)
+{
+    pthread_mutex_lock(&log->mutex);
+
+    // only messages the reader has taken can be consumed
+    uint64_t read_index = ((log_segment_t*) list_data(log->read_segment))->index;
+    if (position.segment < log->committed.segment ||
+        (position.segment == log->committed.segment && position.offset < log->committed.offset) ||
+        position.segment > read_index || (position.segment == read_index && position.offset > log->read_offset)) {
+        pthread_mutex_unlock(&log->mutex);
+        return GENERIC_ERROR;
+    }
+
+    log_commit_slot_t* slot = &log->commit_slots[(log->commits + 1) % 2];
+    slot->position = position;
+    slot->sequence = log->commits + 1;
+    slot->checksum = log_slot_checksum(slot);
+    log->commits++;
+    log->committed = position;
+    log->commit_dirty = true;
+
+    // the reader is at or past the committed position, so these segments are never read again
+    list_node_t* node = list_head(log->segments);
+    while (node != log->read_segment && ((log_segment_t*) list_data(node))->index < position.segment) {
+        list_node_t* next = list_next(node);
+        log_segment_unmap(log, (log_segment_t*) list_data(node), true);
+        list_remove(log->segments, node);
+        node = next;
+    }
+
+    bool synced = log_maybe_sync(log);
+    pthread_mutex_unlock(&log->mutex);
+
+    return synced ? SUCCESS : GENERIC_ERROR;
+}
+
+// Writes every append and commit back to disk now
+enum channel_status log_channel_sync(log_channel_t* log)
+{
+    pthread_mutex_lock(&log->mutex);
+    bool synced = log_sync_locked(log);
+    pthread_mutex_unlock(&log->mutex);
+    return synced ? SUCCESS : GENERIC_ERROR;
+}
+
+// Closes the log and wakes up a waiting reader
+enum channel_status log_channel_close(log_channel_t* log)
+{
+    pthread_mutex_lock(&log->mutex);
+
+    if (log->is_closed) {
+        pthread_mutex_unlock(&log->mutex);
+        return CLOSED_ERROR;
+    }
+    log->is_closed = true;
+    pthread_cond_broadcast(&log->cond_append);
+
+    pthread_mutex_unlock(&log->mutex);
+    return SUCCESS;
+}
+
+// Writes everything back, unmaps the log and frees all the memory allocated to it
+void log_channel_destroy(log_channel_t* log)
+{
+    if (log->write_segment != NULL) {
+        log_sync_locked(log);
+        pthread_cond_destroy(&log->cond_append);
+        pthread_mutex_destroy(&log->mutex);
+    }
+    for (list_node_t* node = list_head(log->segments); node != NULL; node = list_next(node)) {
+        log_segment_unmap(log, (log_segment_t*) list_data(node), false);
+    }
+    list_destroy(log->segments);
+    munmap(log->commit_slots, 2 * sizeof(log_commit_slot_t));
+    close(log->commit_fd);
+    free(log->dir);
+    free(log);
+}
@@ -0,0 +1,100 @@
+#ifndef LOG_CHANNEL_H
+#define LOG_CHANNEL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "channel.h"
+#include "linked_list.h"
+
+// Defines a position in a log channel, i.e. the place right after a message
+typedef struct {
+    uint64_t segment;
+    uint64_t offset;
+} log_position_t;
+
+// Defines a slot of the commit file
+typedef struct {
+    log_position_t position;
+    // the slot with the highest sequence is the latest commit
+    uint64_t sequence;
+    uint64_t checksum;
+} log_commit_slot_t;
+
+// Defines one segment file of a log channel, mapped in full
+typedef struct {
+    uint64_t index;
+    int fd;
+    unsigned char* base;
+} log_segment_t;
+
+// Defines a durable channel of byte messages, kept in memory mapped segment files in a directory
+// Messages are appended through the mapping and survive a restart of the process until the reader commits past them
+// A restarted log replays every message after the last committed position straight from the mapped files
+typedef struct {
+    char* dir;
+    size_t segment_size;
+    // an append or commit writes back once this long has passed since the last write back, 0 writes back on every call
+    uint64_t sync_interval_ns;
+    uint64_t last_sync;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_append;
+    bool is_closed;
+    // mapped segments in order, from the oldest one that is not fully committed to the one being appended to
+    list_t* segments;
+    // where the next message is appended, and how much of that segment has been written back
+    list_node_t* write_segment;
+    size_t write_offset;
+    size_t synced_offset;
+    // where the reader takes the next message
+    list_node_t* read_segment;
+    size_t read_offset;
+    // last committed position, and the two slots of the commit file it is written to alternately, so a torn write leaves the other one intact
+    log_position_t committed;
+    int commit_fd;
+    log_commit_slot_t* commit_slots;
+    uint64_t commits;
+    bool commit_dirty;
+} log_channel_t;
+
+// Opens the log channel kept in dir, which must exist, and returns it to the caller
+// A new log is created if dir has none, otherwise every message after the last committed position is replayed to the reader
+// Segments are segment_size bytes, rounded up to whole pages, and no message can be larger than a segment
+// Appends and commits are written back to disk in batches: an append or commit writes back everything since the last write back
+// once sync_interval_ms milliseconds have passed, 0 writes back on every call, and log_channel_sync writes back right away
+// Returns NULL if segment_size is too small or the files could not be opened or created
+log_channel_t* log_channel_open(const char* dir, size_t segment_size, size_t sync_interval_ms);
+
+// Appends a copy of the size bytes at data to the log
+// Returns SUCCESS if the message was appended,
+// CLOSED_ERROR if the log is closed, and
+// GENERIC_ERROR if the message does not fit in a segment or a new segment could not be created
+enum channel_status log_channel_send(log_channel_t* log, const void* data, size_t size);
+
+// Takes the next message of the log, waiting for one if there is none
+// data is set to the message inside the mapping, which stays valid until the reader commits past it, and size to its length
+// position, unless NULL, is set to the position right after the message, to be given to log_channel_commit
+// Returns SUCCESS for successful retrieval of a message,
+// CLOSED_ERROR if the log is closed and every message was taken, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status log_channel_receive(log_channel_t* log, const void** data, size_t* size, log_position_t* position);
+
+// Marks every message up to position as consumed, so that they are not replayed after a restart
+// Segments that were consumed completely are deleted
+// Returns SUCCESS if the position was committed and GENERIC_ERROR if it is older than the last committed one or past the reader
+enum channel_status log_channel_commit(log_channel_t* log, log_position_t position);
+
+// Writes every append and commit back to disk now, instead of waiting for the sync interval
+// Returns SUCCESS if everything was written back and GENERIC_ERROR otherwise
+enum channel_status log_channel_sync(log_channel_t* log);
+
+// Closes the log and wakes up a waiting reader, which still takes the remaining messages
+// Returns SUCCESS if close is successful and CLOSED_ERROR if the log is already closed
+enum channel_status log_channel_close(log_channel_t* log);
+
+// Writes everything back, unmaps the log and frees all the memory allocated to it
+// The files stay in dir, so a later log_channel_open replays what was not committed
+void log_channel_destroy(log_channel_t* log);
+
+#endif // LOG_CHANNEL_H
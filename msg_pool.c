@@ -0,0 +1,171 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include "msg_pool.h"
+
+// Alignment of the payloads, which is also the size of the block header
+#define MSG_POOL_ALIGN 16
+
+_Static_assert(sizeof(msg_block_t) <= MSG_POOL_ALIGN, "block header must fit in front of an aligned payload");
+
+// Source of pool ids, so that a thread never mistakes a new pool for a destroyed one at the same address
+static uint64_t msg_pool_next_id = 1;
+
+// The cache the calling thread used last, which is the one it needs on nearly every call
+static __thread uint64_t last_pool_id;
+static __thread msg_pool_cache_t* last_cache;
+
+// Creates a new pool of blocks that hold at least size bytes each
+msg_pool_t* msg_pool_create(size_t size, size_t blocks_per_slab)
+{
+    if (size == 0 || blocks_per_slab == 0) {
+        return NULL;
+    }
+
+    msg_pool_t* pool = (msg_pool_t*) malloc(sizeof(msg_pool_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->caches = list_create();
+    pool->slabs = list_create();
+    if (pool->caches == NULL || pool->slabs == NULL) {
+        if (pool->caches != NULL) {
+            list_destroy(pool->caches);
+        }
+        if (pool->slabs != NULL) {
+            list_destroy(pool->slabs);
+        }
+        free(pool);
+        return NULL;
+    }
+
+    pool->id = __atomic_fetch_add(&msg_pool_next_id, 1, __ATOMIC_RELAXED);
+    pool->block_size = MSG_POOL_ALIGN + (size + MSG_POOL_ALIGN - 1) / MSG_POOL_ALIGN * MSG_POOL_ALIGN;
+    pool->blocks_per_slab = blocks_per_slab;
+    pthread_mutex_init(&pool->mutex, NULL);
+
+    return pool;
+}
+
+// Returns the calling thread's cache of the pool, creating it on first use
+msg_pool_cache_t* msg_pool_thread_cache(msg_pool_t* pool)
+{
+    if (last_pool_id == pool->id) {
+        return last_cache;
+    }
+
+    pthread_t self = pthread_self();
+    msg_pool_cache_t* cache = NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (list_node_t* node = list_head(pool->caches); node != NULL; node = list_next(node)) {
+        msg_pool_cache_t* candidate = list_data(node);
+        // a thread that reuses the id of an exited thread simply takes over its cache
+        if (pthread_equal(candidate->owner, self)) {
+            cache = candidate;
+            break;
+        }
+    }
+    if (cache == NULL) {
+        cache = (msg_pool_cache_t*) aligned_alloc(MSG_POOL_CACHE_LINE, sizeof(msg_pool_cache_t));
+        if (cache != NULL) {
+            cache->owner = self;
+            cache->local = NULL;
+            __atomic_store_n(&cache->remote, NULL, __ATOMIC_RELAXED);
+            if (list_insert(pool->caches, cache) == NULL) {
+                free(cache);
+                cache = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (cache != NULL) {
+        last_pool_id = pool->id;
+        last_cache = cache;
+    }
+    return cache;
+}
+
+// Carves a new slab into blocks for the given cache
+// Returns false on an allocation failure
+bool msg_pool_refill(msg_pool_t* pool, msg_pool_cache_t* cache)
+{
+    char* slab = (char*) aligned_alloc(MSG_POOL_ALIGN, pool->block_size * pool->blocks_per_slab);
+    if (slab == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    list_node_t* node = list_insert(pool->slabs, slab);
+    pthread_mutex_unlock(&pool->mutex);
+    if (node == NULL) {
+        free(slab);
+        return false;
+    }
+
+    for (size_t i = pool->blocks_per_slab; i > 0; i--) {
+        msg_block_t* block = (msg_block_t*) (slab + (i - 1) * pool->block_size);
+        block->cache = cache;
+        block->next = cache->local;
+        cache->local = block;
+    }
+    return true;
+}
+
+// Returns a block from the calling thread's cache of the pool
+void* msg_pool_alloc(msg_pool_t* pool)
+{
+    msg_pool_cache_t* cache = msg_pool_thread_cache(pool);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    if (cache->local == NULL) {
+        // take everything other threads gave back at once, there is a single taker so this cannot suffer from ABA
+        cache->local = __atomic_exchange_n(&cache->remote, NULL, __ATOMIC_ACQUIRE);
+        if (cache->local == NULL && !msg_pool_refill(pool, cache)) {
+            return NULL;
+        }
+    }
+
+    msg_block_t* block = cache->local;
+    cache->local = block->next;
+    return (char*) block + MSG_POOL_ALIGN;
+}
+
+// Gives a block back to the cache it was allocated from
+void msg_pool_free(void* payload)
+{
+    if (payload == NULL) {
+        return;
+    }
+
+    msg_block_t* block = (msg_block_t*) ((char*) payload - MSG_POOL_ALIGN);
+    msg_pool_cache_t* cache = block->cache;
+
+    if (pthread_equal(cache->owner, pthread_self())) {
+        block->next = cache->local;
+        cache->local = block;
+        return;
+    }
+
+    msg_block_t* head = __atomic_load_n(&cache->remote, __ATOMIC_RELAXED);
+    do {
+        block->next = head;
+    } while (!__atomic_compare_exchange_n(&cache->remote, &head, block, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Frees all the memory allocated to the pool
+void msg_pool_destroy(msg_pool_t* pool)
+{
+    for (list_node_t* node = list_head(pool->slabs); node != NULL; node = list_next(node)) {
+        free(list_data(node));
+    }
+    for (list_node_t* node = list_head(pool->caches); node != NULL; node = list_next(node)) {
+        free(list_data(node));
+    }
+    list_destroy(pool->slabs);
+    list_destroy(pool->caches);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
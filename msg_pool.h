@@ -0,0 +1,60 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "linked_list.h"
+
+#define MSG_POOL_CACHE_LINE 64
+
+// Header in front of every block, the payload starts right after it
+typedef struct msg_block {
+    // cache the block was carved for, which is where it goes back to when it is freed
+    struct msg_pool_cache* cache;
+    // next free block, only meaningful while the block is free
+    struct msg_block* next;
+} msg_block_t;
+
+// Defines the blocks owned by one thread of a pool
+// Only the owner allocates from it, any thread can give blocks back to it
+typedef struct msg_pool_cache {
+    pthread_t owner;
+    // free blocks only the owner touches, so it needs no synchronization
+    msg_block_t* local;
+    // blocks freed by other threads, pushed with a compare and swap and taken by the owner all at once
+    _Alignas(MSG_POOL_CACHE_LINE) msg_block_t* remote;
+} msg_pool_cache_t;
+
+// Defines a pool of fixed size message blocks
+// A block is allocated from the calling thread's cache and goes back to that same cache when it is freed, from whichever thread
+// This keeps a producer's blocks circulating between it and its consumers instead of going through malloc and free on different threads
+typedef struct {
+    // identifies the pool in the threads' cache lookups, since a later pool may reuse the address
+    uint64_t id;
+    size_t block_size;
+    size_t blocks_per_slab;
+    // protects the lists below, only taken when a thread first uses the pool or a cache runs dry
+    pthread_mutex_t mutex;
+    list_t* caches;
+    list_t* slabs;
+} msg_pool_t;
+
+// Creates a new pool of blocks that hold at least size bytes each, and returns it to the caller
+// Blocks are carved from the system blocks_per_slab at a time
+// Returns NULL if size or blocks_per_slab is 0, or on an allocation failure
+msg_pool_t* msg_pool_create(size_t size, size_t blocks_per_slab);
+
+// Returns a block from the calling thread's cache of the pool, or NULL on an allocation failure
+// The block is 16 byte aligned and its contents are undefined
+void* msg_pool_alloc(msg_pool_t* pool);
+
+// Gives a block back to the cache it was allocated from
+// The block can be freed by any thread, e.g. by the receiver of the message it carries
+void msg_pool_free(void* block);
+
+// Frees all the memory allocated to the pool, including every block that was not freed
+// The caller is responsible for making sure no thread uses the pool or its blocks anymore
+void msg_pool_destroy(msg_pool_t* pool);
+
+#endif // MSG_POOL_H
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include "msg_ref.h"
+
+// Returns the block size a msg_pool needs for messages with a payload of size bytes
+size_t msg_ref_size(size_t size)
+{
+    return sizeof(msg_ref_t) + size;
+}
+
+// Creates a new message with a payload of size bytes, holding one reference for the caller
+msg_ref_t* msg_ref_create(size_t size)
+{
+    msg_ref_t* ref = (msg_ref_t*) aligned_alloc(_Alignof(msg_ref_t), (msg_ref_size(size) + _Alignof(msg_ref_t) - 1) / _Alignof(msg_ref_t) * _Alignof(msg_ref_t));
+    if (ref == NULL) {
+        return NULL;
+    }
+    atomic_init(&ref->refs, 1);
+    ref->pool = NULL;
+    return ref;
+}
+
+// Creates a new message from a block of pool, holding one reference for the caller
+msg_ref_t* msg_ref_create_pooled(msg_pool_t* pool)
+{
+    msg_ref_t* ref = (msg_ref_t*) msg_pool_alloc(pool);
+    if (ref == NULL) {
+        return NULL;
+    }
+    atomic_init(&ref->refs, 1);
+    ref->pool = pool;
+    return ref;
+}
+
+// Returns the payload of the message
+void* msg_ref_data(msg_ref_t* ref)
+{
+    return ref->payload;
+}
+
+// Takes count more references on the message
+void msg_ref_retain(msg_ref_t* ref, size_t count)
+{
+    // the caller's reference keeps the message alive, so the increment needs no ordering
+    atomic_fetch_add_explicit(&ref->refs, count, memory_order_relaxed);
+}
+
+// Releases one reference, recycling the message if it was the last one
+void msg_ref_release(msg_ref_t* ref)
+{
+    // every holder's reads of the payload happen before the message is recycled
+    if (atomic_fetch_sub_explicit(&ref->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (ref->pool != NULL) {
+        msg_pool_free(ref);
+    } else {
+        free(ref);
+    }
+}
+
+// Sends the message to the channel with a reference of its own for the receiver
+enum channel_status msg_ref_send(channel_t* channel, msg_ref_t* ref)
+{
+    // the receiver may release its reference as soon as the message is in the channel, so it is taken first
+    msg_ref_retain(ref, 1);
+    enum channel_status status = channel_send(channel, ref);
+    if (status != SUCCESS) {
+        msg_ref_release(ref);
+    }
+    return status;
+}
+
+// Sends the message to every one of the given channels, with one reference per channel that received it
+enum channel_status msg_ref_send_multi(channel_t** channels, size_t channel_count, msg_ref_t* ref, int flags, bool* delivered)
+{
+    if (delivered == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    // channel_send_multi may fail before it fills delivered in, in which case nothing was sent
+    for (size_t i = 0; i < channel_count; i++) {
+        delivered[i] = false;
+    }
+    msg_ref_retain(ref, channel_count);
+    enum channel_status status = channel_send_multi(channels, channel_count, ref, flags, delivered);
+    for (size_t i = 0; i < channel_count; i++) {
+        if (!delivered[i]) {
+            msg_ref_release(ref);
+        }
+    }
+    return status;
+}
+
+// Takes the reference for the receiver of the selected case
+void* msg_ref_produce(void* ctx)
+{
+    msg_ref_t* ref = (msg_ref_t*) ctx;
+    msg_ref_retain(ref, 1);
+    return ref;
+}
+
+// Returns a producer for a SEND_LAZY case of channel_select that sends the message
+select_producer_t msg_ref_producer(msg_ref_t* ref)
+{
+    select_producer_t producer = {.produce = msg_ref_produce, .ctx = ref, .produced = NULL};
+    return producer;
+}
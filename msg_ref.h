@@ -0,0 +1,55 @@
+#ifndef MSG_REF_H
+#define MSG_REF_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "channel.h"
+#include "msg_pool.h"
+
+// Defines a reference counted message, for sending one payload to many receivers without copying it
+// Whoever holds a reference may read the payload, and the last one to release it recycles the message
+// The payload must not be modified once the message has been sent to anyone
+typedef struct {
+    atomic_size_t refs;
+    // pool the message came from, or NULL if it was allocated with malloc
+    msg_pool_t* pool;
+    _Alignas(16) unsigned char payload[];
+} msg_ref_t;
+
+// Returns the block size a msg_pool needs for messages with a payload of size bytes
+size_t msg_ref_size(size_t size);
+
+// Creates a new message with a payload of size bytes, holding one reference for the caller
+// Returns NULL on an allocation failure
+msg_ref_t* msg_ref_create(size_t size);
+
+// Creates a new message from a block of pool, holding one reference for the caller
+// The pool must have been created with a block size of at least msg_ref_size(payload size)
+// Returns NULL on an allocation failure
+msg_ref_t* msg_ref_create_pooled(msg_pool_t* pool);
+
+// Returns the payload of the message
+void* msg_ref_data(msg_ref_t* ref);
+
+// Takes count more references on the message, the caller must already hold one
+void msg_ref_retain(msg_ref_t* ref, size_t count);
+
+// Releases one reference, recycling the message if it was the last one
+void msg_ref_release(msg_ref_t* ref);
+
+// Sends the message to the channel with a reference of its own for the receiver, who must release it
+// The caller keeps its reference either way
+// Returns what channel_send returns
+enum channel_status msg_ref_send(channel_t* channel, msg_ref_t* ref);
+
+// Sends the message to every one of the given channels like channel_send_multi, with one reference per channel that received it
+// The caller keeps its reference either way
+// Returns what channel_send_multi returns
+enum channel_status msg_ref_send_multi(channel_t** channels, size_t channel_count, msg_ref_t* ref, int flags, bool* delivered);
+
+// Returns a producer for a SEND_LAZY case of channel_select that sends the message
+// Only the case that is selected takes a reference for its receiver, so the same producer can back any number of cases
+// If the select fails after the reference was taken (see select_producer_t), the caller must release produced
+select_producer_t msg_ref_producer(msg_ref_t* ref);
+
+#endif // MSG_REF_H
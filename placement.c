@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "placement.h"
+
+// Number of nodes in each word of an mbind node mask
+#define PLACEMENT_MASK_BITS (sizeof(unsigned long) * 8)
+
+// Returns the number of bytes placement_map maps for bytes bytes
+size_t placement_size(size_t bytes)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return (bytes + page - 1) / page * page;
+}
+
+// Returns a new anonymous mapping whose pages are placed on the given NUMA node
+void* placement_map(size_t bytes, int node)
+{
+    if (bytes == 0 || node < 0 || node >= PLACEMENT_MAX_NODES) {
+        return NULL;
+    }
+
+    size_t length = placement_size(bytes);
+    void* block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+        return NULL;
+    }
+
+    // the policy has to be set before any page is touched, so MAP_POPULATE cannot be used
+    // called directly so that libnuma is not needed, the kernel rejects nodes that do not exist
+    // the kernel only reads maxnode - 1 bits of the mask, so it gets one more than the nodes it should see and the mask has room for that bit
+    unsigned long nodemask[(PLACEMENT_MAX_NODES + 1 + PLACEMENT_MASK_BITS - 1) / PLACEMENT_MASK_BITS] = {0};
+    nodemask[(size_t) node / PLACEMENT_MASK_BITS] = 1UL << ((size_t) node % PLACEMENT_MASK_BITS);
+    if (syscall(SYS_mbind, block, length, MPOL_PREFERRED, nodemask, PLACEMENT_MAX_NODES + 1, 0) != 0) {
+        munmap(block, length);
+        return NULL;
+    }
+    if (madvise(block, length, MADV_POPULATE_WRITE) != 0) {
+        // kernels before 5.14, touch every page instead
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < length; offset += page) {
+            ((volatile char*) block)[offset] = 0;
+        }
+    }
+    return block;
+}
+
+// Unmaps a mapping returned by placement_map
+void placement_unmap(void* block, size_t bytes)
+{
+    if (block != NULL) {
+        munmap(block, placement_size(bytes));
+    }
+}
+
+// Returns the NUMA node of the given CPU, or -1 if it is unknown
+int placement_cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    // the CPU's directory links to its node as nodeN
+    int node = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int parsed;
+        if (sscanf(entry->d_name, "node%d", &parsed) == 1) {
+            node = parsed;
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// Parses a CPU list such as "0-3,8,10-11" into cpus
+size_t placement_parse_cpus(const char* list, int* cpus, size_t max)
+{
+    size_t count = 0;
+    const char* next = list;
+    while (*next != '\0' && *next != '\n') {
+        char* end;
+        long first = strtol(next, &end, 10);
+        if (end == next || first < 0) {
+            return 0;
+        }
+        long last = first;
+        if (*end == '-') {
+            next = end + 1;
+            last = strtol(next, &end, 10);
+            if (end == next || last < first) {
+                return 0;
+            }
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max || cpu >= PLACEMENT_MAX_CPUS) {
+                return 0;
+            }
+            cpus[count++] = (int) cpu;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0' && *end != '\n') {
+            return 0;
+        }
+        next = end;
+    }
+    return count;
+}
+
+// Stores the online CPUs of the system as a CPU list in list
+bool placement_online_cpus(char* list, size_t size)
+{
+    FILE* file = fopen("/sys/devices/system/cpu/online", "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool read = fgets(list, (int) size, file) != NULL;
+    fclose(file);
+    if (read) {
+        list[strcspn(list, "\n")] = '\0';
+    }
+    return read;
+}
+
+// Returns true if the calling thread may run on the given CPU
+bool placement_cpu_allowed(int cpu)
+{
+    cpu_set_t set;
+    if (cpu < 0 || cpu >= CPU_SETSIZE || pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+    return CPU_ISSET((size_t) cpu, &set);
+}
+
+// Parses list into cpus and checks that every CPU in it is available
+size_t placement_check_cpus(const char* list, const char* caller, int* cpus, size_t max)
+{
+    size_t count = placement_parse_cpus(list, cpus, max);
+    if (count == 0) {
+        fprintf(stderr, "%s: malformed CPU list \"%s\"\n", caller, list);
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!placement_cpu_allowed(cpus[i])) {
+            fprintf(stderr, "%s: CPU %d is not available\n", caller, cpus[i]);
+            return 0;
+        }
+    }
+    return count;
+}
+
+// Creates the channel of worker index on the node of the CPU the worker is pinned to
+channel_t* channel_create_for_worker(size_t size, size_t index, const int* cpus, size_t ncpus)
+{
+    if (ncpus > 0) {
+        channel_t* channel = channel_create_on_node(size, placement_cpu_node(cpus[index % ncpus]));
+        if (channel != NULL) {
+            return channel;
+        }
+    }
+    return channel_create(size);
+}
+
+// Pins the calling thread to the given CPU
+bool placement_pin(int cpu)
+{
+    return placement_pin_any(&cpu, 1);
+}
+
+// Lets the calling thread run on any of the given CPUs
+bool placement_pin_any(const int* cpus, size_t count)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < count; i++) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET((size_t) cpus[i], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -0,0 +1,56 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "channel.h"
+
+// Highest number of NUMA nodes and CPUs the placement helpers handle
+#define PLACEMENT_MAX_NODES 64
+#define PLACEMENT_MAX_CPUS 1024
+
+// Returns a new anonymous mapping of at least bytes bytes whose pages are placed on the given NUMA node
+// The pages are faulted in right away, so they do not end up on whichever node first touches them
+// Placement is preferred rather than strict: if the node runs out of memory, the kernel falls back to other nodes
+// Returns NULL if the node does not exist or the mapping failed
+void* placement_map(size_t bytes, int node);
+
+// Returns the number of bytes placement_map maps for bytes bytes, i.e. bytes rounded up to whole pages
+size_t placement_size(size_t bytes);
+
+// Unmaps a mapping returned by placement_map, bytes must be the size it was created with
+void placement_unmap(void* block, size_t bytes);
+
+// Returns the NUMA node of the given CPU, or -1 if it is unknown
+int placement_cpu_node(int cpu);
+
+// Parses a CPU list such as "0-3,8,10-11" into cpus, which has room for max entries
+// Returns the number of CPUs stored, or 0 if the list is malformed or empty
+size_t placement_parse_cpus(const char* list, int* cpus, size_t max);
+
+// Stores the online CPUs of the system as a CPU list in list, which has room for size bytes
+// Returns false if the list could not be read
+bool placement_online_cpus(char* list, size_t size);
+
+// Returns true if the calling thread may run on the given CPU, i.e. placement_pin(cpu) would succeed for it and for the threads it creates
+bool placement_cpu_allowed(int cpu);
+
+// Parses list into cpus like placement_parse_cpus, and checks that the calling thread may run on every CPU in it
+// Meant to run before any pinned thread starts, so a bad list fails the caller instead of one of its threads
+// The first problem is reported on stderr, prefixed with caller
+// Returns the number of CPUs stored, or 0 if the list is malformed, empty, or names a CPU that is not available
+size_t placement_check_cpus(const char* list, const char* caller, int* cpus, size_t max);
+
+// Creates the channel of worker index, which is pinned to cpus[index % ncpus], on the node of that CPU
+// Falls back to channel_create if ncpus is 0, the node is unknown, or the channel could not be placed
+channel_t* channel_create_for_worker(size_t size, size_t index, const int* cpus, size_t ncpus);
+
+// Pins the calling thread to the given CPU
+// Returns false if the CPU is not available to the thread
+bool placement_pin(int cpu);
+
+// Lets the calling thread run on any of the count given CPUs, e.g. to undo placement_pin
+// Returns false if none of the CPUs is available to the thread
+bool placement_pin_any(const int* cpus, size_t count);
+
+#endif // PLACEMENT_H
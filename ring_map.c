@@ -0,0 +1,65 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include "ring_map.h"
+
+// Returns the number of bytes mapped for a ring of capacity values
+size_t ring_map_size(size_t capacity)
+{
+    size_t bytes = capacity * sizeof(void*);
+    return (bytes + RING_MAP_HUGE_PAGE - 1) / RING_MAP_HUGE_PAGE * RING_MAP_HUGE_PAGE;
+}
+
+// Returns a new anonymous mapping with room for capacity values
+void** ring_map(size_t capacity, int flags)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    size_t length = ring_map_size(capacity);
+    int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (flags & RING_MAP_PREFAULT) {
+        map_flags |= MAP_POPULATE;
+    }
+
+    void* ring = MAP_FAILED;
+    if (flags & RING_MAP_HUGETLB) {
+        // fails unless huge pages were reserved, e.g. through /proc/sys/vm/nr_hugepages
+        ring = mmap(NULL, length, PROT_READ | PROT_WRITE, map_flags | MAP_HUGETLB, -1, 0);
+    }
+    if (ring == MAP_FAILED) {
+        ring = mmap(NULL, length, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+        if (ring == MAP_FAILED) {
+            return NULL;
+        }
+        // only a hint: the kernel backs the ring with transparent huge pages where it can
+        madvise(ring, length, MADV_HUGEPAGE);
+    }
+    return (void**) ring;
+}
+
+// Grows a ring returned by ring_map, keeping its contents
+void** ring_remap(void** ring, size_t capacity, size_t new_capacity)
+{
+    size_t length = ring_map_size(capacity);
+    size_t new_length = ring_map_size(new_capacity);
+    if (new_length == length) {
+        return ring;
+    }
+
+    // the kernel moves the page tables rather than copying the ring
+    void* grown = mremap(ring, length, new_length, MREMAP_MAYMOVE);
+    if (grown == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(grown, new_length, MADV_HUGEPAGE);
+    return (void**) grown;
+}
+
+// Unmaps a ring returned by ring_map
+void ring_unmap(void** ring, size_t capacity)
+{
+    if (ring != NULL) {
+        munmap(ring, ring_map_size(capacity));
+    }
+}
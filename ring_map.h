@@ -0,0 +1,31 @@
+#ifndef RING_MAP_H
+#define RING_MAP_H
+
+#include <stddef.h>
+
+// Mapped rings are sized in whole huge pages, so that every part of them can be backed by one
+#define RING_MAP_HUGE_PAGE (2 * 1024 * 1024)
+
+// Defines the flags for ring_map
+enum ring_map_flags {
+    RING_MAP_DEFAULT = 0,  // Anonymous mapping, transparent huge pages are requested with madvise
+    RING_MAP_HUGETLB = 1,  // Explicit huge pages from the reserved pool, falling back to the default if none are available
+    RING_MAP_PREFAULT = 2, // Fault the whole ring in when it is mapped (MAP_POPULATE)
+};
+
+// Returns a new anonymous mapping with room for capacity values
+// Returns NULL if the mapping failed
+void** ring_map(size_t capacity, int flags);
+
+// Grows a ring returned by ring_map from capacity to new_capacity values, keeping its contents
+// The ring may move, the new address is returned
+// Returns NULL if the mapping could not grow, in which case the old ring is left untouched
+void** ring_remap(void** ring, size_t capacity, size_t new_capacity);
+
+// Unmaps a ring returned by ring_map, capacity must be its current capacity
+void ring_unmap(void** ring, size_t capacity);
+
+// Returns the number of bytes mapped for a ring of capacity values
+size_t ring_map_size(size_t capacity);
+
+#endif // RING_MAP_H
@@ -0,0 +1,161 @@
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "rpc.h"
+
+#define RPC_PENDING 0
+#define RPC_SLEEPING 1
+#define RPC_REPLIED 2
+#define RPC_FAILED 3
+#define RPC_ABANDONED 4
+
+// Reply slot of the calling thread, reused by every call it makes until one of them is abandoned
+static __thread rpc_token_t* rpc_slot;
+
+// Key whose destructor frees a thread's slot when the thread exits
+static pthread_key_t rpc_key;
+static pthread_once_t rpc_key_once = PTHREAD_ONCE_INIT;
+
+static void rpc_key_create(void)
+{
+    pthread_key_create(&rpc_key, free);
+}
+
+// Returns the calling thread's slot, creating it on first use or after the last one was abandoned
+static rpc_token_t* rpc_thread_slot(void)
+{
+    if (rpc_slot == NULL) {
+        pthread_once(&rpc_key_once, rpc_key_create);
+        rpc_slot = (rpc_token_t*) aligned_alloc(RPC_CACHE_LINE, sizeof(rpc_token_t));
+        if (rpc_slot != NULL) {
+            pthread_setspecific(rpc_key, rpc_slot);
+        }
+    }
+    return rpc_slot;
+}
+
+// Sleeps as long as *state still holds value, or until deadline (an absolute CLOCK_MONOTONIC time) if it is not NULL
+// Returns false if the deadline passed
+static bool rpc_futex_wait(atomic_uint* state, unsigned int value, const struct timespec* deadline)
+{
+    // unlike FUTEX_WAIT, the bitset variant takes an absolute timeout, measured on CLOCK_MONOTONIC
+    long result = syscall(SYS_futex, state, FUTEX_WAIT_BITSET_PRIVATE, value, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+// Wakes the thread sleeping on state, if any
+static void rpc_futex_wake(atomic_uint* state)
+{
+    syscall(SYS_futex, state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Waits until the call that token was sent for is answered, or until deadline if it is not NULL
+// Returns TIMEOUT if the caller gave up on the call, after which the token belongs to whoever answers it
+static enum channel_status rpc_wait(rpc_token_t* token, const struct timespec* deadline)
+{
+    // only announce sleeping if the answer has not arrived yet, so a fast server never has to make the wake syscall
+    unsigned int state = RPC_PENDING;
+    if (!atomic_compare_exchange_strong_explicit(&token->state, &state, RPC_SLEEPING, memory_order_acquire, memory_order_acquire)) {
+        return SUCCESS;
+    }
+    while (atomic_load_explicit(&token->state, memory_order_acquire) == RPC_SLEEPING) {
+        if (!rpc_futex_wait(&token->state, RPC_SLEEPING, deadline)) {
+            // the answer may arrive right at the deadline, whichever side changes the state first decides
+            state = RPC_SLEEPING;
+            if (atomic_compare_exchange_strong_explicit(&token->state, &state, RPC_ABANDONED, memory_order_acquire, memory_order_acquire)) {
+                return TIMEOUT;
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+// Sends request over the given channel and waits for the server's reply
+enum channel_status channel_call(channel_t* channel, void* request, void** reply)
+{
+    return channel_call_until(channel, request, reply, NULL);
+}
+
+// Sends request over the given channel and waits for the server's reply, giving up at deadline
+// A NULL deadline waits without bound, which is how channel_call uses it
+enum channel_status channel_call_until(channel_t* channel, void* request, void** reply, const struct timespec* deadline)
+{
+    if (reply == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    rpc_token_t* token = rpc_thread_slot();
+    if (token == NULL) {
+        return GENERIC_ERROR;
+    }
+    token->request = request;
+    atomic_store_explicit(&token->state, RPC_PENDING, memory_order_relaxed);
+
+    enum channel_status status = (deadline == NULL) ? channel_send(channel, token) : channel_send_until(channel, token, deadline);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (rpc_wait(token, deadline) == TIMEOUT) {
+        // the token is still queued or held by the server, so the next call of this thread needs a new slot
+        rpc_slot = NULL;
+        pthread_setspecific(rpc_key, NULL);
+        return TIMEOUT;
+    }
+
+    if (atomic_load_explicit(&token->state, memory_order_relaxed) == RPC_FAILED) {
+        return CLOSED_ERROR;
+    }
+    *reply = token->reply;
+    return SUCCESS;
+}
+
+// Closes a channel that carries calls and fails every call still queued in it
+enum channel_status channel_call_close(channel_t* channel)
+{
+    enum channel_status status = channel_close_write(channel);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    // senders are turned away from now on, so the tokens left are exactly the calls that were queued
+    void* data = NULL;
+    while (channel_non_blocking_receive(channel, &data) == SUCCESS) {
+        channel_reply_error(data);
+    }
+    return channel_close(channel);
+}
+
+// Returns the request carried by a token that the server received from the channel
+void* rpc_request(rpc_token_t* token)
+{
+    return token->request;
+}
+
+// Stores the answer of the call that token belongs to and wakes up the caller, or frees the token if the caller gave up
+static void rpc_answer(rpc_token_t* token, void* reply, unsigned int answer)
+{
+    token->reply = reply;
+    unsigned int state = atomic_exchange_explicit(&token->state, answer, memory_order_acq_rel);
+    if (state == RPC_SLEEPING) {
+        // the caller may already be returning, a wake on a slot that is reused is harmless
+        rpc_futex_wake(&token->state);
+    } else if (state == RPC_ABANDONED) {
+        free(token);
+    }
+}
+
+// Answers the call that token belongs to with reply and wakes up the caller
+void channel_reply(rpc_token_t* token, void* reply)
+{
+    rpc_answer(token, reply, RPC_REPLIED);
+}
+
+// Answers the call that token belongs to with a failure, so the caller gets CLOSED_ERROR
+void channel_reply_error(rpc_token_t* token)
+{
+    rpc_answer(token, NULL, RPC_FAILED);
+}
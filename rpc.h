@@ -0,0 +1,47 @@
+#ifndef RPC_H
+#define RPC_H
+
+#include <stdatomic.h>
+#include "channel.h"
+
+#define RPC_CACHE_LINE 64
+
+// Defines a one-shot reply slot, which travels through the channel as the call's token
+// Every thread owns one slot that it reuses for all of its calls, since a thread only has one call outstanding at a time
+// A call abandoned at its deadline leaves its slot to whoever answers it, who frees it, and the thread takes a new one
+typedef struct {
+    // RPC_PENDING until the server answers, the caller sleeps on it with a futex
+    _Alignas(RPC_CACHE_LINE) atomic_uint state;
+    void* request;
+    void* reply;
+} rpc_token_t;
+
+// Sends request over the given channel and waits for the server's reply, which is stored in reply
+// The channel carries rpc_token_t pointers, the server gets the request from the token with rpc_request and answers with channel_reply
+// There is no shared reply channel: the reply goes straight into the caller's own slot, and only the caller is woken
+// Returns SUCCESS if a reply was received,
+// CLOSED_ERROR if the channel is closed before the request was sent, or the call was failed by channel_reply_error or channel_call_close, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_call(channel_t* channel, void* request, void** reply);
+
+// Behaves like channel_call, except that it gives up at deadline, an absolute CLOCK_MONOTONIC time
+// Returns TIMEOUT if no reply arrived before the deadline, in which case the request may still reach the server, whose reply is then dropped
+enum channel_status channel_call_until(channel_t* channel, void* request, void** reply, const struct timespec* deadline);
+
+// Closes a channel that carries calls: no new call is sent, and every call still queued in the channel fails with CLOSED_ERROR
+// Calls the server already received must still be answered, with channel_reply or channel_reply_error
+// Returns the status of channel_close_write if the channel could not be closed, and that of channel_close otherwise
+enum channel_status channel_call_close(channel_t* channel);
+
+// Returns the request carried by a token that the server received from the channel
+void* rpc_request(rpc_token_t* token);
+
+// Answers the call that token belongs to with reply and wakes up the caller
+// Every received token must be answered exactly once, and the token must not be used afterwards
+void channel_reply(rpc_token_t* token, void* reply);
+
+// Answers the call that token belongs to with a failure instead of a reply, so the caller gets CLOSED_ERROR
+// This is how a server that shuts down releases the calls it received but will not serve
+void channel_reply_error(rpc_token_t* token);
+
+#endif // RPC_H
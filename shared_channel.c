@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shared_channel.h"
+
+#define SHARED_CHANNEL_MAGIC 0x6c6e6e6168436873ull
+#define SHARED_CHANNEL_ALIGN 8
+
+// Returns the offset of the ring in the segment
+static size_t shared_slots_offset(void)
+{
+    return (sizeof(shared_channel_header_t) + 63) / 64 * 64;
+}
+
+// Maps the fd of a segment of size bytes and wraps it in a handle
+static shared_channel_t* shared_map(int fd, size_t size)
+{
+    shared_channel_t* channel = (shared_channel_t*) malloc(sizeof(shared_channel_t));
+    if (channel == NULL) {
+        return NULL;
+    }
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        free(channel);
+        return NULL;
+    }
+    channel->header = (shared_channel_header_t*) base;
+    channel->slots = (unsigned char*) base + shared_slots_offset();
+    channel->map_size = size;
+    return channel;
+}
+
+// Creates a shared channel in a new segment called name
+shared_channel_t* channel_create_shared(const char* name, size_t capacity, size_t elem_size)
+{
+    if (capacity == 0 || elem_size == 0) {
+        return NULL;
+    }
+    size_t stride = (elem_size + SHARED_CHANNEL_ALIGN - 1) / SHARED_CHANNEL_ALIGN * SHARED_CHANNEL_ALIGN;
+    if (stride > (SIZE_MAX - shared_slots_offset()) / capacity) {
+        return NULL;
+    }
+    size_t size = shared_slots_offset() + capacity * stride;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    shared_channel_t* channel = NULL;
+    if (ftruncate(fd, (off_t) size) == 0) {
+        channel = shared_map(fd, size);
+    }
+    close(fd);
+    if (channel == NULL) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    shared_channel_header_t* header = channel->header;
+    header->capacity = capacity;
+    header->elem_size = elem_size;
+    header->stride = stride;
+    header->head = 0;
+    header->count = 0;
+    header->senders_waiting = 0;
+    header->receivers_waiting = 0;
+    header->is_closed = false;
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->cond_not_full, &cond_attr);
+    pthread_cond_init(&header->cond_not_empty, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    __atomic_store_n(&header->magic, SHARED_CHANNEL_MAGIC, __ATOMIC_RELEASE);
+    return channel;
+}
+
+// Attaches to the shared channel called name
+shared_channel_t* channel_attach_shared(const char* name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat file;
+    shared_channel_t* channel = NULL;
+    if (fstat(fd, &file) == 0 && (size_t) file.st_size >= shared_slots_offset()) {
+        channel = shared_map(fd, (size_t) file.st_size);
+    }
+    close(fd);
+    if (channel == NULL) {
+        return NULL;
+    }
+
+    shared_channel_header_t* header = channel->header;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_CHANNEL_MAGIC ||
+        channel->map_size < shared_slots_offset() + header->capacity * header->stride) {
+        channel_shared_detach(channel);
+        return NULL;
+    }
+    return channel;
+}
+
+// Locks the channel's mutex, taking it over if its last owner died while holding it
+// The ring is only changed after a message is fully copied, so the state a dead owner leaves behind is consistent
+static bool shared_lock(shared_channel_header_t* header)
+{
+    int result = pthread_mutex_lock(&header->mutex);
+    if (result == EOWNERDEAD) {
+        result = pthread_mutex_consistent(&header->mutex);
+    }
+    return result == 0;
+}
+
+// Waits on cond, taking the mutex over if its owner died in the meantime
+static bool shared_wait(shared_channel_header_t* header, pthread_cond_t* cond)
+{
+    int result = pthread_cond_wait(cond, &header->mutex);
+    if (result == EOWNERDEAD) {
+        result = pthread_mutex_consistent(&header->mutex);
+    }
+    return result == 0;
+}
+
+// Copies a message into the channel, waiting for room if it is full
+enum channel_status channel_shared_send(shared_channel_t* channel, const void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (!shared_lock(header)) {
+        return GENERIC_ERROR;
+    }
+
+    while (header->count == header->capacity && !header->is_closed) {
+        header->senders_waiting++;
+        bool waited = shared_wait(header, &header->cond_not_full);
+        header->senders_waiting--;
+        if (!waited) {
+            pthread_mutex_unlock(&header->mutex);
+            return GENERIC_ERROR;
+        }
+    }
+    if (header->is_closed) {
+        pthread_mutex_unlock(&header->mutex);
+        return CLOSED_ERROR;
+    }
+
+    size_t slot = (header->head + header->count) % header->capacity;
+    memcpy(channel->slots + slot * header->stride, data, header->elem_size);
+    header->count++;
+    if (header->receivers_waiting > 0) {
+        pthread_cond_signal(&header->cond_not_empty);
+    }
+
+    pthread_mutex_unlock(&header->mutex);
+    return SUCCESS;
+}
+
+// Copies the next message out of the channel, waiting for one if it is empty
+enum channel_status channel_shared_receive(shared_channel_t* channel, void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (!shared_lock(header)) {
+        return GENERIC_ERROR;
+    }
+
+    while (header->count == 0 && !header->is_closed) {
+        header->receivers_waiting++;
+        bool waited = shared_wait(header, &header->cond_not_empty);
+        header->receivers_waiting--;
+        if (!waited) {
+            pthread_mutex_unlock(&header->mutex);
+            return GENERIC_ERROR;
+        }
+    }
+    if (header->count == 0) {
+        pthread_mutex_unlock(&header->mutex);
+        return CLOSED_ERROR;
+    }
+
+    memcpy(data, channel->slots + header->head * header->stride, header->elem_size);
+    header->head = (header->head + 1) % header->capacity;
+    header->count--;
+    if (header->senders_waiting > 0) {
+        pthread_cond_signal(&header->cond_not_full);
+    }
+
+    pthread_mutex_unlock(&header->mutex);
+    return SUCCESS;
+}
+
+// Closes the channel for every attached process
+enum channel_status channel_shared_close(shared_channel_t* channel)
+{
+    shared_channel_header_t* header = channel->header;
+    if (!shared_lock(header)) {
+        return GENERIC_ERROR;
+    }
+
+    if (header->is_closed) {
+        pthread_mutex_unlock(&header->mutex);
+        return CLOSED_ERROR;
+    }
+    header->is_closed = true;
+    pthread_cond_broadcast(&header->cond_not_full);
+    pthread_cond_broadcast(&header->cond_not_empty);
+
+    pthread_mutex_unlock(&header->mutex);
+    return SUCCESS;
+}
+
+// Unmaps the channel from this process and frees the handle
+void channel_shared_detach(shared_channel_t* channel)
+{
+    munmap(channel->header, channel->map_size);
+    free(channel);
+}
+
+// Removes the name of the shared channel
+enum channel_status channel_shared_unlink(const char* name)
+{
+    return shm_unlink(name) == 0 ? SUCCESS : GENERIC_ERROR;
+}
@@ -0,0 +1,74 @@
+#ifndef SHARED_CHANNEL_H
+#define SHARED_CHANNEL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "channel.h"
+
+// Defines the state of a shared channel that lives in the shared memory segment, followed by the ring of messages
+// Messages are copied into the ring inline, as pointers would mean nothing in another process
+typedef struct {
+    // set last when the segment is created, so a process that attaches too early does not see a half initialized channel
+    uint64_t magic;
+    size_t capacity;
+    size_t elem_size;
+    // distance between two slots of the ring, elem_size rounded up to 8 bytes
+    size_t stride;
+    // process shared and robust, so a process that dies holding the mutex does not block the others forever
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_not_full;
+    pthread_cond_t cond_not_empty;
+    // the ring holds count messages starting at slot head
+    size_t head;
+    size_t count;
+    // processes blocked on the condition variables, so a send or receive only signals when someone waits
+    size_t senders_waiting;
+    size_t receivers_waiting;
+    bool is_closed;
+} shared_channel_header_t;
+
+// Defines a process' handle to a shared channel
+typedef struct {
+    shared_channel_header_t* header;
+    unsigned char* slots;
+    size_t map_size;
+} shared_channel_t;
+
+// Creates a buffered channel of capacity messages of elem_size bytes each in a new POSIX shared memory segment called name
+// (e.g. "/my_channel") and returns a handle to it to the caller
+// Other processes use the channel through channel_attach_shared with the same name
+// Returns NULL if capacity or elem_size is 0, a segment called name already exists, or the segment could not be created
+shared_channel_t* channel_create_shared(const char* name, size_t capacity, size_t elem_size);
+
+// Attaches to the shared channel called name, created by this or another process, and returns a handle to it to the caller
+// Returns NULL if there is no such segment or it is not a fully created shared channel
+shared_channel_t* channel_attach_shared(const char* name);
+
+// Copies the elem_size bytes at data into the channel, waiting for room if it is full
+// Returns SUCCESS for a successful send,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_send(shared_channel_t* channel, const void* data);
+
+// Copies the next message of the channel into the elem_size bytes at data, waiting for one if it is empty
+// A closed channel still hands out the messages it holds
+// Returns SUCCESS for successful retrieval of a message,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_receive(shared_channel_t* channel, void* data);
+
+// Closes the channel for every attached process and wakes up all of their waiting senders and receivers
+// Returns SUCCESS if close is successful and CLOSED_ERROR if the channel is already closed
+enum channel_status channel_shared_close(shared_channel_t* channel);
+
+// Unmaps the channel from this process and frees the handle
+// The channel lives on for other processes until it is unlinked and all of them have detached
+void channel_shared_detach(shared_channel_t* channel);
+
+// Removes the name of the shared channel, so no process can attach to it anymore
+// Returns SUCCESS if the name was removed and GENERIC_ERROR if there is no such channel
+enum channel_status channel_shared_unlink(const char* name);
+
+#endif // SHARED_CHANNEL_H
@@ -0,0 +1,112 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "slab.h"
+
+// Smallest size class is 1 << SLAB_MIN_SHIFT bytes, the largest 1 << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1)
+#define SLAB_MIN_SHIFT 7
+#define SLAB_CLASSES 8
+// Most blocks a thread keeps per size class, anything beyond that is freed right away
+#define SLAB_DEPTH 16
+
+// Free block of a slab, linked through its own first bytes
+typedef struct slab_block {
+    struct slab_block* next;
+} slab_block_t;
+
+typedef struct {
+    slab_block_t* free[SLAB_CLASSES];
+    size_t count[SLAB_CLASSES];
+    bool registered;
+} slab_cache_t;
+
+// The calling thread's slab, only ever touched by that thread
+static __thread slab_cache_t slab_cache;
+
+// Key whose destructor empties a thread's slab when the thread exits
+static pthread_key_t slab_key;
+static pthread_once_t slab_key_once = PTHREAD_ONCE_INIT;
+
+// Frees every block a thread still holds, called when it exits
+static void slab_release(void* arg)
+{
+    slab_cache_t* cache = (slab_cache_t*) arg;
+    for (size_t i = 0; i < SLAB_CLASSES; i++) {
+        while (cache->free[i] != NULL) {
+            slab_block_t* block = cache->free[i];
+            cache->free[i] = block->next;
+            free(block);
+        }
+        cache->count[i] = 0;
+    }
+}
+
+static void slab_create_key(void)
+{
+    pthread_key_create(&slab_key, slab_release);
+}
+
+// Returns the size class of size, or SLAB_CLASSES if it is too large to be cached
+static size_t slab_class(size_t size)
+{
+    size_t index = 0;
+    size_t class_size = (size_t)1 << SLAB_MIN_SHIFT;
+    while (class_size < size && index < SLAB_CLASSES) {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+// Returns a block of at least size bytes from the calling thread's slab
+void* slab_alloc(size_t size)
+{
+    size_t index = slab_class(size);
+    if (index == SLAB_CLASSES) {
+        return malloc(size);
+    }
+
+    slab_block_t* block = slab_cache.free[index];
+    if (block != NULL) {
+        slab_cache.free[index] = block->next;
+        slab_cache.count[index]--;
+        return block;
+    }
+    return malloc((size_t)1 << (SLAB_MIN_SHIFT + index));
+}
+
+// Returns the number of bytes slab_alloc reserves for a block of size bytes
+size_t slab_size(size_t size)
+{
+    size_t index = slab_class(size);
+    if (index == SLAB_CLASSES) {
+        return size;
+    }
+    return (size_t)1 << (SLAB_MIN_SHIFT + index);
+}
+
+// Gives a block back to the calling thread's slab
+void slab_free(void* block, size_t size)
+{
+    if (block == NULL) {
+        return;
+    }
+
+    size_t index = slab_class(size);
+    if (index == SLAB_CLASSES || slab_cache.count[index] == SLAB_DEPTH) {
+        free(block);
+        return;
+    }
+
+    // the first block a thread keeps registers the slab for cleanup at thread exit
+    if (!slab_cache.registered) {
+        pthread_once(&slab_key_once, slab_create_key);
+        pthread_setspecific(slab_key, &slab_cache);
+        slab_cache.registered = true;
+    }
+
+    slab_block_t* free_block = (slab_block_t*) block;
+    free_block->next = slab_cache.free[index];
+    slab_cache.free[index] = free_block;
+    slab_cache.count[index]++;
+}
@@ -0,0 +1,19 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Returns a block of at least size bytes, recycled from the calling thread's slab if it has one of the right size class
+// Blocks are rounded up to a power of two size class, sizes above the largest class go straight to malloc
+// Returns NULL on an allocation failure
+void* slab_alloc(size_t size);
+
+// Returns the number of bytes slab_alloc reserves for a block of size bytes, i.e. size rounded up to its size class
+size_t slab_size(size_t size);
+
+// Gives a block back to the calling thread's slab, size must be the size it was allocated with
+// The block may be freed by a different thread than the one that allocated it
+// Each thread keeps a bounded number of blocks per size class, and hands them back to the system when it exits
+void slab_free(void* block, size_t size);
+
+#endif // SLAB_H
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spill.h"
+
+// Bytes read from the spill file at a time
+#define SPILL_READ_CHUNK (64 * 1024)
+
+// Makes sure buffer has room for extra more bytes after its first len bytes
+bool spill_reserve(unsigned char** buffer, size_t* capacity, size_t len, size_t extra)
+{
+    if (*capacity - len >= extra) {
+        return true;
+    }
+    size_t new_capacity = *capacity == 0 ? SPILL_READ_CHUNK : *capacity;
+    while (new_capacity - len < extra) {
+        new_capacity *= 2;
+    }
+    unsigned char* grown = (unsigned char*) realloc(*buffer, new_capacity);
+    if (grown == NULL) {
+        return false;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Creates an overflow for the given buffered channel
+channel_spill_t* channel_spill_create(channel_t* channel, const channel_serializer_t* serializer, const char* dir, size_t batch)
+{
+    if (channel->unbuffered || batch == 0 || serializer == NULL || serializer->serialize == NULL || serializer->deserialize == NULL) {
+        return NULL;
+    }
+
+    channel_spill_t* spill = (channel_spill_t*) calloc(1, sizeof(channel_spill_t));
+    if (spill == NULL) {
+        return NULL;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/channel_spill_XXXXXX", dir);
+    spill->fd = mkstemp(path);
+    if (spill->fd < 0) {
+        free(spill);
+        return NULL;
+    }
+    // the file lives on through its descriptor only
+    unlink(path);
+
+    spill->channel = channel;
+    spill->serializer = *serializer;
+    spill->batch = batch;
+    pthread_mutex_init(&spill->mutex, NULL);
+
+    return spill;
+}
+
+// Appends the staged records to the file
+bool spill_flush(channel_spill_t* spill)
+{
+    while (spill->stage_pos < spill->stage_len) {
+        ssize_t written = pwrite(spill->fd, spill->stage + spill->stage_pos, spill->stage_len - spill->stage_pos, spill->write_offset);
+        if (written <= 0) {
+            return false;
+        }
+        spill->stage_pos += (size_t) written;
+        spill->write_offset += written;
+    }
+    spill->stage_pos = 0;
+    spill->stage_len = 0;
+    spill->staged = 0;
+    return true;
+}
+
+// Serializes data into the stage, writing the stage to the file once it holds a batch
+bool spill_stage(channel_spill_t* spill, void* data)
+{
+    channel_serializer_t* serializer = &spill->serializer;
+    size_t header = sizeof(size_t);
+    if (!spill_reserve(&spill->stage, &spill->stage_capacity, spill->stage_len, header)) {
+        return false;
+    }
+    size_t room = spill->stage_capacity - spill->stage_len - header;
+    size_t size = serializer->serialize(data, spill->stage + spill->stage_len + header, room, serializer->ctx);
+    if (size > room) {
+        if (!spill_reserve(&spill->stage, &spill->stage_capacity, spill->stage_len, header + size)) {
+            return false;
+        }
+        serializer->serialize(data, spill->stage + spill->stage_len + header, size, serializer->ctx);
+    }
+    memcpy(spill->stage + spill->stage_len, &size, header);
+    spill->stage_len += header + size;
+    spill->staged++;
+    spill->pending++;
+    if (serializer->release != NULL) {
+        serializer->release(data, serializer->ctx);
+    }
+
+    if (spill->staged >= spill->batch) {
+        return spill_flush(spill);
+    }
+    return true;
+}
+
+// Loads more of the file into the read buffer, so that it holds at least want unparsed bytes if the file has them
+bool spill_load(channel_spill_t* spill, size_t want)
+{
+    // keep the unparsed bytes at the front so the buffer does not grow with the file
+    size_t unparsed = spill->read_len - spill->read_pos;
+    memmove(spill->read_buffer, spill->read_buffer + spill->read_pos, unparsed);
+    spill->read_pos = 0;
+    spill->read_len = unparsed;
+    if (!spill_reserve(&spill->read_buffer, &spill->read_capacity, spill->read_len, want > SPILL_READ_CHUNK ? want : SPILL_READ_CHUNK)) {
+        return false;
+    }
+
+    while (spill->read_len < want && spill->read_offset < spill->write_offset) {
+        size_t length = spill->read_capacity - spill->read_len;
+        if ((off_t) length > spill->write_offset - spill->read_offset) {
+            length = (size_t) (spill->write_offset - spill->read_offset);
+        }
+        ssize_t n = pread(spill->fd, spill->read_buffer + spill->read_len, length, spill->read_offset);
+        if (n <= 0) {
+            return false;
+        }
+        spill->read_len += (size_t) n;
+        spill->read_offset += n;
+    }
+    return true;
+}
+
+// Takes the oldest spilled record, from the file first and then from the stage
+// Sets record to NULL if the spill is empty
+// Returns false if the file could not be read
+bool spill_next_record(channel_spill_t* spill, unsigned char** record, size_t* size)
+{
+    size_t header = sizeof(size_t);
+    *record = NULL;
+
+    if (spill->read_len > spill->read_pos || spill->read_offset < spill->write_offset) {
+        if (spill->read_len - spill->read_pos < header && !spill_load(spill, header)) {
+            return false;
+        }
+        memcpy(size, spill->read_buffer + spill->read_pos, header);
+        if (spill->read_len - spill->read_pos < header + *size && !spill_load(spill, header + *size)) {
+            return false;
+        }
+        *record = spill->read_buffer + spill->read_pos + header;
+        spill->read_pos += header + *size;
+        return true;
+    }
+
+    if (spill->stage_pos < spill->stage_len) {
+        memcpy(size, spill->stage + spill->stage_pos, header);
+        *record = spill->stage + spill->stage_pos + header;
+        spill->stage_pos += header + *size;
+        spill->staged--;
+    }
+    return true;
+}
+
+// Moves as many spilled messages back into the channel as it has room for
+enum channel_status channel_spill_refill(channel_spill_t* spill, size_t* moved)
+{
+    size_t count = 0;
+    enum channel_status status = SUCCESS;
+    pthread_mutex_lock(&spill->mutex);
+
+    while (spill->pending > 0) {
+        if (!spill->has_held) {
+            unsigned char* record;
+            size_t size;
+            if (!spill_next_record(spill, &record, &size) || record == NULL) {
+                status = GENERIC_ERROR;
+                break;
+            }
+            spill->held = spill->serializer.deserialize(record, size, spill->serializer.ctx);
+            spill->has_held = true;
+        }
+        // the channel is empty or nearly so when this runs, so a failed send means it is full again
+        if (channel_non_blocking_send(spill->channel, spill->held) != SUCCESS) {
+            break;
+        }
+        spill->has_held = false;
+        spill->pending--;
+        count++;
+    }
+
+    if (spill->pending == 0 && spill->write_offset > 0) {
+        // everything was read back, so the file starts over instead of growing with every burst
+        if (ftruncate(spill->fd, 0) != 0) {
+            status = GENERIC_ERROR;
+        }
+        spill->read_offset = 0;
+        spill->write_offset = 0;
+        spill->read_pos = 0;
+        spill->read_len = 0;
+    }
+    if (spill->pending == 0) {
+        spill->stage_pos = 0;
+        spill->stage_len = 0;
+        spill->staged = 0;
+    }
+
+    pthread_mutex_unlock(&spill->mutex);
+    if (moved != NULL) {
+        *moved = count;
+    }
+    return status;
+}
+
+// Writes data to the channel, or to the spill if the channel is full or messages are already spilled
+enum channel_status channel_spill_send(channel_spill_t* spill, void* data)
+{
+    pthread_mutex_lock(&spill->mutex);
+
+    enum channel_status status;
+    if (spill->pending == 0) {
+        status = channel_non_blocking_send(spill->channel, data);
+    } else {
+        // going around the channel, so check that it is still open with a send of nothing
+        size_t sent;
+        status = channel_send_batch(spill->channel, &data, 0, &sent);
+        if (status == SUCCESS) {
+            status = CHANNEL_FULL;
+        }
+    }
+    if (status == CHANNEL_FULL) {
+        status = spill_stage(spill, data) ? SUCCESS : GENERIC_ERROR;
+    }
+
+    pthread_mutex_unlock(&spill->mutex);
+    return status;
+}
+
+// Reads data from the channel, moving spilled messages back into it whenever it is empty
+enum channel_status channel_spill_receive(channel_spill_t* spill, void** data)
+{
+    while (true) {
+        enum channel_status status = channel_non_blocking_receive(spill->channel, data);
+        if (status != CHANNEL_EMPTY) {
+            return status;
+        }
+        size_t moved = 0;
+        status = channel_spill_refill(spill, &moved);
+        if (status != SUCCESS) {
+            return status;
+        }
+        if (moved == 0) {
+            break;
+        }
+    }
+    // the spill is empty, so the next message goes straight to the channel and wakes this receive up
+    return channel_receive(spill->channel, data);
+}
+
+// Returns the number of messages that are in the spill rather than in the channel
+size_t channel_spill_pending(channel_spill_t* spill)
+{
+    pthread_mutex_lock(&spill->mutex);
+    size_t pending = spill->pending;
+    pthread_mutex_unlock(&spill->mutex);
+    return pending;
+}
+
+// Frees the spill and removes its file
+void channel_spill_destroy(channel_spill_t* spill)
+{
+    close(spill->fd);
+    pthread_mutex_destroy(&spill->mutex);
+    free(spill->read_buffer);
+    free(spill->stage);
+    free(spill);
+}
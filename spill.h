@@ -0,0 +1,89 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "channel.h"
+
+// Defines how messages are turned into bytes and back when they are spilled
+typedef struct {
+    // Writes data into buffer, which has room for size bytes, and returns the number of bytes data needs
+    // If that is more than size, nothing should be written and serialize is called again with a large enough buffer
+    size_t (*serialize)(void* data, void* buffer, size_t size, void* ctx);
+    // Returns a message rebuilt from the size bytes in buffer
+    void* (*deserialize)(const void* buffer, size_t size, void* ctx);
+    // Called with every message once it has been serialized, e.g. to free it, may be NULL
+    void (*release)(void* data, void* ctx);
+    // Passed to the functions above as is
+    void* ctx;
+} channel_serializer_t;
+
+// Defines an overflow for a buffered channel: messages that do not fit in the channel go to an append-only temporary file
+// and are moved back into the channel in order as it drains
+// Messages are only ever spilled behind the ones in the channel, so FIFO order is kept across the ring and the file
+typedef struct {
+    channel_t* channel;
+    channel_serializer_t serializer;
+    // number of spilled messages staged before they are written to the file together
+    size_t batch;
+    // serializes spilling and refilling, the channel itself is not locked while the file is used
+    pthread_mutex_t mutex;
+    int fd;
+    // records are a size_t length followed by that many bytes, the file holds [read_offset, write_offset) still to be read
+    off_t read_offset;
+    off_t write_offset;
+    // records read from the file ahead of time, the unparsed ones are [read_pos, read_len)
+    unsigned char* read_buffer;
+    size_t read_pos;
+    size_t read_len;
+    size_t read_capacity;
+    // records not written to the file yet, the ones still to be read are [stage_pos, stage_len)
+    unsigned char* stage;
+    size_t stage_pos;
+    size_t stage_len;
+    size_t stage_capacity;
+    size_t staged;
+    // a message moved back from the spill that found the channel full, it goes first on the next refill
+    void* held;
+    bool has_held;
+    // number of messages in the spill, held one included
+    size_t pending;
+} channel_spill_t;
+
+// Creates an overflow for the given buffered channel and returns it to the caller
+// The file is created in dir (e.g. "/tmp") and removed right away, so it disappears with the process
+// Spilled messages are written batch at a time, so at most batch serialized messages are kept in memory on the producer side
+// Returns NULL if the channel is unbuffered, batch is 0, the serializer is incomplete, or the file could not be created
+channel_spill_t* channel_spill_create(channel_t* channel, const channel_serializer_t* serializer, const char* dir, size_t batch);
+
+// Writes data to the channel, or to the spill if the channel is full or messages are already spilled
+// This call never blocks on the channel, which makes it suitable for producers that can neither block nor drop
+// A spilled message is serialized and then given to the serializer's release function
+// Returns SUCCESS if data was written or spilled,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the spill file could not be written or on encountering any other generic error of any sort
+enum channel_status channel_spill_send(channel_spill_t* spill, void* data);
+
+// Reads data from the channel, moving spilled messages back into it whenever it is empty
+// This is a blocking call that waits like channel_receive once the channel and the spill are both empty
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the spill file could not be read or on encountering any other generic error of any sort
+enum channel_status channel_spill_receive(channel_spill_t* spill, void** data);
+
+// Moves as many spilled messages back into the channel as it has room for
+// Receivers that use the channel directly must call this whenever they find the channel empty
+// moved, unless NULL, is set to the number of messages moved
+// Returns SUCCESS if the spill could be read (even if nothing was moved), and
+// GENERIC_ERROR if the spill file could not be read
+enum channel_status channel_spill_refill(channel_spill_t* spill, size_t* moved);
+
+// Returns the number of messages that are in the spill rather than in the channel
+size_t channel_spill_pending(channel_spill_t* spill);
+
+// Frees the spill and removes its file, messages still in the spill are lost, so it should be drained first
+// The channel is not closed or destroyed
+void channel_spill_destroy(channel_spill_t* spill);
+
+#endif // SPILL_H
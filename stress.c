@@ -4,6 +4,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "channel.h"
+#include "msg_pool.h"
+#include "msg_ref.h"
+#include "placement.h"
 #include "stress.h"
 
 typedef unsigned int distance_t;
@@ -20,6 +23,10 @@ static size_t num_channel;
 static channel_t** channels;
 static channel_t* done_channel;
 static channel_t* completed_channel;
+static msg_pool_t* state_pool;
+// CPUs the routers are pinned to, router i runs on cpus[i % num_cpus], no pinning if num_cpus is 0
+static int cpus[PLACEMENT_MAX_CPUS];
+static size_t num_cpus;
 
 distance_t get_link_distance(size_t src, size_t dst) {
     return topology[src * num_channel + dst];
@@ -122,33 +129,67 @@ void destroy_topology()
     free(solution);
 }
 
+// Offers state to every neighbor that has not received it yet, i.e. the SEND cases in select_list[2, select_count), with a single call
+// Neighbors that took it are moved past the end of the active part of the select list, the rest are left to channel_select
+// Returns the new select_count
+size_t broadcast_state(select_t* select_list, size_t select_count, channel_t** targets, bool* delivered, msg_ref_t* state)
+{
+    size_t target_count = select_count - 2;
+    for (size_t i = 0; i < target_count; i++) {
+        targets[i] = select_list[i + 2].channel;
+    }
+    enum channel_status status = msg_ref_send_multi(targets, target_count, state, MULTI_NON_BLOCKING, delivered);
+    assert(status == SUCCESS || status == CHANNEL_FULL);
+    // walk backwards so the entry swapped in from the end has always been checked already
+    for (size_t i = target_count; i > 0; i--) {
+        if (delivered[i - 1]) {
+            select_count--;
+            channel_t* temp = select_list[select_count].channel;
+            select_list[select_count].channel = select_list[i + 1].channel;
+            select_list[i + 1].channel = temp;
+        }
+    }
+    return select_count;
+}
+
+// Creates the next state to publish as a copy of state, with the following epoch
+msg_ref_t* next_state_of(msg_ref_t* state)
+{
+    msg_ref_t* next = msg_ref_create_pooled(state_pool);
+    assert(next != NULL);
+    distance_vector_t* curr_vector = msg_ref_data(state);
+    distance_vector_t* next_vector = msg_ref_data(next);
+    next_vector->src = curr_vector->src;
+    next_vector->epoch = curr_vector->epoch + 1;
+    for (size_t i = 0; i < num_channel; i++) {
+        next_vector->dist[i] = curr_vector->dist[i];
+    }
+    return next;
+}
+
 void* router(void* arg)
 {
     bool changed = false;
     size_t index = (size_t)arg;
     size_t selected_index;
-    distance_vector_t* prev_prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_prev_state != NULL);
-    distance_vector_t* prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_state != NULL);
-    distance_vector_t* curr_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
+    if (num_cpus > 0) {
+        // the CPUs were checked before the routers were started, see placement_check_cpus
+        placement_pin(cpus[index % num_cpus]);
+    }
+    // curr_state is published to the neighbors, and every neighbor that received it releases it once it is merged
+    // next_state is only seen by this router until it replaces curr_state
+    msg_ref_t* curr_state = msg_ref_create_pooled(state_pool);
     assert(curr_state != NULL);
-    distance_vector_t* next_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(next_state != NULL);
-    prev_prev_state->src = index;
-    prev_state->src = index;
-    curr_state->src = index;
-    next_state->src = index;
-    prev_prev_state->epoch = 0;
-    prev_state->epoch = 1;
-    curr_state->epoch = 2;
-    next_state->epoch = 3;
+    distance_vector_t* curr_vector = msg_ref_data(curr_state);
+    curr_vector->src = index;
+    curr_vector->epoch = 0;
     for (size_t i = 0; i < num_channel; i++) {
-        prev_prev_state->dist[i] = get_link_distance(index, i);
-        prev_state->dist[i] = get_link_distance(index, i);
-        curr_state->dist[i] = get_link_distance(index, i);
-        next_state->dist[i] = get_link_distance(index, i);
+        curr_vector->dist[i] = get_link_distance(index, i);
     }
+    msg_ref_t* next_state = next_state_of(curr_state);
+    distance_vector_t* next_vector = msg_ref_data(next_state);
+    // every SEND case shares the producer, which takes a reference for whichever neighbor is selected
+    select_producer_t producer = msg_ref_producer(curr_state);
     size_t total_select_count = 2;
     for (size_t i = 0; i < num_channel; i++) {
         if ((i != index) && get_link_distance(index, i) != inf_distance) {
@@ -157,6 +198,10 @@ void* router(void* arg)
     }
     select_t* select_list = malloc(sizeof(select_t) * total_select_count);
     assert(select_list != NULL);
+    channel_t** targets = malloc(sizeof(channel_t*) * total_select_count);
+    assert(targets != NULL);
+    bool* delivered = malloc(sizeof(bool) * total_select_count);
+    assert(delivered != NULL);
     size_t select_count = 0;
     select_list[select_count].channel = done_channel;
     select_list[select_count].dir = RECV;
@@ -169,32 +214,35 @@ void* router(void* arg)
     for (size_t i = 0; i < num_channel; i++) {
         if ((i != index) && get_link_distance(index, i) != inf_distance) {
             select_list[select_count].channel = channels[i];
-            select_list[select_count].dir = SEND;
-            select_list[select_count].data = curr_state;
+            select_list[select_count].dir = SEND_LAZY;
+            select_list[select_count].data = &producer;
             select_count++;
         }
     }
+    select_count = broadcast_state(select_list, select_count, targets, delivered, curr_state);
     while (true) {
-        enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        enum channel_status status = channel_select_fair(select_list, select_count, &selected_index);
         if (status == SUCCESS) {
             assert(selected_index != 0);
             if (selected_index == 1) {
                 if (select_list[selected_index].data) {
                     // update next_state with new data
-                    distance_vector_t* neighbor_state = select_list[selected_index].data;
+                    msg_ref_t* neighbor_ref = select_list[selected_index].data;
+                    distance_vector_t* neighbor_state = msg_ref_data(neighbor_ref);
                     distance_t neighbor_dist = get_link_distance(index, neighbor_state->src);
                     assert(neighbor_dist != inf_distance);
                     for (size_t i = 0; i < num_channel; i++) {
                         distance_t new_dist = neighbor_dist + neighbor_state->dist[i];
-                        if (new_dist < next_state->dist[i]) {
-                            next_state->dist[i] = new_dist;
+                        if (new_dist < next_vector->dist[i]) {
+                            next_vector->dist[i] = new_dist;
                             changed = true;
                         }
                     }
+                    msg_ref_release(neighbor_ref);
                 } else {
                     // special message sent to test convergence
                     bool converged = (select_count == 2) && !changed;
-                    status = channel_send(completed_channel, converged ? curr_state : NULL);
+                    status = converged ? msg_ref_send(completed_channel, curr_state) : channel_send(completed_channel, NULL);
                     assert(status == SUCCESS);
                 }
             } else {
@@ -208,21 +256,14 @@ void* router(void* arg)
             if (select_count == 2) {
                 // check if we want to reset
                 if (changed) {
-                    // cycle triple buffer
-                    distance_vector_t* temp_state = curr_state;
+                    // publish next_state, the old state is recycled once the last neighbor releases it
+                    msg_ref_release(curr_state);
                     curr_state = next_state;
-                    next_state = prev_prev_state;
-                    prev_prev_state = prev_state;
-                    prev_state = temp_state;
-                    next_state->epoch = curr_state->epoch + 1;
-                    for (size_t i = 0; i < num_channel; i++) {
-                        next_state->dist[i] = curr_state->dist[i];
-                    }
-                    // reset to broadcast again
-                    select_count = total_select_count;
-                    for (size_t i = 2; i < select_count; i++) {
-                        select_list[i].data = curr_state;
-                    }
+                    next_state = next_state_of(curr_state);
+                    next_vector = msg_ref_data(next_state);
+                    producer = msg_ref_producer(curr_state);
+                    // reset to broadcast to every neighbor again
+                    select_count = broadcast_state(select_list, total_select_count, targets, delivered, curr_state);
                     changed = false;
                 }
             }
@@ -234,10 +275,10 @@ void* router(void* arg)
         }
     }
     free(select_list);
-    free(prev_prev_state);
-    free(prev_state);
-    free(curr_state);
-    free(next_state);
+    free(targets);
+    free(delivered);
+    msg_ref_release(curr_state);
+    msg_ref_release(next_state);
     return NULL;
 }
 
@@ -245,7 +286,8 @@ bool check_done()
 {
     bool valid = true;
     enum channel_status status;
-    distance_vector_t** completed = malloc(sizeof(distance_vector_t*) * num_channel);
+    // references on the states of the first round, held so they stay intact for the second one
+    msg_ref_t** completed = calloc(num_channel, sizeof(msg_ref_t*));
     assert(completed != NULL);
     // validate by sending special NULL message to flush channels
     for (size_t i = 0; i < num_channel; i++) {
@@ -260,9 +302,9 @@ bool check_done()
         if (data == NULL) {
             valid = false;
         } else {
-            distance_vector_t* new_data = (distance_vector_t*)data;
+            distance_vector_t* new_data = msg_ref_data(data);
             size_t index = new_data->src;
-            completed[index] = new_data;
+            completed[index] = data;
         }
     }
     if (valid) {
@@ -279,28 +321,48 @@ bool check_done()
             if (data == NULL) {
                 valid = false;
             } else {
-                distance_vector_t* new_data = (distance_vector_t*)data;
+                distance_vector_t* new_data = msg_ref_data(data);
                 size_t index = new_data->src;
-                if (completed[index]->epoch != new_data->epoch) {
+                distance_vector_t* old_data = msg_ref_data(completed[index]);
+                if (old_data->epoch != new_data->epoch) {
                     valid = false;
                 }
+                msg_ref_release(data);
             }
         }
         if (valid) {
             // check results
             for (size_t src = 0; src < num_channel; src++) {
+                distance_vector_t* state = msg_ref_data(completed[src]);
                 for (size_t dst = 0; dst < num_channel; dst++) {
-                    assert(completed[src]->dist[dst] == get_solution_distance(src, dst));
+                    assert(state->dist[dst] == get_solution_distance(src, dst));
                 }
             }
         }
     }
+    for (size_t i = 0; i < num_channel; i++) {
+        if (completed[i] != NULL) {
+            msg_ref_release(completed[i]);
+        }
+    }
     free(completed);
     return valid;
 }
 
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename)
 {
+    run_stress_on_cpus(main_buffer_size, secondary_buffer_size, filename, NULL);
+}
+
+bool run_stress_on_cpus(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, const char* cpu_list)
+{
+    num_cpus = 0;
+    if (cpu_list != NULL) {
+        num_cpus = placement_check_cpus(cpu_list, "run_stress_on_cpus", cpus, PLACEMENT_MAX_CPUS);
+        if (num_cpus == 0) {
+            return false;
+        }
+    }
     assert(main_buffer_size <= 1); // only support up to a buffer size of 1
     assert(secondary_buffer_size <= 1); // only support up to a buffer size of 1
     int pthread_status;
@@ -310,13 +372,16 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(main_buffer_size);
+        channels[i] = channel_create_for_worker(main_buffer_size, i, cpus, num_cpus);
         assert(channels[i] != NULL);
     }
     done_channel = channel_create(secondary_buffer_size);
     assert(done_channel != NULL);
     completed_channel = channel_create(secondary_buffer_size);
     assert(completed_channel != NULL);
+    // states are carved from the publishing router's cache, and go back to it when their last reader releases them
+    state_pool = msg_pool_create(msg_ref_size(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel), 4);
+    assert(state_pool != NULL);
 
     pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
     assert(pid != NULL);
@@ -350,7 +415,9 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
         status = channel_destroy(channels[i]);
         assert(status == SUCCESS);
     }
+    msg_pool_destroy(state_pool);
     free(pid);
     free(channels);
     destroy_topology();
+    return true;
 }
@@ -1,6 +1,13 @@
 #ifndef STRESS_H
 #define STRESS_H
 
+#include <stdbool.h>
+
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename);
 
+// Same as run_stress, with router i pinned to the i-th CPU of cpu_list (e.g. "0-3,8", reused round robin) and its input channel placed on that CPU's node
+// A NULL cpu_list leaves placement to the scheduler
+// Returns false without running anything if cpu_list is malformed or names a CPU the calling thread may not use
+bool run_stress_on_cpus(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, const char* cpu_list);
+
 #endif // STRESS_H
@@ -5,16 +5,24 @@
 #include <stdbool.h>
 #include <stdatomic.h>
 #include "channel.h"
+#include "placement.h"
 #include "stress_send_recv.h"
 
 static size_t num_channel;
 static channel_t** channels;
 static atomic_bool done;
 static channel_t* main_channel;
+// CPUs the workers are pinned to, worker i runs on cpus[i % num_cpus], no pinning if num_cpus is 0
+static int cpus[PLACEMENT_MAX_CPUS];
+static size_t num_cpus;
 
 void* worker_thread(void* arg)
 {
     size_t index = (size_t)arg;
+    if (num_cpus > 0) {
+        // the CPUs were checked before the workers were started, see placement_check_cpus
+        placement_pin(cpus[index % num_cpus]);
+    }
     size_t next_index = index + 1;
     if (next_index >= num_channel) {
         next_index = 0;
@@ -35,11 +43,11 @@ void* worker_thread(void* arg)
             }
         } else {
             status = channel_receive(my_channel, &data);
-            assert(status == SUCCESS);
-            if (data == NULL) {
+            if (status == CLOSED_ERROR) {
                 // indicates completion
                 break;
             }
+            assert(status == SUCCESS);
         }
         if (atomic_load(&done)) {
             // Send data to main_channel
@@ -56,6 +64,18 @@ void* worker_thread(void* arg)
 
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
 {
+    run_stress_send_recv_on_cpus(buffer_size, num_threads, load, duration_usec, NULL);
+}
+
+bool run_stress_send_recv_on_cpus(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec, const char* cpu_list)
+{
+    num_cpus = 0;
+    if (cpu_list != NULL) {
+        num_cpus = placement_check_cpus(cpu_list, "run_stress_send_recv_on_cpus", cpus, PLACEMENT_MAX_CPUS);
+        if (num_cpus == 0) {
+            return false;
+        }
+    }
     enum channel_status status;
     // setup
     num_channel = num_threads;
@@ -67,7 +87,7 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(buffer_size);
+        channels[i] = channel_create_for_worker(buffer_size, i, cpus, num_cpus);
         assert(channels[i] != NULL);
     }
     main_channel = channel_create(buffer_size);
@@ -110,8 +130,8 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
 
     // shutdown
     for (size_t i = 0; i < num_channel; i++) {
-        // send stop message
-        status = channel_send(channels[i], NULL);
+        // stop workers once their channel is drained
+        status = channel_close_write(channels[i]);
         assert(status == SUCCESS);
     }
     for (size_t i = 0; i < num_channel; i++) {
@@ -125,12 +145,11 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     status = channel_destroy(main_channel);
     assert(status == SUCCESS);
     for (size_t i = 0; i < num_channel; i++) {
-        status = channel_close(channels[i]);
-        assert(status == SUCCESS);
         status = channel_destroy(channels[i]);
         assert(status == SUCCESS);
     }
     free(msg_check);
     free(pid);
     free(channels);
+    return true;
 }
@@ -1,6 +1,13 @@
 #ifndef STRESS_SEND_RECV_H
 #define STRESS_SEND_RECV_H
 
+#include <stdbool.h>
+
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
 
+// Same as run_stress_send_recv, with worker i pinned to the i-th CPU of cpu_list (e.g. "0-3,8", reused round robin) and its channel placed on that CPU's node
+// A NULL cpu_list leaves placement to the scheduler
+// Returns false without running anything if cpu_list is malformed or names a CPU the calling thread may not use
+bool run_stress_send_recv_on_cpus(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec, const char* cpu_list);
+
 #endif // STRESS_SEND_RECV_H
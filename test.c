@@ -4,12 +4,28 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <time.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
 #include <string.h>
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "broadcast.h"
+#include "watch.h"
+#include "writer.h"
+#include "forwarder.h"
+#include "rpc.h"
+#include "msg_pool.h"
+#include "msg_ref.h"
+#include "placement.h"
+#include "spill.h"
+#include "log_channel.h"
+#include "shared_channel.h"
+#include "bridge.h"
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -171,6 +187,12 @@ uint64_t getTime()
     return convertTimespecToTime(&now);
 }
 
+// Fills out with the absolute CLOCK_MONOTONIC time that lies sec seconds from now
+void deadlineAfter(double sec, struct timespec* out)
+{
+    convertTimeToTimespec(getTime() + convertSecondsToTime(sec), out);
+}
+
 void* average_cpu_utilization(cpu_args* myargs) {
 
     struct rusage usage1;
@@ -2020,6 +2042,2306 @@ char* test_select_mixed_size1_size0() {
     return NULL;
 }
 
+char* test_select_fairness() {
+    print_test_details(__func__, "Testing how evenly select spreads work over cases that are always ready");
+
+    /* This test keeps every channel in the list ready to receive and counts which case select picks.
+     * channel_select always takes the first ready case, channel_select_fair should spread the picks over all cases.
+     */
+    size_t CHANNELS = 8;
+    size_t ROUNDS = 8000;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    size_t first_count[CHANNELS];
+    size_t fair_count[CHANNELS];
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        mu_assert("test_select_fairness: Send failed", channel_send(channel[i], "Message") == SUCCESS);
+        list[i].dir = RECV;
+        list[i].channel = channel[i];
+        list[i].data = NULL;
+        first_count[i] = 0;
+        fair_count[i] = 0;
+    }
+
+    size_t index = CHANNELS;
+    uint64_t first_time = getTime();
+    for (size_t round = 0; round < ROUNDS; round++) {
+        mu_assert("test_select_fairness: Select failed", channel_select(list, CHANNELS, &index) == SUCCESS);
+        mu_assert("test_select_fairness: Received wrong index", index < CHANNELS);
+        first_count[index]++;
+        // refill the channel so every case stays ready
+        mu_assert("test_select_fairness: Send failed", channel_send(channel[index], "Message") == SUCCESS);
+    }
+    first_time = getTime() - first_time;
+
+    uint64_t fair_time = getTime();
+    for (size_t round = 0; round < ROUNDS; round++) {
+        mu_assert("test_select_fairness: Select failed", channel_select_fair(list, CHANNELS, &index) == SUCCESS);
+        mu_assert("test_select_fairness: Received wrong index", index < CHANNELS);
+        mu_assert("test_select_fairness: Received wrong message", string_equal(list[index].data, "Message"));
+        fair_count[index]++;
+        mu_assert("test_select_fairness: Send failed", channel_send(channel[index], "Message") == SUCCESS);
+    }
+    fair_time = getTime() - fair_time;
+
+    size_t first_min = ROUNDS, first_max = 0, fair_min = ROUNDS, fair_max = 0;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        first_min = (first_count[i] < first_min) ? first_count[i] : first_min;
+        first_max = (first_count[i] > first_max) ? first_count[i] : first_max;
+        fair_min = (fair_count[i] < fair_min) ? fair_count[i] : fair_min;
+        fair_max = (fair_count[i] > fair_max) ? fair_count[i] : fair_max;
+    }
+    printf("select over %zu ready cases, %zu rounds: first-ready min/max picks %zu/%zu (%.3f us/op), fair min/max picks %zu/%zu (%.3f us/op)\n",
+           CHANNELS, ROUNDS, first_min, first_max, convertTimeToSeconds(first_time) * 1e6 / (double)ROUNDS,
+           fair_min, fair_max, convertTimeToSeconds(fair_time) * 1e6 / (double)ROUNDS);
+
+    mu_assert("test_select_fairness: First-ready select did not favor the first case", first_count[0] == ROUNDS);
+    // each case should get roughly ROUNDS / CHANNELS picks, allow a wide margin for randomness
+    mu_assert("test_select_fairness: Fair select starved a case", fair_min > ROUNDS / CHANNELS / 2);
+    mu_assert("test_select_fairness: Fair select favored a case", fair_max < ROUNDS / CHANNELS * 2);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+char* test_select_until() {
+    print_test_details(__func__, "Testing select with a deadline");
+
+    size_t CHANNELS = 2;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    channel[0] = channel_create(1);
+    channel[1] = channel_create(0);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        list[i].dir = RECV;
+        list[i].channel = channel[i];
+        list[i].data = NULL;
+    }
+
+    /* Nothing is ready, so select should return TIMEOUT at the deadline and leave no registrations behind */
+    struct timespec deadline;
+    size_t index = CHANNELS;
+    uint64_t t = getTime();
+    deadlineAfter(0.05, &deadline);
+    mu_assert("test_select_until: Select did not time out", channel_select_until(list, CHANNELS, &index, &deadline) == TIMEOUT);
+    t = getTime() - t;
+    mu_assert("test_select_until: Select returned before the deadline", t >= convertSecondsToTime(0.05));
+    mu_assert("test_select_until: Select returned too long after the deadline", t < convertSecondsToTime(0.5));
+    mu_assert("test_select_until: Selected index was modified on timeout", index == CHANNELS);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        mu_assert("test_select_until: Select list was not cleaned up", list_count(&channel[i]->waiters->semaphore_select_list_recv) == 0);
+    }
+
+    /* A past deadline still takes a ready case */
+    mu_assert("test_select_until: Send failed", channel_send(channel[0], "Message1") == SUCCESS);
+    deadlineAfter(-1.0, &deadline);
+    mu_assert("test_select_until: Select failed", channel_select_until(list, CHANNELS, &index, &deadline) == SUCCESS);
+    mu_assert("test_select_until: Received wrong index", index == 0);
+    mu_assert("test_select_until: Received wrong message", string_equal(list[0].data, "Message1"));
+    mu_assert("test_select_until: Select did not time out", channel_select_until(list, CHANNELS, &index, &deadline) == TIMEOUT);
+
+    /* A send that arrives before the deadline completes the select */
+    pthread_t pid;
+    send_args send_;
+    init_object_for_send_api(&send_, channel[1], "Message2", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send_);
+    deadlineAfter(5.0, &deadline);
+    mu_assert("test_select_until: Select failed", channel_select_until(list, CHANNELS, &index, &deadline) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_until: Send failed", send_.out == SUCCESS);
+    mu_assert("test_select_until: Received wrong index", index == 1);
+    mu_assert("test_select_until: Received wrong message", string_equal(list[1].data, "Message2"));
+
+    /* A closed unbuffered channel reports its index and the registrations on the other channels are removed */
+    channel_close(channel[1]);
+    deadlineAfter(5.0, &deadline);
+    mu_assert("test_select_until: Select did not report the closed channel", channel_select_until(list, CHANNELS, &index, &deadline) == CLOSED_ERROR);
+    mu_assert("test_select_until: Received wrong index", index == 1);
+    mu_assert("test_select_until: Select list was not cleaned up", list_count(&channel[0]->waiters->semaphore_select_list_recv) == 0);
+
+    /* A non-blocking send offered to a select that then picks another case backs out with CHANNEL_FULL instead of blocking */
+    channel_t* unbuffered = channel_create(0);
+    channel_t* other = channel_create(1);
+    select_t offered[2] = {{other, RECV, NULL}, {unbuffered, RECV, NULL}};
+    size_t backed_out = 0;
+    for (size_t round = 0; round < 50; round++) {
+        select_args select_;
+        offered[0].data = NULL;
+        offered[1].data = NULL;
+        init_object_for_select_api(&select_, offered, 2, NULL);
+        pthread_create(&pid, NULL, (void *)helper_select, &select_);
+        usleep(1000);
+        pthread_t offer_pid;
+        init_object_for_send_api(&send_, unbuffered, "Offer", NULL);
+        pthread_create(&offer_pid, NULL, (void *)helper_non_blocking_send, &send_);
+        mu_assert("test_select_until: Send failed", channel_send(other, "Other") == SUCCESS);
+        pthread_join(pid, NULL);
+        pthread_join(offer_pid, NULL);
+        mu_assert("test_select_until: Select failed", select_.out == SUCCESS);
+        if (select_.index == 1) {
+            mu_assert("test_select_until: Offered send was not delivered", send_.out == SUCCESS && string_equal(offered[1].data, "Offer"));
+            void* data;
+            mu_assert("test_select_until: Other message was lost", channel_non_blocking_receive(other, &data) == SUCCESS);
+        } else {
+            mu_assert("test_select_until: Offered send did not back out", send_.out == CHANNEL_FULL && string_equal(offered[0].data, "Other"));
+            backed_out++;
+        }
+    }
+    printf("non-blocking send backed out of %zu of 50 offers\n", backed_out);
+    channel_close(unbuffered);
+    channel_close(other);
+    channel_destroy(unbuffered);
+    channel_destroy(other);
+
+    channel_close(channel[0]);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    channel_t *channel;
+    void *data;
+    double timeout;
+    enum channel_status out;
+} until_args;
+
+void* helper_send_until(until_args *myargs) {
+    struct timespec deadline;
+    deadlineAfter(myargs->timeout, &deadline);
+    myargs->out = channel_send_until(myargs->channel, myargs->data, &deadline);
+    return NULL;
+}
+
+char* test_send_receive_until() {
+    print_test_details(__func__, "Testing send and receive with a deadline on buffered and unbuffered channels");
+
+    struct timespec deadline;
+    void* data = (void*)0xdeadbeef;
+
+    /* Buffered: receive on an empty channel and send on a full channel time out at the deadline */
+    channel_t* channel = channel_create(1);
+    uint64_t t = getTime();
+    deadlineAfter(0.05, &deadline);
+    mu_assert("test_send_receive_until: Receive did not time out", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+    t = getTime() - t;
+    mu_assert("test_send_receive_until: Receive returned before the deadline", t >= convertSecondsToTime(0.05));
+    mu_assert("test_send_receive_until: Receive returned too long after the deadline", t < convertSecondsToTime(0.5));
+    mu_assert("test_send_receive_until: Receive modified data on timeout", data == (void*)0xdeadbeef);
+
+    deadlineAfter(0.05, &deadline);
+    mu_assert("test_send_receive_until: Send failed", channel_send_until(channel, "Message1", &deadline) == SUCCESS);
+    mu_assert("test_send_receive_until: Send did not time out", channel_send_until(channel, "Message2", &deadline) == TIMEOUT);
+    mu_assert("test_send_receive_until: Buffer size is not as expected", buffer_current_size(channel->buffer) == 1);
+
+    /* Buffered: a receive that frees space before the deadline lets the send complete */
+    pthread_t pid;
+    until_args args = {channel, "Message2", 5.0, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_send_until, &args);
+    usleep(10000);
+    mu_assert("test_send_receive_until: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_send_receive_until: Received wrong message", string_equal(data, "Message1"));
+    pthread_join(pid, NULL);
+    mu_assert("test_send_receive_until: Send failed", args.out == SUCCESS);
+    deadlineAfter(5.0, &deadline);
+    mu_assert("test_send_receive_until: Receive failed", channel_receive_until(channel, &data, &deadline) == SUCCESS);
+    mu_assert("test_send_receive_until: Received wrong message", string_equal(data, "Message2"));
+
+    channel_close(channel);
+    deadlineAfter(5.0, &deadline);
+    mu_assert("test_send_receive_until: Receive did not report close", channel_receive_until(channel, &data, &deadline) == CLOSED_ERROR);
+    channel_destroy(channel);
+
+    /* Unbuffered: senders with nobody to meet time out and leave no stage state behind */
+    channel = channel_create(0);
+    until_args senders[2] = {{channel, "Message3", 0.05, GENERIC_ERROR}, {channel, "Message4", 0.05, GENERIC_ERROR}};
+    pthread_t send_pid[2];
+    for (size_t i = 0; i < 2; i++) {
+        pthread_create(&send_pid[i], NULL, (void *)helper_send_until, &senders[i]);
+    }
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(send_pid[i], NULL);
+        mu_assert("test_send_receive_until: Send did not time out", senders[i].out == TIMEOUT);
+    }
+    mu_assert("test_send_receive_until: Stage was not reset", channel->waiters->unbuffered_stage == 0);
+    mu_assert("test_send_receive_until: Waiting count was not reset", channel->waiters->send_waiting == 0);
+    mu_assert("test_send_receive_until: Timed out send was delivered", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    /* Unbuffered: a receive that times out does not swallow the next send */
+    deadlineAfter(0.05, &deadline);
+    mu_assert("test_send_receive_until: Receive did not time out", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+    mu_assert("test_send_receive_until: Stage was not reset", channel->waiters->unbuffered_stage == 0);
+    args.channel = channel;
+    args.data = "Message5";
+    args.timeout = 5.0;
+    args.out = GENERIC_ERROR;
+    pthread_create(&pid, NULL, (void *)helper_send_until, &args);
+    deadlineAfter(5.0, &deadline);
+    mu_assert("test_send_receive_until: Receive failed", channel_receive_until(channel, &data, &deadline) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_send_receive_until: Send failed", args.out == SUCCESS);
+    mu_assert("test_send_receive_until: Received wrong message", string_equal(data, "Message5"));
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+typedef struct {
+    char* message;
+    size_t calls;
+} produce_args;
+
+void* helper_produce(produce_args* myargs) {
+    myargs->calls++;
+    return myargs->message;
+}
+
+typedef struct {
+    select_t* select_list;
+    size_t list_size;
+    size_t index;
+    struct timespec deadline;
+    enum channel_status out;
+} select_until_args;
+
+void* helper_select_until(select_until_args* myargs) {
+    myargs->out = channel_select_until(myargs->select_list, myargs->list_size, &myargs->index, &myargs->deadline);
+    return NULL;
+}
+
+char* test_select_lazy_send() {
+    print_test_details(__func__, "Testing that select only produces the payload of the selected SEND_LAZY case");
+
+    size_t CHANNELS = 3;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    produce_args produce[CHANNELS];
+    select_producer_t producer[CHANNELS];
+    char* messages[] = {"Message1", "Message2", "Message3"};
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        produce[i].message = messages[i];
+        produce[i].calls = 0;
+        producer[i].produce = (void* (*)(void*))helper_produce;
+        producer[i].ctx = &produce[i];
+        producer[i].produced = NULL;
+        list[i].dir = SEND_LAZY;
+        list[i].channel = channel[i];
+        list[i].data = &producer[i];
+    }
+
+    /* Only the channel with a free slot gets a payload */
+    channel_send(channel[0], "Full");
+    channel_send(channel[1], "Full");
+    size_t index = CHANNELS;
+    mu_assert("test_select_lazy_send: Select failed", channel_select(list, CHANNELS, &index) == SUCCESS);
+    mu_assert("test_select_lazy_send: Received wrong index", index == 2);
+    mu_assert("test_select_lazy_send: Produced payload for a losing case", produce[0].calls == 0 && produce[1].calls == 0);
+    mu_assert("test_select_lazy_send: Did not produce payload exactly once", produce[2].calls == 1);
+    mu_assert("test_select_lazy_send: Wrong produced message", string_equal(producer[2].produced, "Message3"));
+    void* data = NULL;
+    mu_assert("test_select_lazy_send: Receive failed", channel_receive(channel[2], &data) == SUCCESS);
+    mu_assert("test_select_lazy_send: Received wrong message", string_equal(data, "Message3"));
+
+    /* A select that times out never produces anything */
+    channel_send(channel[2], "Full");
+    struct timespec deadline;
+    deadlineAfter(0.01, &deadline);
+    mu_assert("test_select_lazy_send: Select did not time out", channel_select_until(list, CHANNELS, &index, &deadline) == TIMEOUT);
+    mu_assert("test_select_lazy_send: Produced payload on timeout", produce[0].calls + produce[1].calls + produce[2].calls == 1);
+
+    /* The payload is handed to a waiting receiver on an unbuffered channel */
+    channel_t* unbuffered = channel_create(0);
+    pthread_t pid;
+    receive_args rec_;
+    init_object_for_receive_api(&rec_, unbuffered, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rec_);
+    list[1].channel = unbuffered;
+    mu_assert("test_select_lazy_send: Select failed", channel_select(list, CHANNELS, &index) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_lazy_send: Received wrong index", index == 1);
+    mu_assert("test_select_lazy_send: Receive failed", rec_.out == SUCCESS);
+    mu_assert("test_select_lazy_send: Received wrong message", string_equal(rec_.data, "Message2"));
+    mu_assert("test_select_lazy_send: Did not produce payload exactly once", produce[0].calls == 0 && produce[1].calls == 1);
+
+    /* A receiver parked in a select is not reserved by the offer, so nothing is produced when it picks another case */
+    channel_t* other = channel_create(1);
+    select_t receiver[2] = {{other, RECV, NULL}, {unbuffered, RECV, NULL}};
+    select_t lazy[1] = {{unbuffered, SEND_LAZY, &producer[1]}};
+    for (size_t round = 0; round < 50; round++) {
+        produce[1].calls = 0;
+        select_args select_;
+        init_object_for_select_api(&select_, receiver, 2, NULL);
+        pthread_create(&pid, NULL, (void *)helper_select, &select_);
+        usleep(1000);
+        pthread_t lazy_pid;
+        select_until_args lazy_;
+        lazy_.select_list = lazy;
+        lazy_.list_size = 1;
+        deadlineAfter(0.02, &lazy_.deadline);
+        pthread_create(&lazy_pid, NULL, (void *)helper_select_until, &lazy_);
+        mu_assert("test_select_lazy_send: Send failed", channel_send(other, "Other") == SUCCESS);
+        pthread_join(pid, NULL);
+        pthread_join(lazy_pid, NULL);
+        mu_assert("test_select_lazy_send: Select failed", select_.out == SUCCESS);
+        if (select_.index == 1) {
+            mu_assert("test_select_lazy_send: Lazy send was not delivered", lazy_.out == SUCCESS && string_equal(receiver[1].data, "Message2"));
+            mu_assert("test_select_lazy_send: Did not produce payload exactly once", produce[1].calls == 1);
+            void* data;
+            mu_assert("test_select_lazy_send: Other message was lost", channel_non_blocking_receive(other, &data) == SUCCESS);
+        } else {
+            mu_assert("test_select_lazy_send: Lazy select did not time out", lazy_.out == TIMEOUT);
+            mu_assert("test_select_lazy_send: Produced payload for a receiver that picked another case", produce[1].calls == 0);
+        }
+    }
+    channel_close(other);
+    channel_destroy(other);
+
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t channel_count;
+    void* data;
+    size_t chosen;
+    enum channel_status out;
+} balanced_args;
+
+void* helper_send_balanced(balanced_args* myargs) {
+    myargs->out = channel_send_balanced(myargs->channels, myargs->channel_count, myargs->data, &myargs->chosen);
+    return NULL;
+}
+
+char* test_send_balanced() {
+    print_test_details(__func__, "Testing that balanced send spreads messages over the least loaded channels");
+
+    size_t CHANNELS = 8;
+    size_t CAPACITY = 16;
+    size_t MESSAGES = CHANNELS * CAPACITY / 2;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(CAPACITY);
+        list[i].dir = SEND;
+        list[i].channel = channel[i];
+        list[i].data = "Message";
+    }
+
+    /* Dispatching with select always fills the first channel that has room */
+    size_t index = CHANNELS;
+    uint64_t select_time = getTime();
+    for (size_t i = 0; i < MESSAGES; i++) {
+        mu_assert("test_send_balanced: Select failed", channel_select(list, CHANNELS, &index) == SUCCESS);
+    }
+    select_time = getTime() - select_time;
+    size_t select_spread = buffer_current_size(channel[0]->buffer) - buffer_current_size(channel[CHANNELS - 1]->buffer);
+
+    void* data = NULL;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        while (channel_non_blocking_receive(channel[i], &data) == SUCCESS);
+    }
+
+    /* Balanced send keeps the channels evenly loaded */
+    uint64_t balanced_time = getTime();
+    for (size_t i = 0; i < MESSAGES; i++) {
+        mu_assert("test_send_balanced: Balanced send failed", channel_send_balanced(channel, CHANNELS, "Message", &index) == SUCCESS);
+        mu_assert("test_send_balanced: Chose wrong index", index < CHANNELS);
+    }
+    balanced_time = getTime() - balanced_time;
+    size_t min = CAPACITY, max = 0;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        size_t size = buffer_current_size(channel[i]->buffer);
+        min = (size < min) ? size : min;
+        max = (size > max) ? size : max;
+    }
+    printf("dispatch of %zu messages over %zu channels: select spread %zu (%.3f us/op), balanced spread %zu (%.3f us/op)\n",
+           MESSAGES, CHANNELS, select_spread, convertTimeToSeconds(select_time) * 1e6 / (double)MESSAGES,
+           max - min, convertTimeToSeconds(balanced_time) * 1e6 / (double)MESSAGES);
+    mu_assert("test_send_balanced: Select did not fill the first channel", select_spread == CAPACITY);
+    mu_assert("test_send_balanced: Load is not balanced", max - min <= CAPACITY / 2);
+
+    /* Once every channel is full the call blocks until one of them has room */
+    for (size_t i = 0; i < CHANNELS * CAPACITY - MESSAGES; i++) {
+        mu_assert("test_send_balanced: Balanced send failed", channel_send_balanced(channel, CHANNELS, "Message", &index) == SUCCESS);
+    }
+    pthread_t pid;
+    balanced_args args = {channel, CHANNELS, "Last", CHANNELS, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_send_balanced, &args);
+    usleep(10000);
+    mu_assert("test_send_balanced: It isn't blocked as expected", args.out == GENERIC_ERROR);
+    mu_assert("test_send_balanced: Receive failed", channel_receive(channel[3], &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_send_balanced: Balanced send failed", args.out == SUCCESS);
+    mu_assert("test_send_balanced: Chose wrong index", args.chosen == 3);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    channel_t *channel;
+    void **items;
+    size_t count;
+    size_t done_count;
+    enum channel_status out;
+} batch_args;
+
+void* helper_receive_batch_wait(batch_args* myargs) {
+    myargs->out = channel_receive_batch_wait(myargs->channel, myargs->items, myargs->count, &myargs->done_count);
+    return NULL;
+}
+
+char* test_batch_send_receive() {
+    print_test_details(__func__, "Testing batch send and receive on buffered and unbuffered channels");
+
+    size_t CAPACITY = 8;
+    channel_t* channel = channel_create(CAPACITY);
+    void* items[2 * CAPACITY];
+    void* out[2 * CAPACITY];
+    for (size_t i = 0; i < 2 * CAPACITY; i++) {
+        items[i] = (void*)(i + 1);
+    }
+
+    /* A batch only takes what fits and keeps FIFO order across the wrap around of the ring */
+    size_t count = 0;
+    mu_assert("test_batch_send_receive: Batch send failed", channel_send_batch(channel, items, 5, &count) == SUCCESS);
+    mu_assert("test_batch_send_receive: Wrong sent count", count == 5);
+    mu_assert("test_batch_send_receive: Batch receive failed", channel_receive_batch(channel, out, 3, &count) == SUCCESS);
+    mu_assert("test_batch_send_receive: Wrong received count", count == 3);
+    mu_assert("test_batch_send_receive: Wrong order", out[0] == items[0] && out[1] == items[1] && out[2] == items[2]);
+    mu_assert("test_batch_send_receive: Batch send failed", channel_send_batch(channel, &items[5], 2 * CAPACITY - 5, &count) == SUCCESS);
+    mu_assert("test_batch_send_receive: Wrong sent count", count == CAPACITY - 2);
+    mu_assert("test_batch_send_receive: Batch send did not report full", channel_send_batch(channel, items, 1, &count) == CHANNEL_FULL);
+    mu_assert("test_batch_send_receive: Wrong sent count", count == 0);
+    mu_assert("test_batch_send_receive: Batch receive failed", channel_receive_batch(channel, out, 2 * CAPACITY, &count) == SUCCESS);
+    mu_assert("test_batch_send_receive: Wrong received count", count == CAPACITY);
+    for (size_t i = 0; i < CAPACITY; i++) {
+        mu_assert("test_batch_send_receive: Wrong order", out[i] == items[i + 3]);
+    }
+    mu_assert("test_batch_send_receive: Batch receive did not report empty", channel_receive_batch(channel, out, 1, &count) == CHANNEL_EMPTY);
+
+    /* The blocking variant waits for the first message and then takes whatever is there */
+    pthread_t pid;
+    batch_args args = {channel, out, 2 * CAPACITY, 0, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_receive_batch_wait, &args);
+    usleep(10000);
+    mu_assert("test_batch_send_receive: It isn't blocked as expected", args.out == GENERIC_ERROR);
+    mu_assert("test_batch_send_receive: Batch send failed", channel_send_batch(channel, items, 4, &count) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_batch_send_receive: Blocking batch receive failed", args.out == SUCCESS);
+    mu_assert("test_batch_send_receive: Wrong received count", args.done_count >= 1 && args.done_count <= 4);
+    for (size_t i = 0; i < args.done_count; i++) {
+        mu_assert("test_batch_send_receive: Wrong order", out[i] == items[i]);
+    }
+
+    channel_close(channel);
+    mu_assert("test_batch_send_receive: Batch send did not report close", channel_send_batch(channel, items, 1, &count) == CLOSED_ERROR);
+    mu_assert("test_batch_send_receive: Batch receive did not report close", channel_receive_batch_wait(channel, out, 1, &count) == CLOSED_ERROR);
+    channel_destroy(channel);
+
+    /* Unbuffered channels hand over one message per waiting partner */
+    channel = channel_create(0);
+    mu_assert("test_batch_send_receive: Batch send did not report full", channel_send_batch(channel, items, 2, &count) == CHANNEL_FULL);
+    send_args send_;
+    init_object_for_send_api(&send_, channel, "Message", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send_);
+    mu_assert("test_batch_send_receive: Blocking batch receive failed", channel_receive_batch_wait(channel, out, 4, &count) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_batch_send_receive: Wrong received count", count == 1);
+    mu_assert("test_batch_send_receive: Received wrong message", string_equal(out[0], "Message"));
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t channel_count;
+    void* data;
+    bool* delivered;
+    enum channel_status out;
+} multi_args;
+
+void* helper_send_multi(multi_args* myargs) {
+    myargs->out = channel_send_multi(myargs->channels, myargs->channel_count, myargs->data, MULTI_BLOCKING, myargs->delivered);
+    return NULL;
+}
+
+char* test_send_multi() {
+    print_test_details(__func__, "Testing multicast send of one message to several channels");
+
+    size_t CHANNELS = 4;
+    channel_t* channel[CHANNELS];
+    bool delivered[CHANNELS];
+    channel[0] = channel_create(2);
+    channel[1] = channel_create(1);
+    channel[2] = channel_create(0);
+    channel[3] = channel_create(2);
+
+    /* Non-blocking: the full and the unbuffered target are reported as not delivered */
+    channel_send(channel[1], "Full");
+    mu_assert("test_send_multi: Multi send did not report full", channel_send_multi(channel, CHANNELS, "Message1", MULTI_NON_BLOCKING, delivered) == CHANNEL_FULL);
+    mu_assert("test_send_multi: Wrong delivery", delivered[0] && !delivered[1] && !delivered[2] && delivered[3]);
+    void* data = NULL;
+    mu_assert("test_send_multi: Receive failed", channel_receive(channel[0], &data) == SUCCESS);
+    mu_assert("test_send_multi: Received wrong message", string_equal(data, "Message1"));
+    mu_assert("test_send_multi: Receive failed", channel_receive(channel[3], &data) == SUCCESS);
+    mu_assert("test_send_multi: Received wrong message", string_equal(data, "Message1"));
+
+    /* A channel listed twice gets the message twice */
+    channel_t* twice[2] = {channel[0], channel[0]};
+    mu_assert("test_send_multi: Multi send failed", channel_send_multi(twice, 2, "Message2", MULTI_NON_BLOCKING, delivered) == SUCCESS);
+    mu_assert("test_send_multi: Wrong delivery", delivered[0] && delivered[1]);
+    mu_assert("test_send_multi: Buffer size is not as expected", buffer_current_size(channel[0]->buffer) == 2);
+    channel_receive(channel[0], &data);
+    channel_receive(channel[0], &data);
+
+    /* Blocking: the call waits on the full and the unbuffered targets */
+    pthread_t pid;
+    bool blocking_delivered[CHANNELS];
+    multi_args args = {channel, CHANNELS, "Message3", blocking_delivered, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_send_multi, &args);
+    usleep(10000);
+    mu_assert("test_send_multi: It isn't blocked as expected", args.out == GENERIC_ERROR);
+    mu_assert("test_send_multi: Receive failed", channel_receive(channel[1], &data) == SUCCESS);
+    mu_assert("test_send_multi: Received wrong message", string_equal(data, "Full"));
+    mu_assert("test_send_multi: Receive failed", channel_receive(channel[1], &data) == SUCCESS);
+    mu_assert("test_send_multi: Received wrong message", string_equal(data, "Message3"));
+    mu_assert("test_send_multi: Receive failed", channel_receive(channel[2], &data) == SUCCESS);
+    mu_assert("test_send_multi: Received wrong message", string_equal(data, "Message3"));
+    pthread_join(pid, NULL);
+    mu_assert("test_send_multi: Multi send failed", args.out == SUCCESS);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        mu_assert("test_send_multi: Wrong delivery", blocking_delivered[i]);
+    }
+
+    /* A closed target is reported while the others still get the message */
+    channel_close(channel[3]);
+    mu_assert("test_send_multi: Multi send failed", channel_send_multi(channel, 2, "Message4", MULTI_NON_BLOCKING, delivered) == SUCCESS);
+    mu_assert("test_send_multi: Multi send did not report close", channel_send_multi(&channel[3], 1, "Message4", MULTI_NON_BLOCKING, delivered) == CLOSED_ERROR);
+    mu_assert("test_send_multi: Wrong delivery", !delivered[0]);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    broadcast_subscriber_t* subscriber;
+    size_t received;
+    bool in_order;
+    enum channel_status out;
+} subscriber_args;
+
+void* helper_broadcast_receive_all(subscriber_args* myargs) {
+    void* data = NULL;
+    myargs->received = 0;
+    myargs->in_order = true;
+    while ((myargs->out = broadcast_receive(myargs->subscriber, &data)) == SUCCESS) {
+        myargs->received++;
+        if ((size_t)data != myargs->received) {
+            myargs->in_order = false;
+        }
+    }
+    return NULL;
+}
+
+char* test_broadcast() {
+    print_test_details(__func__, "Testing that every broadcast subscriber sees every message in order");
+
+    size_t SUBSCRIBERS = 4;
+    size_t MESSAGES = 10000;
+    broadcast_t* broadcast = broadcast_create(3);
+    mu_assert("test_broadcast: Could not create broadcast channel", broadcast != NULL);
+    mu_assert("test_broadcast: Capacity was not rounded up", broadcast->capacity == 4);
+
+    /* With no subscribers publishing never blocks */
+    for (size_t i = 0; i < 2 * broadcast->capacity; i++) {
+        mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(broadcast, "Dropped") == SUCCESS);
+    }
+
+    /* Subscribers start with the next message and the producer is gated by the slowest one */
+    broadcast_subscriber_t* late = broadcast_subscribe(broadcast);
+    void* data = NULL;
+    mu_assert("test_broadcast: Late subscriber saw an earlier message", broadcast_non_blocking_receive(late, &data) == CHANNEL_EMPTY);
+    for (size_t i = 0; i < broadcast->capacity; i++) {
+        mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(broadcast, "Message") == SUCCESS);
+    }
+    mu_assert("test_broadcast: Publish did not report full", broadcast_non_blocking_publish(broadcast, "Message") == CHANNEL_FULL);
+    mu_assert("test_broadcast: Receive failed", broadcast_non_blocking_receive(late, &data) == SUCCESS);
+    mu_assert("test_broadcast: Received wrong message", string_equal(data, "Message"));
+    mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(broadcast, "Message") == SUCCESS);
+    /* Leaving releases the producer */
+    broadcast_unsubscribe(late);
+    mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(broadcast, "Message") == SUCCESS);
+
+    /* Concurrent subscribers each receive every message in order */
+    pthread_t pid[SUBSCRIBERS];
+    subscriber_args args[SUBSCRIBERS];
+    for (size_t i = 0; i < SUBSCRIBERS; i++) {
+        args[i].subscriber = broadcast_subscribe(broadcast);
+        args[i].out = GENERIC_ERROR;
+        mu_assert("test_broadcast: Could not subscribe", args[i].subscriber != NULL);
+    }
+    for (size_t i = 0; i < SUBSCRIBERS; i++) {
+        pthread_create(&pid[i], NULL, (void *)helper_broadcast_receive_all, &args[i]);
+    }
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_broadcast: Publish failed", broadcast_publish(broadcast, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_broadcast: Close failed", broadcast_close(broadcast) == SUCCESS);
+    for (size_t i = 0; i < SUBSCRIBERS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_broadcast: Subscriber did not see close", args[i].out == CLOSED_ERROR);
+        mu_assert("test_broadcast: Subscriber missed messages", args[i].received == MESSAGES);
+        mu_assert("test_broadcast: Subscriber received messages out of order", args[i].in_order);
+    }
+    mu_assert("test_broadcast: Publish did not report close", broadcast_publish(broadcast, "Message") == CLOSED_ERROR);
+    mu_assert("test_broadcast: Subscribe after close succeeded", broadcast_subscribe(broadcast) == NULL);
+
+    mu_assert("test_broadcast: Destroy failed", broadcast_destroy(broadcast) == SUCCESS);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t key;
+    void* data;
+    void* displaced;
+    enum channel_status out;
+} keyed_args;
+
+void* helper_send_keyed(keyed_args* myargs) {
+    myargs->out = channel_send_keyed(myargs->channel, myargs->key, myargs->data, &myargs->displaced);
+    return NULL;
+}
+
+char* test_send_keyed() {
+    print_test_details(__func__, "Testing that keyed sends on a conflating channel collapse to the latest message per key");
+
+    size_t CAPACITY = 3;
+    void* data = NULL;
+    void* displaced = (void*)0xdeadbeef;
+    mu_assert("test_send_keyed: Created an unbuffered conflating channel", channel_create_conflating(0) == NULL);
+    channel_t* plain = channel_create(CAPACITY);
+    mu_assert("test_send_keyed: Keyed send on a plain channel succeeded", channel_send_keyed(plain, 1, "Message", &displaced) == GENERIC_ERROR);
+    channel_close(plain);
+    channel_destroy(plain);
+
+    channel_t* channel = channel_create_conflating(CAPACITY);
+    mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, 1, "A1", &displaced) == SUCCESS);
+    mu_assert("test_send_keyed: Reported a displaced message for a new key", displaced == NULL);
+    mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, 2, "B1", &displaced) == SUCCESS);
+    mu_assert("test_send_keyed: Send failed", channel_send(channel, "Plain") == SUCCESS);
+    mu_assert("test_send_keyed: Channel size is wrong", buffer_current_size(channel->buffer) == CAPACITY);
+
+    /* Replacing a queued key does not need room and keeps its position */
+    mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, 1, "A2", &displaced) == SUCCESS);
+    mu_assert("test_send_keyed: Did not return the displaced message", string_equal(displaced, "A1"));
+    mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, 1, "A3", &displaced) == SUCCESS);
+    mu_assert("test_send_keyed: Did not return the displaced message", string_equal(displaced, "A2"));
+    mu_assert("test_send_keyed: Channel size is wrong", buffer_current_size(channel->buffer) == CAPACITY);
+    mu_assert("test_send_keyed: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_send_keyed: Received wrong message", string_equal(data, "A3"));
+
+    /* A received key starts over, and a new key waits for room */
+    mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, 1, "A4", &displaced) == SUCCESS);
+    mu_assert("test_send_keyed: Reported a displaced message for a received key", displaced == NULL);
+    keyed_args args = {channel, 3, "C1", (void*)0xdeadbeef, GENERIC_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_send_keyed, &args);
+    usleep(10000);
+    mu_assert("test_send_keyed: Keyed send did not block on a full channel", args.out == GENERIC_ERROR);
+    mu_assert("test_send_keyed: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_send_keyed: Received wrong message", string_equal(data, "B1"));
+    pthread_join(pid, NULL);
+    mu_assert("test_send_keyed: Blocked keyed send failed", args.out == SUCCESS);
+    mu_assert("test_send_keyed: Reported a displaced message for a new key", args.displaced == NULL);
+
+    const char* expected[] = {"Plain", "A4", "C1"};
+    for (size_t i = 0; i < CAPACITY; i++) {
+        mu_assert("test_send_keyed: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_send_keyed: Received wrong message", string_equal(data, expected[i]));
+    }
+
+    /* Keys stay found as the queue wraps around and received keys leave the index */
+    size_t MANY = 64;
+    channel_t* many = channel_create_conflating(MANY);
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t key = 0; key < MANY; key++) {
+            mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(many, key * MANY, (void*)(key + 1), &displaced) == SUCCESS);
+            mu_assert("test_send_keyed: Reported a displaced message for a new key", displaced == NULL);
+        }
+        for (size_t key = 0; key < MANY; key += 2) {
+            mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(many, key * MANY, (void*)(key + 2), &displaced) == SUCCESS);
+            mu_assert("test_send_keyed: Did not return the displaced message", displaced == (void*)(key + 1));
+        }
+        for (size_t key = 0; key < MANY; key++) {
+            mu_assert("test_send_keyed: Receive failed", channel_receive(many, &data) == SUCCESS);
+            mu_assert("test_send_keyed: Received wrong message", data == (void*)(key % 2 == 0 ? key + 2 : key + 1));
+        }
+        // half a queue more per round, so the next round starts at another position in the ring
+        for (size_t key = 0; key < MANY / 2; key++) {
+            mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(many, key, "Message", &displaced) == SUCCESS);
+        }
+        for (size_t key = 0; key < MANY / 2; key++) {
+            mu_assert("test_send_keyed: Receive failed", channel_receive(many, &data) == SUCCESS);
+        }
+    }
+    channel_close(many);
+    channel_destroy(many);
+
+    /* Close releases a blocked keyed send */
+    for (size_t i = 0; i < CAPACITY; i++) {
+        mu_assert("test_send_keyed: Keyed send failed", channel_send_keyed(channel, i, "Message", NULL) == SUCCESS);
+    }
+    args.key = CAPACITY;
+    args.out = GENERIC_ERROR;
+    pthread_create(&pid, NULL, (void *)helper_send_keyed, &args);
+    usleep(10000);
+    mu_assert("test_send_keyed: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_send_keyed: Blocked keyed send did not report close", args.out == CLOSED_ERROR);
+    mu_assert("test_send_keyed: Keyed send after close succeeded", channel_send_keyed(channel, 0, "Message", NULL) == CLOSED_ERROR);
+
+    mu_assert("test_send_keyed: Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+#define WATCH_FIELDS 9
+
+typedef struct {
+    uint32_t fields[WATCH_FIELDS];
+} watch_value_t;
+
+typedef struct {
+    watch_t* watch;
+    size_t snapshots;
+    size_t last;
+    bool consistent;
+    enum channel_status out;
+} watch_args;
+
+// Returns whether every field of the value holds version
+bool watch_value_is(watch_value_t* value, size_t version) {
+    for (size_t i = 0; i < WATCH_FIELDS; i++) {
+        if (value->fields[i] != version) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void* helper_watch_read(watch_args* myargs) {
+    watch_value_t value;
+    size_t version = 0;
+    myargs->consistent = true;
+    myargs->last = 0;
+    while (!atomic_load(&myargs->watch->is_closed)) {
+        watch_read(myargs->watch, &value, &version);
+        if (!watch_value_is(&value, version) || version < myargs->last) {
+            myargs->consistent = false;
+        }
+        myargs->last = version;
+        myargs->snapshots++;
+    }
+    return NULL;
+}
+
+void* helper_watch_wait(watch_args* myargs) {
+    watch_value_t value;
+    size_t version = 0;
+    myargs->consistent = true;
+    while ((myargs->out = watch_wait(myargs->watch, &value, &version)) == SUCCESS) {
+        if (!watch_value_is(&value, version) || version <= myargs->last) {
+            myargs->consistent = false;
+        }
+        myargs->last = version;
+        myargs->snapshots++;
+    }
+    return NULL;
+}
+
+char* test_watch() {
+    print_test_details(__func__, "Testing that watch readers always see a consistent snapshot of the latest value");
+
+    size_t READERS = 3;
+    size_t PUBLISHES = 20000;
+    watch_value_t value;
+    memset(&value, 0, sizeof(value));
+    mu_assert("test_watch: Created a watch for empty values", watch_create(0, &value) == NULL);
+    watch_t* watch = watch_create(sizeof(watch_value_t), &value);
+    mu_assert("test_watch: Could not create watch", watch != NULL);
+
+    size_t version = 1;
+    watch_value_t snapshot;
+    mu_assert("test_watch: Read failed", watch_read(watch, &snapshot, &version) == SUCCESS);
+    mu_assert("test_watch: Initial value is wrong", version == 0 && watch_value_is(&snapshot, 0));
+
+    pthread_t pid[READERS + 1];
+    watch_args args[READERS + 1];
+    memset(args, 0, sizeof(args));
+    for (size_t i = 0; i <= READERS; i++) {
+        args[i].watch = watch;
+        args[i].out = GENERIC_ERROR;
+        pthread_create(&pid[i], NULL, i < READERS ? (void *)helper_watch_read : (void *)helper_watch_wait, &args[i]);
+    }
+    for (size_t i = 1; i <= PUBLISHES; i++) {
+        for (size_t j = 0; j < WATCH_FIELDS; j++) {
+            value.fields[j] = (uint32_t)i;
+        }
+        mu_assert("test_watch: Publish failed", watch_publish(watch, &value) == SUCCESS);
+    }
+    mu_assert("test_watch: Close failed", watch_close(watch) == SUCCESS);
+    for (size_t i = 0; i <= READERS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_watch: Reader saw a torn or older snapshot", args[i].consistent);
+    }
+    mu_assert("test_watch: Waiting reader did not see close", args[READERS].out == CLOSED_ERROR);
+    mu_assert("test_watch: Waiting reader missed the last version", args[READERS].last == PUBLISHES);
+
+    /* The last value stays readable after close */
+    mu_assert("test_watch: Read after close failed", watch_read(watch, &snapshot, &version) == SUCCESS);
+    mu_assert("test_watch: Last value is wrong", version == PUBLISHES && watch_value_is(&snapshot, PUBLISHES));
+    mu_assert("test_watch: Wait after close did not report close", watch_wait(watch, &snapshot, &version) == CLOSED_ERROR);
+    mu_assert("test_watch: Publish after close succeeded", watch_publish(watch, &value) == CLOSED_ERROR);
+
+    mu_assert("test_watch: Destroy failed", watch_destroy(watch) == SUCCESS);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+    size_t writer_capacity;
+    enum channel_status out;
+} writer_args;
+
+// Sends 1 to count through a writer with a stage of writer_capacity entries, or with plain channel_send if it is 0
+void* helper_writer_send(writer_args* myargs) {
+    myargs->out = SUCCESS;
+    if (myargs->writer_capacity == 0) {
+        for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+            myargs->out = channel_send(myargs->channel, (void*)i);
+        }
+        return NULL;
+    }
+    channel_writer_t* writer = channel_writer_create(myargs->channel, myargs->writer_capacity);
+    for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_writer_send(writer, (void*)i);
+    }
+    if (myargs->out == SUCCESS) {
+        myargs->out = channel_writer_flush(writer);
+    }
+    channel_writer_destroy(writer);
+    return NULL;
+}
+
+char* test_channel_writer() {
+    print_test_details(__func__, "Testing that a channel writer stages messages and flushes them in order");
+
+    size_t CAPACITY = 4;
+    size_t MESSAGES = 10000;
+    void* data = NULL;
+    channel_t* channel = channel_create(CAPACITY);
+    mu_assert("test_channel_writer: Created a writer without a stage", channel_writer_create(channel, 0) == NULL);
+    channel_writer_t* writer = channel_writer_create(channel, 2 * CAPACITY);
+
+    /* Staged messages are only visible after a flush */
+    for (size_t i = 1; i <= CAPACITY - 1; i++) {
+        mu_assert("test_channel_writer: Writer send failed", channel_writer_send(writer, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_writer: Staged message was visible", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_channel_writer: Pending count is wrong", channel_writer_pending(writer) == CAPACITY - 1);
+    mu_assert("test_channel_writer: Flush failed", channel_writer_flush(writer) == SUCCESS);
+    mu_assert("test_channel_writer: Pending count is wrong", channel_writer_pending(writer) == 0);
+    mu_assert("test_channel_writer: Channel size is wrong", buffer_current_size(channel->buffer) == CAPACITY - 1);
+
+    /* A non-blocking flush writes what fits and keeps the rest staged in order */
+    for (size_t i = CAPACITY; i < CAPACITY + 3; i++) {
+        mu_assert("test_channel_writer: Writer send failed", channel_writer_send(writer, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_writer: Try flush did not report full", channel_writer_try_flush(writer) == CHANNEL_FULL);
+    mu_assert("test_channel_writer: Pending count is wrong", channel_writer_pending(writer) == 2);
+    for (size_t i = 1; i <= CAPACITY; i++) {
+        mu_assert("test_channel_writer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_writer: Received wrong message", (size_t)data == i);
+    }
+    mu_assert("test_channel_writer: Try flush failed", channel_writer_try_flush(writer) == SUCCESS);
+    for (size_t i = CAPACITY + 1; i < CAPACITY + 3; i++) {
+        mu_assert("test_channel_writer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_writer: Received wrong message", (size_t)data == i);
+    }
+    channel_writer_destroy(writer);
+
+    /* A producer thread bursting through a writer keeps FIFO order */
+    writer_args args = {channel, MESSAGES, 16, GENERIC_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_writer_send, &args);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_channel_writer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_writer: Received wrong message", (size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_writer: Writer thread failed", args.out == SUCCESS);
+
+    /* Per message cost of a producer with channel_send and with a writer, against a consumer draining in batches */
+    size_t TIMED_MESSAGES = 200000;
+    size_t TIMED_CAPACITY = 256;
+    size_t TIMED_STAGE = 64;
+    size_t STAGES[] = {0, TIMED_STAGE};
+    uint64_t times[2];
+    void* batch[64];
+    for (size_t s = 0; s < 2; s++) {
+        channel_t* timed = channel_create(TIMED_CAPACITY);
+        writer_args timed_args = {timed, TIMED_MESSAGES, STAGES[s], GENERIC_ERROR};
+        size_t next = 1;
+        times[s] = getTime();
+        pthread_create(&pid, NULL, (void *)helper_writer_send, &timed_args);
+        while (next <= TIMED_MESSAGES) {
+            size_t received = 0;
+            mu_assert("test_channel_writer: Batch receive failed", channel_receive_batch_wait(timed, batch, sizeof(batch) / sizeof(batch[0]), &received) == SUCCESS);
+            for (size_t i = 0; i < received; i++, next++) {
+                mu_assert("test_channel_writer: Received wrong message", (size_t)batch[i] == next);
+            }
+        }
+        pthread_join(pid, NULL);
+        times[s] = getTime() - times[s];
+        mu_assert("test_channel_writer: Timed producer failed", timed_args.out == SUCCESS);
+        mu_assert("test_channel_writer: Close failed", channel_close(timed) == SUCCESS);
+        mu_assert("test_channel_writer: Destroy failed", channel_destroy(timed) == SUCCESS);
+    }
+    printf("%zu messages into a %zu slot channel: %.1f ns/msg with channel_send, %.1f ns/msg through a %zu entry writer\n",
+           TIMED_MESSAGES, TIMED_CAPACITY, convertTimeToSeconds(times[0]) * 1e9 / (double)TIMED_MESSAGES,
+           convertTimeToSeconds(times[1]) * 1e9 / (double)TIMED_MESSAGES, TIMED_STAGE);
+
+    /* Messages that could not be written stay staged when the channel closes */
+    writer = channel_writer_create(channel, 2);
+    mu_assert("test_channel_writer: Writer send failed", channel_writer_send(writer, "Message") == SUCCESS);
+    mu_assert("test_channel_writer: Close failed", channel_close(channel) == SUCCESS);
+    mu_assert("test_channel_writer: Flush did not report close", channel_writer_flush(writer) == CLOSED_ERROR);
+    mu_assert("test_channel_writer: Pending count is wrong", channel_writer_pending(writer) == 1);
+    channel_writer_destroy(writer);
+
+    mu_assert("test_channel_writer: Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+    enum channel_status out;
+} sequence_args;
+
+void* helper_send_sequence(sequence_args* myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_send(myargs->channel, (void*)i);
+    }
+    return NULL;
+}
+
+char* test_channel_forward() {
+    print_test_details(__func__, "Testing that forwarding moves messages between channels in order");
+
+    size_t MESSAGES = 10000;
+    size_t forwarded = 0;
+    void* data = NULL;
+    channel_t* src = channel_create(4);
+    channel_t* dst = channel_create(2);
+    channel_t* unbuffered = channel_create(0);
+    mu_assert("test_channel_forward: Forwarded to the same channel", channel_forward(src, src, 1, &forwarded) == GENERIC_ERROR);
+    mu_assert("test_channel_forward: Forwarded to an unbuffered channel", channel_forward(src, unbuffered, 1, &forwarded) == GENERIC_ERROR);
+    mu_assert("test_channel_forward: Started a forwarder on an unbuffered channel", channel_forwarder_start(unbuffered, dst, 1) == NULL);
+    mu_assert("test_channel_forward: Forward from an empty channel moved data", channel_forward(src, dst, 4, &forwarded) == CHANNEL_EMPTY);
+    mu_assert("test_channel_forward: Forward count is wrong", forwarded == 0);
+
+    /* A forward stops at max, at the room in dst and at the messages in src */
+    for (size_t i = 1; i <= 3; i++) {
+        mu_assert("test_channel_forward: Send failed", channel_send(src, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_forward: Forward failed", channel_forward(src, dst, 1, &forwarded) == SUCCESS);
+    mu_assert("test_channel_forward: Forward did not stop at max", forwarded == 1);
+    mu_assert("test_channel_forward: Forward failed", channel_forward(src, dst, 4, &forwarded) == SUCCESS);
+    mu_assert("test_channel_forward: Forward did not stop at the room in dst", forwarded == 1);
+    mu_assert("test_channel_forward: Forward to a full channel moved data", channel_forward(src, dst, 4, &forwarded) == CHANNEL_FULL);
+    for (size_t i = 1; i <= 2; i++) {
+        mu_assert("test_channel_forward: Receive failed", channel_receive(dst, &data) == SUCCESS);
+        mu_assert("test_channel_forward: Received wrong message", (size_t)data == i);
+    }
+    /* Forwarding back the other way takes the locks in the same order */
+    mu_assert("test_channel_forward: Send failed", channel_send(dst, (void*)4) == SUCCESS);
+    mu_assert("test_channel_forward: Forward failed", channel_forward(dst, src, 4, &forwarded) == SUCCESS);
+    mu_assert("test_channel_forward: Forward count is wrong", forwarded == 1);
+    for (size_t i = 3; i <= 4; i++) {
+        mu_assert("test_channel_forward: Receive failed", channel_receive(src, &data) == SUCCESS);
+        mu_assert("test_channel_forward: Received wrong message", (size_t)data == i);
+    }
+
+    /* A pipeline of two forwarders relays a stream in order */
+    channel_t* sink = channel_create(3);
+    channel_forwarder_t* first = channel_forwarder_start(src, dst, 16);
+    channel_forwarder_t* second = channel_forwarder_start(dst, sink, 16);
+    mu_assert("test_channel_forward: Could not start forwarder", first != NULL && second != NULL);
+    sequence_args args = {src, MESSAGES, GENERIC_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_send_sequence, &args);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_channel_forward: Receive failed", channel_receive(sink, &data) == SUCCESS);
+        mu_assert("test_channel_forward: Received wrong message", (size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_forward: Sender failed", args.out == SUCCESS);
+
+    /* Closing a channel stops the forwarders that use it */
+    mu_assert("test_channel_forward: Close failed", channel_close(src) == SUCCESS);
+    mu_assert("test_channel_forward: Forwarder did not report close", channel_forwarder_stop(first, &forwarded) == CLOSED_ERROR);
+    mu_assert("test_channel_forward: Forwarder count is wrong", forwarded == MESSAGES);
+    mu_assert("test_channel_forward: Close failed", channel_close(dst) == SUCCESS);
+    mu_assert("test_channel_forward: Forwarder did not report close", channel_forwarder_stop(second, &forwarded) == CLOSED_ERROR);
+    mu_assert("test_channel_forward: Forwarder count is wrong", forwarded == MESSAGES);
+
+    channel_close(sink);
+    channel_close(unbuffered);
+    channel_destroy(src);
+    channel_destroy(dst);
+    channel_destroy(sink);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+char* test_close_write() {
+    print_test_details(__func__, "Testing that receivers drain a channel closed for writing");
+
+    size_t CAPACITY = 4;
+    size_t RECEIVERS = 3;
+    void* data = NULL;
+    size_t selected_index = 0;
+    channel_t* channel = channel_create(CAPACITY);
+
+    /* Senders are refused but buffered messages can still be received, also by select */
+    mu_assert("test_close_write: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_close_write: Send failed", channel_send(channel, "Message2") == SUCCESS);
+    mu_assert("test_close_write: Close write failed", channel_close_write(channel) == SUCCESS);
+    mu_assert("test_close_write: Close write did not report close", channel_close_write(channel) == CLOSED_ERROR);
+    mu_assert("test_close_write: Send after close succeeded", channel_send(channel, "Message3") == CLOSED_ERROR);
+    mu_assert("test_close_write: Non-blocking send after close succeeded", channel_non_blocking_send(channel, "Message3") == CLOSED_ERROR);
+    mu_assert("test_close_write: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_close_write: Received wrong message", string_equal(data, "Message1"));
+    select_t select_list[] = {{channel, RECV, NULL}};
+    mu_assert("test_close_write: Select failed", channel_select(select_list, 1, &selected_index) == SUCCESS);
+    mu_assert("test_close_write: Selected wrong message", string_equal(select_list[0].data, "Message2"));
+    mu_assert("test_close_write: Receive from a drained channel did not report close", channel_receive(channel, &data) == CLOSED_ERROR);
+    mu_assert("test_close_write: Non-blocking receive from a drained channel did not report close", channel_non_blocking_receive(channel, &data) == CLOSED_ERROR);
+    mu_assert("test_close_write: Select on a drained channel did not report close", channel_select(select_list, 1, &selected_index) == CLOSED_ERROR);
+    mu_assert("test_close_write: Close did not complete the close", channel_close(channel) == SUCCESS);
+    mu_assert("test_close_write: Close did not report close", channel_close(channel) == CLOSED_ERROR);
+    mu_assert("test_close_write: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* A full close after a write close drops what is left */
+    channel = channel_create(CAPACITY);
+    void* items[] = {"Message1", "Message2", "Message3"};
+    size_t count = 0;
+    mu_assert("test_close_write: Batch send failed", channel_send_batch(channel, items, 3, &count) == SUCCESS);
+    mu_assert("test_close_write: Close write failed", channel_close_write(channel) == SUCCESS);
+    void* out[CAPACITY];
+    mu_assert("test_close_write: Batch receive failed", channel_receive_batch(channel, out, 2, &count) == SUCCESS);
+    mu_assert("test_close_write: Batch receive count is wrong", count == 2);
+    mu_assert("test_close_write: Close failed", channel_close(channel) == SUCCESS);
+    mu_assert("test_close_write: Receive after close succeeded", channel_receive(channel, &data) == CLOSED_ERROR);
+    mu_assert("test_close_write: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* Blocked receivers are released on buffered and unbuffered channels */
+    for (size_t size = 0; size <= 1; size++) {
+        channel = channel_create(size);
+        pthread_t pid[RECEIVERS];
+        receive_args args[RECEIVERS];
+        for (size_t i = 0; i < RECEIVERS; i++) {
+            args[i].channel = channel;
+            args[i].data = NULL;
+            args[i].out = GENERIC_ERROR;
+            args[i].done = NULL;
+            pthread_create(&pid[i], NULL, (void *)helper_receive, &args[i]);
+        }
+        usleep(10000);
+        mu_assert("test_close_write: Close write failed", channel_close_write(channel) == SUCCESS);
+        for (size_t i = 0; i < RECEIVERS; i++) {
+            pthread_join(pid[i], NULL);
+            mu_assert("test_close_write: Blocked receive did not report close", args[i].out == CLOSED_ERROR);
+        }
+        mu_assert("test_close_write: Destroy failed", channel_destroy(channel) == SUCCESS);
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    channel_sender_t sender;
+    size_t count;
+    enum channel_status out;
+} endpoint_args;
+
+void* helper_send_and_drop(endpoint_args* myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_send(myargs->sender.channel, (void*)i);
+    }
+    if (myargs->out == SUCCESS) {
+        myargs->out = channel_sender_drop(myargs->sender);
+    }
+    return NULL;
+}
+
+char* test_endpoint_handles() {
+    print_test_details(__func__, "Testing that dropping the last sender or receiver handle closes the channel");
+
+    size_t SENDERS = 3;
+    size_t MESSAGES = 1000;
+    void* data = NULL;
+    channel_t* channel = channel_create(4);
+
+    /* The last sender to finish closes the channel for writing, and receivers drain it */
+    channel_receiver_t receiver = channel_receiver(channel);
+    pthread_t pid[SENDERS];
+    endpoint_args args[SENDERS];
+    args[0].sender = channel_sender(channel);
+    for (size_t i = 0; i < SENDERS; i++) {
+        if (i > 0) {
+            args[i].sender = channel_sender_clone(args[0].sender);
+        }
+        args[i].count = MESSAGES;
+        args[i].out = GENERIC_ERROR;
+    }
+    for (size_t i = 0; i < SENDERS; i++) {
+        pthread_create(&pid[i], NULL, (void *)helper_send_and_drop, &args[i]);
+    }
+    size_t received = 0;
+    enum channel_status status;
+    while ((status = channel_receive(receiver.channel, &data)) == SUCCESS) {
+        received++;
+    }
+    mu_assert("test_endpoint_handles: Receive did not report close", status == CLOSED_ERROR);
+    mu_assert("test_endpoint_handles: Messages were lost", received == SENDERS * MESSAGES);
+    for (size_t i = 0; i < SENDERS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_endpoint_handles: Sender failed", args[i].out == SUCCESS);
+    }
+    mu_assert("test_endpoint_handles: Dropped a sender twice", channel_sender_drop(args[0].sender) == GENERIC_ERROR);
+    mu_assert("test_endpoint_handles: Receiver drop failed", channel_receiver_drop(receiver) == SUCCESS);
+    mu_assert("test_endpoint_handles: Dropped a receiver twice", channel_receiver_drop(receiver) == GENERIC_ERROR);
+    mu_assert("test_endpoint_handles: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* The last receiver to leave abandons the channel and releases blocked senders */
+    channel = channel_create(1);
+    receiver = channel_receiver(channel);
+    channel_receiver_t other = channel_receiver_clone(receiver);
+    mu_assert("test_endpoint_handles: Send failed", channel_send(channel, "Message") == SUCCESS);
+    send_args blocked = {channel, "Message", GENERIC_ERROR, NULL};
+    pthread_t sender_pid;
+    pthread_create(&sender_pid, NULL, (void *)helper_send, &blocked);
+    usleep(10000);
+    mu_assert("test_endpoint_handles: Receiver drop failed", channel_receiver_drop(other) == SUCCESS);
+    mu_assert("test_endpoint_handles: Dropping one of two receivers closed the channel", channel->is_closed == false);
+    mu_assert("test_endpoint_handles: Receiver drop failed", channel_receiver_drop(receiver) == SUCCESS);
+    pthread_join(sender_pid, NULL);
+    mu_assert("test_endpoint_handles: Blocked send did not fail", blocked.out == CLOSED_ERROR);
+    mu_assert("test_endpoint_handles: Send to an abandoned channel succeeded", channel_non_blocking_send(channel, "Message") == CLOSED_ERROR);
+    mu_assert("test_endpoint_handles: Sender drop failed", channel_sender_drop(channel_sender(channel)) == SUCCESS);
+    mu_assert("test_endpoint_handles: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t first;
+    size_t count;
+    bool correct;
+    enum channel_status out;
+} rpc_args;
+
+void* helper_rpc_server(rpc_args* myargs) {
+    void* data = NULL;
+    myargs->count = 0;
+    while ((myargs->out = channel_receive(myargs->channel, &data)) == SUCCESS) {
+        rpc_token_t* token = data;
+        channel_reply(token, (void*)(2 * (size_t)rpc_request(token)));
+        myargs->count++;
+    }
+    return NULL;
+}
+
+void* helper_rpc_client(rpc_args* myargs) {
+    void* reply = NULL;
+    myargs->correct = true;
+    myargs->out = SUCCESS;
+    for (size_t i = myargs->first; i < myargs->first + myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_call(myargs->channel, (void*)i, &reply);
+        if ((size_t)reply != 2 * i) {
+            myargs->correct = false;
+        }
+    }
+    return NULL;
+}
+
+// Serves count calls and then shuts down, failing the next call it receives instead of serving it
+void* helper_rpc_shutdown_server(rpc_args* myargs) {
+    void* data = NULL;
+    for (size_t i = 0; i <= myargs->count; i++) {
+        myargs->out = channel_receive(myargs->channel, &data);
+        if (myargs->out != SUCCESS) {
+            return NULL;
+        }
+        rpc_token_t* token = data;
+        if (i < myargs->count) {
+            channel_reply(token, (void*)(2 * (size_t)rpc_request(token)));
+        } else {
+            channel_reply_error(token);
+        }
+    }
+    return NULL;
+}
+
+char* test_channel_call() {
+    print_test_details(__func__, "Testing that every call gets the reply to its own request");
+
+    size_t CLIENTS = 4;
+    size_t CALLS = 2000;
+    channel_t* channel = channel_create(2);
+
+    rpc_args server = {channel, 0, 0, false, GENERIC_ERROR};
+    pthread_t server_pid;
+    pthread_create(&server_pid, NULL, (void *)helper_rpc_server, &server);
+
+    pthread_t pid[CLIENTS];
+    rpc_args clients[CLIENTS];
+    for (size_t i = 0; i < CLIENTS; i++) {
+        clients[i].channel = channel;
+        clients[i].first = 1 + i * CALLS;
+        clients[i].count = CALLS;
+        clients[i].out = GENERIC_ERROR;
+        pthread_create(&pid[i], NULL, (void *)helper_rpc_client, &clients[i]);
+    }
+    for (size_t i = 0; i < CLIENTS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_channel_call: Call failed", clients[i].out == SUCCESS);
+        mu_assert("test_channel_call: Call got the wrong reply", clients[i].correct);
+    }
+
+    /* The calling thread's slot is reused across calls */
+    void* reply = NULL;
+    mu_assert("test_channel_call: Call failed", channel_call(channel, (void*)21, &reply) == SUCCESS);
+    mu_assert("test_channel_call: Call got the wrong reply", (size_t)reply == 42);
+    mu_assert("test_channel_call: Call failed", channel_call(channel, (void*)5, &reply) == SUCCESS);
+    mu_assert("test_channel_call: Call got the wrong reply", (size_t)reply == 10);
+
+    mu_assert("test_channel_call: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(server_pid, NULL);
+    mu_assert("test_channel_call: Server did not see close", server.out == CLOSED_ERROR);
+    mu_assert("test_channel_call: Server count is wrong", server.count == CLIENTS * CALLS + 2);
+    mu_assert("test_channel_call: Call on a closed channel did not report close", channel_call(channel, (void*)1, &reply) == CLOSED_ERROR);
+    mu_assert("test_channel_call: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* A call without a server gives up at its deadline, and the late reply does not reach the thread's next call */
+    channel = channel_create(2);
+    struct timespec deadline;
+    deadlineAfter(0.02, &deadline);
+    reply = NULL;
+    mu_assert("test_channel_call: Call did not time out", channel_call_until(channel, (void*)7, &reply, &deadline) == TIMEOUT);
+    mu_assert("test_channel_call: Timed out call stored a reply", reply == NULL);
+    rpc_args shutdown = {channel, 0, 2, false, GENERIC_ERROR};
+    pthread_create(&server_pid, NULL, (void *)helper_rpc_shutdown_server, &shutdown);
+    mu_assert("test_channel_call: Call failed", channel_call(channel, (void*)9, &reply) == SUCCESS);
+    mu_assert("test_channel_call: Call got the late reply", (size_t)reply == 18);
+
+    /* Calls in flight when the server shuts down and the channel is closed all fail instead of waiting forever */
+    for (size_t i = 0; i < CLIENTS; i++) {
+        clients[i].channel = channel;
+        clients[i].first = 1;
+        clients[i].count = 1;
+        clients[i].out = GENERIC_ERROR;
+        pthread_create(&pid[i], NULL, (void *)helper_rpc_client, &clients[i]);
+    }
+    usleep(10000);
+    pthread_join(server_pid, NULL);
+    mu_assert("test_channel_call: Server did not shut down", shutdown.out == SUCCESS);
+    mu_assert("test_channel_call: Close failed", channel_call_close(channel) == SUCCESS);
+    for (size_t i = 0; i < CLIENTS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_channel_call: Call in flight did not report close", clients[i].out == CLOSED_ERROR);
+    }
+    mu_assert("test_channel_call: Call on a closed channel did not report close", channel_call(channel, (void*)1, &reply) == CLOSED_ERROR);
+    mu_assert("test_channel_call: Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    msg_pool_t* pool;
+    size_t count;
+    enum channel_status out;
+} pool_args;
+
+void* helper_pool_produce(pool_args* myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+        size_t* message = msg_pool_alloc(myargs->pool);
+        if (message == NULL) {
+            myargs->out = GENERIC_ERROR;
+            break;
+        }
+        message[0] = i;
+        message[2] = i;
+        myargs->out = channel_send(myargs->channel, message);
+    }
+    return NULL;
+}
+
+char* test_msg_pool() {
+    print_test_details(__func__, "Testing that pool blocks freed by a consumer go back to the producer's cache");
+
+    size_t MESSAGES = 10000;
+    size_t SLAB = 8;
+    mu_assert("test_msg_pool: Created a pool of empty blocks", msg_pool_create(0, SLAB) == NULL);
+    msg_pool_t* pool = msg_pool_create(3 * sizeof(size_t), SLAB);
+    mu_assert("test_msg_pool: Could not create pool", pool != NULL);
+
+    /* Blocks are aligned, distinct, and reused in LIFO order by their own thread */
+    void* first = msg_pool_alloc(pool);
+    void* second = msg_pool_alloc(pool);
+    mu_assert("test_msg_pool: Allocation failed", first != NULL && second != NULL && first != second);
+    mu_assert("test_msg_pool: Block is not aligned", ((uintptr_t)first % 16) == 0 && ((uintptr_t)second % 16) == 0);
+    msg_pool_free(second);
+    mu_assert("test_msg_pool: Freed block was not reused", msg_pool_alloc(pool) == second);
+    msg_pool_free(first);
+    msg_pool_free(second);
+    msg_pool_free(NULL);
+
+    /* Blocks freed by the consumer are recycled by the producer instead of growing the pool */
+    channel_t* channel = channel_create(4);
+    pool_args args = {channel, pool, MESSAGES, GENERIC_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_pool_produce, &args);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        void* data = NULL;
+        mu_assert("test_msg_pool: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        size_t* message = data;
+        mu_assert("test_msg_pool: Received wrong message", message[0] == i && message[2] == i);
+        msg_pool_free(message);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_msg_pool: Producer failed", args.out == SUCCESS);
+    /* one slab for this thread, and at most 4 + 2 blocks are ever in flight from the producer's single slab */
+    mu_assert("test_msg_pool: Pool kept growing", list_count(pool->slabs) == 2);
+    mu_assert("test_msg_pool: Wrong number of caches", list_count(pool->caches) == 2);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    msg_pool_destroy(pool);
+    return NULL;
+}
+
+void* helper_destroy_channels(channel_t* channels) {
+    void* data = NULL;
+    while (channel_receive(channels, &data) == SUCCESS) {
+        channel_t* channel = data;
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_channel_churn() {
+    print_test_details(__func__, "Benchmarking channel create/destroy churn");
+
+    size_t ROUNDS = 20000;
+    size_t SIZES[] = {0, 1, 16, 256, 4096};
+    size_t SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+    for (size_t s = 0; s < SIZE_COUNT; s++) {
+        uint64_t time = getTime();
+        for (size_t round = 0; round < ROUNDS; round++) {
+            channel_t* channel = channel_create(SIZES[s]);
+            mu_assert("test_channel_churn: Could not create channel", channel != NULL);
+            if (SIZES[s] > 0) {
+                void* data = NULL;
+                mu_assert("test_channel_churn: Send failed", channel_send(channel, "Message") == SUCCESS);
+                mu_assert("test_channel_churn: Receive failed", channel_receive(channel, &data) == SUCCESS);
+                mu_assert("test_channel_churn: Received wrong message", string_equal(data, "Message"));
+                mu_assert("test_channel_churn: Recycled channel is not empty", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+            }
+            mu_assert("test_channel_churn: Close failed", channel_close(channel) == SUCCESS);
+            mu_assert("test_channel_churn: Destroy failed", channel_destroy(channel) == SUCCESS);
+        }
+        time = getTime() - time;
+        printf("size %zu: %.0f channel creates+destroys per second\n", SIZES[s], (double)ROUNDS / convertTimeToSeconds(time));
+    }
+
+    /* Channels destroyed on another thread go to that thread's slab */
+    channel_t* handoff = channel_create(8);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_destroy_channels, handoff);
+    for (size_t round = 0; round < ROUNDS; round++) {
+        channel_t* channel = channel_create(round % 32);
+        mu_assert("test_channel_churn: Could not create channel", channel != NULL);
+        mu_assert("test_channel_churn: Send failed", channel_send(handoff, channel) == SUCCESS);
+    }
+    mu_assert("test_channel_churn: Close failed", channel_close_write(handoff) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_churn: Destroy failed", channel_destroy(handoff) == SUCCESS);
+
+    return NULL;
+}
+
+char* test_channel_footprint() {
+    print_test_details(__func__, "Testing the memory footprint of idle channels");
+
+    size_t CHANNELS = 100000;
+    channel_t** channels = malloc(CHANNELS * sizeof(channel_t*));
+    mu_assert("test_channel_footprint: Could not allocate channel array", channels != NULL);
+
+    /* An idle buffered channel is one block: the channel, its buffer and its ring */
+    struct mallinfo2 before = mallinfo2();
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channels[i] = channel_create(1);
+        mu_assert("test_channel_footprint: Could not create channel", channels[i] != NULL);
+    }
+    struct mallinfo2 after = mallinfo2();
+    size_t footprint = channel_footprint(channels[0]);
+    printf("idle size 1 channel: %zu bytes reported, %.1f bytes per channel from malloc\n", footprint, (double)(after.uordblks - before.uordblks) / (double)CHANNELS);
+    mu_assert("test_channel_footprint: Idle channel is too large", footprint <= 128 + sizeof(void*));
+    mu_assert("test_channel_footprint: Idle channel has waiter state", channels[0]->waiters == NULL);
+
+    /* Traffic that never blocks does not add waiter state */
+    void* data = NULL;
+    mu_assert("test_channel_footprint: Send failed", channel_send(channels[0], "Message1") == SUCCESS);
+    mu_assert("test_channel_footprint: Receive failed", channel_receive(channels[0], &data) == SUCCESS);
+    mu_assert("test_channel_footprint: Received wrong message", string_equal(data, "Message1"));
+    mu_assert("test_channel_footprint: Non-blocking traffic grew the channel", channel_footprint(channels[0]) == footprint);
+
+    /* A blocked receiver creates the waiter state, which stays until destroy */
+    receive_args args;
+    init_object_for_receive_api(&args, channels[0], NULL);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_receive, &args);
+    while (channel_footprint(channels[0]) == footprint) {
+        usleep(1000);
+    }
+    mu_assert("test_channel_footprint: Send failed", channel_send(channels[0], "Message2") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_footprint: Receive failed", args.out == SUCCESS && string_equal(args.data, "Message2"));
+    size_t waited = channel_footprint(channels[0]);
+    printf("size 1 channel after a blocking receive: %zu bytes\n", waited);
+    mu_assert("test_channel_footprint: Waiter state was not counted", waited == footprint + sizeof(channel_waiters_t));
+
+    /* A select registers on the waiter state for as long as it runs */
+    select_t list[] = {{.channel = channels[1], .dir = RECV}};
+    select_args select;
+    init_object_for_select_api(&select, list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &select);
+    while (channel_footprint(channels[1]) <= footprint + sizeof(channel_waiters_t)) {
+        usleep(1000);
+    }
+    mu_assert("test_channel_footprint: Send failed", channel_send(channels[1], "Message3") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_footprint: Select failed", select.out == SUCCESS && string_equal(list[0].data, "Message3"));
+    mu_assert("test_channel_footprint: Select registration was not removed", channel_footprint(channels[1]) == waited);
+
+    /* An unbuffered channel creates its waiter state up front */
+    channel_t* unbuffered = channel_create(0);
+    printf("unbuffered channel: %zu bytes\n", channel_footprint(unbuffered));
+    mu_assert("test_channel_footprint: Unbuffered channel has no waiter state", unbuffered->waiters != NULL);
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channels[i]);
+        mu_assert("test_channel_footprint: Destroy failed", channel_destroy(channels[i]) == SUCCESS);
+    }
+    free(channels);
+    return NULL;
+}
+
+char* test_mapped_channel() {
+    print_test_details(__func__, "Testing channels with mapped rings");
+
+    /* Growth keeps FIFO order when the ring has wrapped around */
+    channel_t* channel = channel_create_mapped(4, RING_MAP_DEFAULT);
+    mu_assert("test_mapped_channel: Could not create channel", channel != NULL);
+    void* data = NULL;
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_mapped_channel: Send failed", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    for (size_t i = 1; i <= 2; i++) {
+        mu_assert("test_mapped_channel: Receive failed", channel_receive(channel, &data) == SUCCESS && (size_t)data == i);
+    }
+    for (size_t i = 5; i <= 6; i++) {
+        mu_assert("test_mapped_channel: Send failed", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_mapped_channel: Channel is not full", channel_non_blocking_send(channel, (void*)7) == CHANNEL_FULL);
+
+    /* A blocked sender gets the new room */
+    send_args args;
+    init_object_for_send_api(&args, channel, (char*)7, NULL);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    size_t CAPACITY = 1000000;
+    mu_assert("test_mapped_channel: Grow failed", channel_grow(channel, CAPACITY) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_mapped_channel: Blocked send failed", args.out == SUCCESS);
+    mu_assert("test_mapped_channel: Wrong capacity", buffer_capacity(channel->buffer) == CAPACITY);
+    /* 3 to 7 are queued, fill the rest */
+    for (size_t i = 8; i < CAPACITY + 3; i++) {
+        mu_assert("test_mapped_channel: Send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_mapped_channel: Channel is not full", channel_non_blocking_send(channel, (void*)CAPACITY) == CHANNEL_FULL);
+    for (size_t i = 3; i < CAPACITY + 3; i++) {
+        mu_assert("test_mapped_channel: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_mapped_channel: Received wrong message", (size_t)data == i);
+    }
+    mu_assert("test_mapped_channel: Shrinking was allowed", channel_grow(channel, 10) == GENERIC_ERROR);
+    mu_assert("test_mapped_channel: Wrong footprint", channel_footprint(channel) >= ring_map_size(CAPACITY));
+    channel_close(channel);
+    mu_assert("test_mapped_channel: Closed channel grew", channel_grow(channel, 2 * CAPACITY) == CLOSED_ERROR);
+    mu_assert("test_mapped_channel: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* Only mapped channels can grow */
+    channel = channel_create(4);
+    mu_assert("test_mapped_channel: Plain channel grew", channel_grow(channel, 8) == GENERIC_ERROR);
+    channel_close(channel);
+    channel_destroy(channel);
+    mu_assert("test_mapped_channel: Unbuffered mapped channel was created", channel_create_mapped(0, RING_MAP_DEFAULT) == NULL);
+
+    /* Time to create a large channel and fill it once, which includes faulting its ring in */
+    size_t LARGE = 1 << 21;
+    size_t BATCH = 1024;
+    void* items[BATCH];
+    for (size_t i = 0; i < BATCH; i++) {
+        items[i] = (void*)i;
+    }
+    int FLAGS[] = {-1, RING_MAP_DEFAULT, RING_MAP_PREFAULT, RING_MAP_HUGETLB | RING_MAP_PREFAULT};
+    const char* NAMES[] = {"channel_create", "mapped", "mapped, prefaulted", "mapped, hugetlb, prefaulted"};
+    for (size_t f = 0; f < sizeof(FLAGS) / sizeof(FLAGS[0]); f++) {
+        uint64_t time = getTime();
+        channel = FLAGS[f] < 0 ? channel_create(LARGE) : channel_create_mapped(LARGE, FLAGS[f]);
+        mu_assert("test_mapped_channel: Could not create channel", channel != NULL);
+        uint64_t created = getTime() - time;
+        for (size_t i = 0; i < LARGE; i += BATCH) {
+            size_t sent = 0;
+            mu_assert("test_mapped_channel: Send failed", channel_send_batch(channel, items, BATCH, &sent) == SUCCESS && sent == BATCH);
+        }
+        time = getTime() - time;
+        printf("%s: %.2f ms to create, %.2f ms to create and fill %zu slots\n", NAMES[f], convertTimeToSeconds(created) * 1000, convertTimeToSeconds(time) * 1000, LARGE);
+        channel_close(channel);
+        mu_assert("test_mapped_channel: Destroy failed", channel_destroy(channel) == SUCCESS);
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    bool intact;
+} ref_reader_args;
+
+void* helper_receive_and_release(ref_reader_args* myargs) {
+    void* data = NULL;
+    myargs->intact = false;
+    if (channel_receive(myargs->channel, &data) == SUCCESS) {
+        myargs->intact = string_equal(msg_ref_data(data), "Payload");
+        msg_ref_release(data);
+    }
+    return NULL;
+}
+
+char* test_msg_ref() {
+    print_test_details(__func__, "Testing reference counted fan-out");
+
+    size_t RECEIVERS = 4;
+    msg_pool_t* pool = msg_pool_create(msg_ref_size(64), 4);
+    msg_ref_t* ref = msg_ref_create_pooled(pool);
+    mu_assert("test_msg_ref: Could not create message", ref != NULL);
+    mu_assert("test_msg_ref: Payload is not aligned", ((uintptr_t)msg_ref_data(ref) % 16) == 0);
+    strcpy(msg_ref_data(ref), "Payload");
+
+    /* Every receiver gets its own reference and releases it */
+    channel_t* channels[RECEIVERS];
+    ref_reader_args args[RECEIVERS];
+    pthread_t pid[RECEIVERS];
+    bool delivered[RECEIVERS];
+    for (size_t i = 0; i < RECEIVERS; i++) {
+        channels[i] = channel_create(1);
+        args[i].channel = channels[i];
+    }
+    mu_assert("test_msg_ref: Send failed", msg_ref_send_multi(channels, RECEIVERS, ref, MULTI_BLOCKING, delivered) == SUCCESS);
+    mu_assert("test_msg_ref: Wrong reference count after send", atomic_load(&ref->refs) == 1 + RECEIVERS);
+    for (size_t i = 0; i < RECEIVERS; i++) {
+        pthread_create(&pid[i], NULL, (void *)helper_receive_and_release, &args[i]);
+    }
+    for (size_t i = 0; i < RECEIVERS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_msg_ref: Receiver saw a modified payload", args[i].intact);
+    }
+    mu_assert("test_msg_ref: Receivers did not release", atomic_load(&ref->refs) == 1);
+
+    /* Channels that did not take the message do not keep a reference */
+    mu_assert("test_msg_ref: Send failed", channel_send(channels[0], "Other") == SUCCESS);
+    mu_assert("test_msg_ref: Send was not partial", msg_ref_send_multi(channels, RECEIVERS, ref, MULTI_NON_BLOCKING, delivered) == CHANNEL_FULL);
+    mu_assert("test_msg_ref: Wrong delivery", !delivered[0] && delivered[1]);
+    mu_assert("test_msg_ref: Wrong reference count after partial send", atomic_load(&ref->refs) == RECEIVERS);
+
+    /* Only the selected case of a select takes a reference */
+    select_producer_t producer = msg_ref_producer(ref);
+    void* data = NULL;
+    mu_assert("test_msg_ref: Receive failed", channel_receive(channels[1], &data) == SUCCESS && data == ref);
+    msg_ref_release(data);
+    select_t list[] = {{.channel = channels[2], .dir = SEND_LAZY, .data = &producer},
+                       {.channel = channels[1], .dir = SEND_LAZY, .data = &producer}};
+    size_t index = 0;
+    mu_assert("test_msg_ref: Select failed", channel_select(list, 2, &index) == SUCCESS && index == 1);
+    mu_assert("test_msg_ref: Wrong reference count after select", atomic_load(&ref->refs) == RECEIVERS);
+
+    /* A failed send gives its reference back, closing for writing keeps the queued reference receivable */
+    channel_close_write(channels[3]);
+    mu_assert("test_msg_ref: Send to a closed channel succeeded", msg_ref_send(channels[3], ref) == CLOSED_ERROR);
+    mu_assert("test_msg_ref: Wrong reference count after failed send", atomic_load(&ref->refs) == RECEIVERS);
+
+    /* The last release recycles the message */
+    for (size_t i = 1; i < RECEIVERS; i++) {
+        mu_assert("test_msg_ref: Receive failed", channel_receive(channels[i], &data) == SUCCESS && data == ref);
+        msg_ref_release(data);
+    }
+    mu_assert("test_msg_ref: Wrong reference count before the last release", atomic_load(&ref->refs) == 1);
+    msg_ref_release(ref);
+    msg_ref_t* recycled = msg_ref_create_pooled(pool);
+    mu_assert("test_msg_ref: Message was not recycled", recycled == ref);
+    msg_ref_release(recycled);
+
+    /* Messages without a pool are freed */
+    ref = msg_ref_create(1000);
+    mu_assert("test_msg_ref: Could not create message", ref != NULL && ref->pool == NULL);
+    msg_ref_release(ref);
+
+    for (size_t i = 0; i < RECEIVERS; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    msg_pool_destroy(pool);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    int cpu;
+    size_t count;
+    bool ok;
+} pinned_args;
+
+void* helper_pinned_send(pinned_args* myargs) {
+    myargs->ok = placement_pin(myargs->cpu);
+    for (size_t i = 1; i <= myargs->count; i++) {
+        myargs->ok = myargs->ok && channel_send(myargs->channel, (void*)i) == SUCCESS;
+    }
+    return NULL;
+}
+
+// Returns the messages per second from a sender on sender_cpu to a receiver on receiver_cpu, over a channel on the receiver's node
+double pinned_throughput(int sender_cpu, int receiver_cpu, size_t count) {
+    channel_t* channel = channel_create_on_node(64, placement_cpu_node(receiver_cpu));
+    if (channel == NULL || !placement_pin(receiver_cpu)) {
+        return 0;
+    }
+    pinned_args args = {.channel = channel, .cpu = sender_cpu, .count = count, .ok = false};
+    uint64_t time = getTime();
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_pinned_send, &args);
+    bool ordered = true;
+    for (size_t i = 1; i <= count; i++) {
+        void* data = NULL;
+        ordered = ordered && channel_receive(channel, &data) == SUCCESS && (size_t)data == i;
+    }
+    pthread_join(pid, NULL);
+    time = getTime() - time;
+    channel_close(channel);
+    channel_destroy(channel);
+    return (args.ok && ordered) ? (double)count / convertTimeToSeconds(time) : 0;
+}
+
+char* test_numa_placement() {
+    print_test_details(__func__, "Testing NUMA placement and pinned harnesses");
+
+    /* CHANNEL_CPUS picks the CPUs, by default every online CPU is used */
+    char cpu_list[256];
+    const char* env = getenv("CHANNEL_CPUS");
+    if (env != NULL) {
+        snprintf(cpu_list, sizeof(cpu_list), "%s", env);
+    } else {
+        mu_assert("test_numa_placement: Could not read online CPUs", placement_online_cpus(cpu_list, sizeof(cpu_list)));
+    }
+    int cpus[PLACEMENT_MAX_CPUS];
+    size_t num_cpus = placement_parse_cpus(cpu_list, cpus, PLACEMENT_MAX_CPUS);
+    mu_assert("test_numa_placement: Could not parse CPU list", num_cpus > 0);
+    int parsed[8];
+    mu_assert("test_numa_placement: Wrong CPU list parse", placement_parse_cpus("0-2,5,7-8", parsed, 8) == 6 && parsed[2] == 2 && parsed[3] == 5 && parsed[5] == 8);
+    mu_assert("test_numa_placement: Malformed CPU list was parsed", placement_parse_cpus("3-1", parsed, 8) == 0 && placement_parse_cpus("1,x", parsed, 8) == 0);
+    int node = placement_cpu_node(cpus[0]);
+    mu_assert("test_numa_placement: Unknown node", node >= 0);
+
+    /* Channels placed on a node behave like any other channel */
+    size_t SIZES[] = {0, 1, 4096};
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        channel_t* channel = channel_create_on_node(SIZES[s], node);
+        mu_assert("test_numa_placement: Could not create channel", channel != NULL);
+        void* data = NULL;
+        if (SIZES[s] > 0) {
+            mu_assert("test_numa_placement: Send failed", channel_send(channel, "Message") == SUCCESS);
+            mu_assert("test_numa_placement: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message"));
+        }
+        mu_assert("test_numa_placement: Close failed", channel_close(channel) == SUCCESS);
+        mu_assert("test_numa_placement: Destroy failed", channel_destroy(channel) == SUCCESS);
+    }
+    mu_assert("test_numa_placement: Channel was created on a missing node", channel_create_on_node(1, PLACEMENT_MAX_NODES) == NULL);
+
+    /* Both harnesses with pinned threads and node-local channels */
+    mu_assert("test_numa_placement: Stress harness rejected the CPU list", run_stress_on_cpus(1, 1, "topology.txt", cpu_list));
+    mu_assert("test_numa_placement: Send/receive harness rejected the CPU list", run_stress_send_recv_on_cpus(1, 8, 0.5, 100000, cpu_list));
+    mu_assert("test_numa_placement: Harness accepted an unavailable CPU", !run_stress_on_cpus(1, 1, "topology.txt", "1023"));
+    mu_assert("test_numa_placement: Harness accepted a malformed CPU list", !run_stress_send_recv_on_cpus(1, 8, 0.5, 100000, "1,x"));
+
+    /* Same node and, where the CPU list spans several nodes, cross node throughput */
+    size_t MESSAGES = 200000;
+    int same = cpus[0];
+    int cross = -1;
+    for (size_t i = 1; i < num_cpus; i++) {
+        if (placement_cpu_node(cpus[i]) == node && same == cpus[0]) {
+            same = cpus[i];
+        } else if (placement_cpu_node(cpus[i]) != node && cross < 0) {
+            cross = cpus[i];
+        }
+    }
+    double rate = pinned_throughput(cpus[0], same, MESSAGES);
+    mu_assert("test_numa_placement: Same node transfer failed", rate > 0);
+    printf("same node (cpu %d -> cpu %d): %.0f messages per second\n", cpus[0], same, rate);
+    if (cross >= 0) {
+        rate = pinned_throughput(cpus[0], cross, MESSAGES);
+        mu_assert("test_numa_placement: Cross node transfer failed", rate > 0);
+        printf("cross node (cpu %d -> cpu %d): %.0f messages per second\n", cpus[0], cross, rate);
+    } else {
+        printf("cross node: CPU list %s covers a single node\n", cpu_list);
+    }
+
+    /* Give the main thread back to every CPU of the list */
+    mu_assert("test_numa_placement: Could not unpin", placement_pin_any(cpus, num_cpus));
+    return NULL;
+}
+
+size_t spill_serialize_string(void* data, void* buffer, size_t size, void* ctx) {
+    (void)ctx;
+    size_t length = strlen(data) + 1;
+    if (length <= size) {
+        memcpy(buffer, data, length);
+    }
+    return length;
+}
+
+void* spill_deserialize_string(const void* buffer, size_t size, void* ctx) {
+    (void)ctx;
+    char* data = malloc(size);
+    memcpy(data, buffer, size);
+    return data;
+}
+
+void spill_release_string(void* data, void* ctx) {
+    (void)ctx;
+    free(data);
+}
+
+char* spill_message(size_t i) {
+    char* data = malloc(32);
+    snprintf(data, 32, "Message%zu", i);
+    return data;
+}
+
+typedef struct {
+    channel_spill_t* spill;
+    size_t count;
+    enum channel_status out;
+} spill_args;
+
+void* helper_spill_send(spill_args* myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 0; i < myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_spill_send(myargs->spill, spill_message(i));
+    }
+    return NULL;
+}
+
+char* test_channel_spill() {
+    print_test_details(__func__, "Testing spill to disk overflow");
+
+    channel_serializer_t serializer = {.serialize = spill_serialize_string, .deserialize = spill_deserialize_string, .release = spill_release_string, .ctx = NULL};
+    channel_t* channel = channel_create(4);
+    channel_spill_t* spill = channel_spill_create(channel, &serializer, "/tmp", 16);
+    mu_assert("test_channel_spill: Could not create spill", spill != NULL);
+    channel_t* unbuffered = channel_create(0);
+    mu_assert("test_channel_spill: Spill on an unbuffered channel was created", channel_spill_create(unbuffered, &serializer, "/tmp", 16) == NULL);
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+
+    /* A burst never blocks, the ring stays at its capacity and the rest goes to the file */
+    size_t BURST = 10000;
+    for (size_t i = 0; i < BURST; i++) {
+        mu_assert("test_channel_spill: Send failed", channel_spill_send(spill, spill_message(i)) == SUCCESS);
+    }
+    mu_assert("test_channel_spill: Wrong pending count", channel_spill_pending(spill) == BURST - 4);
+    mu_assert("test_channel_spill: Ring grew", buffer_current_size(channel->buffer) == 4);
+    struct stat file;
+    fstat(spill->fd, &file);
+    mu_assert("test_channel_spill: Nothing was written to the file", file.st_size > 0);
+    /* One large message, bigger than a read chunk */
+    size_t LARGE = 200000;
+    char* large = malloc(LARGE);
+    memset(large, 'x', LARGE - 1);
+    large[LARGE - 1] = '\0';
+    mu_assert("test_channel_spill: Send failed", channel_spill_send(spill, large) == SUCCESS);
+
+    for (size_t i = 0; i < BURST; i++) {
+        void* data = NULL;
+        char expected[32];
+        snprintf(expected, sizeof(expected), "Message%zu", i);
+        mu_assert("test_channel_spill: Receive failed", channel_spill_receive(spill, &data) == SUCCESS);
+        mu_assert("test_channel_spill: Received out of order", string_equal(data, expected));
+        free(data);
+    }
+    void* data = NULL;
+    mu_assert("test_channel_spill: Receive failed", channel_spill_receive(spill, &data) == SUCCESS);
+    mu_assert("test_channel_spill: Large message was corrupted", strlen(data) == LARGE - 1 && ((char*)data)[LARGE - 2] == 'x');
+    free(data);
+    mu_assert("test_channel_spill: Spill was not drained", channel_spill_pending(spill) == 0);
+    fstat(spill->fd, &file);
+    mu_assert("test_channel_spill: File was not reset", file.st_size == 0);
+
+    /* Concurrent producer and consumer keep FIFO order */
+    spill_args args = {.spill = spill, .count = 50000, .out = GENERIC_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_spill_send, &args);
+    for (size_t i = 0; i < args.count; i++) {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "Message%zu", i);
+        mu_assert("test_channel_spill: Receive failed", channel_spill_receive(spill, &data) == SUCCESS);
+        mu_assert("test_channel_spill: Received out of order", string_equal(data, expected));
+        free(data);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_spill: Producer failed", args.out == SUCCESS);
+
+    /* A burst that is still spilled when the channel closes is reported to the producer */
+    for (size_t i = 0; i < 8; i++) {
+        mu_assert("test_channel_spill: Send failed", channel_spill_send(spill, spill_message(i)) == SUCCESS);
+    }
+    channel_close(channel);
+    char* rejected = spill_message(8);
+    mu_assert("test_channel_spill: Send to a closed channel succeeded", channel_spill_send(spill, rejected) == CLOSED_ERROR);
+    free(rejected);
+    mu_assert("test_channel_spill: Receive from a closed channel succeeded", channel_spill_receive(spill, &data) == CLOSED_ERROR);
+
+    /* The messages left in the channel and the spill belong to the caller */
+    while (buffer_remove(channel->buffer, &data) == BUFFER_SUCCESS) {
+        free(data);
+    }
+    channel_spill_destroy(spill);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* log_message(char* out, size_t i) {
+    snprintf(out, 32, "Entry%zu", i);
+    return out;
+}
+
+size_t log_segment_files(const char* dir) {
+    size_t count = 0;
+    DIR* handle = opendir(dir);
+    struct dirent* entry;
+    while (handle != NULL && (entry = readdir(handle)) != NULL) {
+        count += strstr(entry->d_name, ".seg") != NULL;
+    }
+    if (handle != NULL) {
+        closedir(handle);
+    }
+    return count;
+}
+
+typedef struct {
+    log_channel_t* log;
+    const void* data;
+    enum channel_status out;
+} log_args;
+
+void* helper_log_receive(log_args* myargs) {
+    size_t size;
+    myargs->out = log_channel_receive(myargs->log, &myargs->data, &size, NULL);
+    return NULL;
+}
+
+char* test_log_channel() {
+    print_test_details(__func__, "Testing durable memory mapped log channel");
+    const size_t COUNT = 2000;
+    const size_t CONSUMED = 700;
+    char dir[] = "/tmp/log_channel_XXXXXX";
+    mu_assert("test_log_channel: Could not create directory", mkdtemp(dir) != NULL);
+
+    /* Small segments so the log rolls over many times */
+    log_channel_t* log = log_channel_open(dir, 4096, 10);
+    mu_assert("test_log_channel: Could not open log", log != NULL);
+    char expected[32];
+    char large[8192];
+    memset(large, 'x', sizeof(large));
+    mu_assert("test_log_channel: Message larger than a segment was appended", log_channel_send(log, large, sizeof(large)) == GENERIC_ERROR);
+    for (size_t i = 0; i < COUNT; i++) {
+        log_message(expected, i);
+        mu_assert("test_log_channel: Send failed", log_channel_send(log, expected, strlen(expected) + 1) == SUCCESS);
+    }
+    size_t segments = log_segment_files(dir);
+    mu_assert("test_log_channel: Log did not roll over", segments > 1);
+
+    const void* data;
+    size_t size;
+    log_position_t position;
+    for (size_t i = 0; i < CONSUMED; i++) {
+        mu_assert("test_log_channel: Receive failed", log_channel_receive(log, &data, &size, &position) == SUCCESS);
+        log_message(expected, i);
+        mu_assert("test_log_channel: Received out of order", size == strlen(expected) + 1 && string_equal(data, expected));
+    }
+    mu_assert("test_log_channel: Commit failed", log_channel_commit(log, position) == SUCCESS);
+    mu_assert("test_log_channel: Committed segments were kept", log_segment_files(dir) < segments);
+    log_position_t old = {0, 0};
+    mu_assert("test_log_channel: Commit before the last commit succeeded", log_channel_commit(log, old) == GENERIC_ERROR);
+    log_position_t ahead = {position.segment, position.offset + 16};
+    mu_assert("test_log_channel: Commit past the reader succeeded", log_channel_commit(log, ahead) == GENERIC_ERROR);
+    ahead.segment++;
+    ahead.offset = 0;
+    mu_assert("test_log_channel: Commit past the reader succeeded", log_channel_commit(log, ahead) == GENERIC_ERROR);
+    /* Taken but not committed, so replayed after the restart */
+    for (size_t i = CONSUMED; i < CONSUMED + 10; i++) {
+        mu_assert("test_log_channel: Receive failed", log_channel_receive(log, &data, &size, NULL) == SUCCESS);
+    }
+    /* An append that was cut short, as by a crash, has its length but not a matching checksum */
+    log_segment_t* last = (log_segment_t*)list_data(log->write_segment);
+    uint32_t torn[4] = {8, 0, 0x6e726f54, 0};
+    memcpy(last->base + log->write_offset, torn, sizeof(torn));
+    log_channel_destroy(log);
+
+    /* The torn record is cut off on recovery */
+    uint64_t time = getTime();
+    log = log_channel_open(dir, 4096, 10);
+    time = getTime() - time;
+    mu_assert("test_log_channel: Could not reopen log", log != NULL);
+    uint64_t replay = getTime();
+    for (size_t i = CONSUMED; i < COUNT; i++) {
+        mu_assert("test_log_channel: Receive after restart failed", log_channel_receive(log, &data, &size, &position) == SUCCESS);
+        log_message(expected, i);
+        mu_assert("test_log_channel: Replayed out of order", string_equal(data, expected));
+    }
+    replay = getTime() - replay;
+    printf("reopened in %.3f ms, replayed %zu messages in %.3f ms\n", convertTimeToSeconds(time) * 1000, COUNT - CONSUMED, convertTimeToSeconds(replay) * 1000);
+
+    /* A waiting reader gets the next append */
+    pthread_t pid;
+    log_args args = {log, NULL, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void*)helper_log_receive, &args);
+    usleep(10000);
+    mu_assert("test_log_channel: Send failed", log_channel_send(log, "Last", 5) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_log_channel: Waiting receive failed", args.out == SUCCESS && string_equal(args.data, "Last"));
+    mu_assert("test_log_channel: Send failed", log_channel_send(log, "Drained", 8) == SUCCESS);
+    mu_assert("test_log_channel: Sync failed", log_channel_sync(log) == SUCCESS);
+
+    /* A closed log still hands out what it holds */
+    mu_assert("test_log_channel: Close failed", log_channel_close(log) == SUCCESS);
+    mu_assert("test_log_channel: Second close succeeded", log_channel_close(log) == CLOSED_ERROR);
+    mu_assert("test_log_channel: Send to a closed log succeeded", log_channel_send(log, "Rejected", 9) == CLOSED_ERROR);
+    mu_assert("test_log_channel: Receive from a closed log failed", log_channel_receive(log, &data, &size, &position) == SUCCESS && string_equal(data, "Drained"));
+    mu_assert("test_log_channel: Receive from a drained closed log succeeded", log_channel_receive(log, &data, &size, NULL) == CLOSED_ERROR);
+    mu_assert("test_log_channel: Commit failed", log_channel_commit(log, position) == SUCCESS);
+    log_channel_destroy(log);
+
+    /* Everything was committed, so nothing is replayed */
+    log = log_channel_open(dir, 4096, 0);
+    mu_assert("test_log_channel: Could not reopen log", log != NULL);
+    mu_assert("test_log_channel: Send failed", log_channel_send(log, "Fresh", 6) == SUCCESS);
+    mu_assert("test_log_channel: Committed message was replayed", log_channel_receive(log, &data, &size, &position) == SUCCESS && string_equal(data, "Fresh"));
+    mu_assert("test_log_channel: Commit failed", log_channel_commit(log, position) == SUCCESS);
+
+    /* The commit reached the disk but the data it covers did not, as the kernel may write the pages back in any order */
+    mu_assert("test_log_channel: Send failed", log_channel_send(log, "Lost before the commit", 23) == SUCCESS);
+    log_position_t lost;
+    mu_assert("test_log_channel: Receive failed", log_channel_receive(log, &data, &size, &lost) == SUCCESS);
+    mu_assert("test_log_channel: Commit failed", log_channel_commit(log, lost) == SUCCESS);
+    last = (log_segment_t*)list_data(log->write_segment);
+    memset(last->base + position.offset, 0, lost.offset - position.offset);
+    log_channel_destroy(log);
+
+    /* The reader resumes where the data ends instead of past it, so the next append is not skipped */
+    log = log_channel_open(dir, 4096, 0);
+    mu_assert("test_log_channel: Could not reopen log", log != NULL);
+    mu_assert("test_log_channel: Reader resumed past the data", log->read_offset == log->write_offset);
+    mu_assert("test_log_channel: Send failed", log_channel_send(log, "After", 6) == SUCCESS);
+    mu_assert("test_log_channel: Close failed", log_channel_close(log) == SUCCESS);
+    mu_assert("test_log_channel: Append after recovery was skipped", log_channel_receive(log, &data, &size, NULL) == SUCCESS && string_equal(data, "After"));
+    log_channel_destroy(log);
+
+    DIR* handle = opendir(dir);
+    struct dirent* entry;
+    char path[512];
+    while ((entry = readdir(handle)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(handle);
+    rmdir(dir);
+    return NULL;
+}
+
+typedef struct {
+    size_t sequence;
+    char text[20];
+} shared_message_t;
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+    size_t received;
+} shared_args;
+
+void* helper_shared_baseline_receive(shared_args* myargs) {
+    void* data;
+    while (channel_receive(myargs->channel, &data) == SUCCESS) {
+        myargs->received += (size_t)data == myargs->received;
+    }
+    return NULL;
+}
+
+char* test_shared_channel() {
+    print_test_details(__func__, "Testing shared memory channel across processes");
+    const size_t COUNT = 200000;
+    const size_t CAPACITY = 256;
+    char name[64];
+    snprintf(name, sizeof(name), "/channel_test_%d", (int)getpid());
+
+    shared_channel_t* channel = channel_create_shared(name, CAPACITY, sizeof(shared_message_t));
+    mu_assert("test_shared_channel: Could not create channel", channel != NULL);
+    mu_assert("test_shared_channel: Channel with the same name was created", channel_create_shared(name, CAPACITY, sizeof(shared_message_t)) == NULL);
+    mu_assert("test_shared_channel: Attached to a missing channel", channel_attach_shared("/channel_test_missing") == NULL);
+
+    /* Keeps the child from printing what is still buffered */
+    fflush(stdout);
+    uint64_t time = getTime();
+    pid_t child = fork();
+    mu_assert("test_shared_channel: Fork failed", child >= 0);
+    if (child == 0) {
+        /* The child only knows the name, as an unrelated process would */
+        shared_channel_t* attached = channel_attach_shared(name);
+        if (attached == NULL) {
+            _exit(2);
+        }
+        shared_message_t message;
+        size_t received = 0;
+        while (channel_shared_receive(attached, &message) == SUCCESS) {
+            char expected[20];
+            snprintf(expected, sizeof(expected), "Message%zu", received);
+            if (message.sequence != received || strcmp(message.text, expected) != 0) {
+                _exit(3);
+            }
+            received++;
+        }
+        channel_shared_detach(attached);
+        _exit(received == COUNT ? 0 : 4);
+    }
+
+    shared_message_t message;
+    for (size_t i = 0; i < COUNT; i++) {
+        message.sequence = i;
+        snprintf(message.text, sizeof(message.text), "Message%zu", i);
+        mu_assert("test_shared_channel: Send failed", channel_shared_send(channel, &message) == SUCCESS);
+    }
+    mu_assert("test_shared_channel: Close failed", channel_shared_close(channel) == SUCCESS);
+    int status;
+    mu_assert("test_shared_channel: Wait failed", waitpid(child, &status, 0) == child);
+    time = getTime() - time;
+    mu_assert("test_shared_channel: Child did not receive every message in order", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    double shared_rate = (double)COUNT / convertTimeToSeconds(time);
+
+    mu_assert("test_shared_channel: Second close succeeded", channel_shared_close(channel) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Send to a closed channel succeeded", channel_shared_send(channel, &message) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Receive from a drained closed channel succeeded", channel_shared_receive(channel, &message) == CLOSED_ERROR);
+    channel_shared_detach(channel);
+    mu_assert("test_shared_channel: Unlink failed", channel_shared_unlink(name) == SUCCESS);
+    mu_assert("test_shared_channel: Attached to an unlinked channel", channel_attach_shared(name) == NULL);
+
+    /* The same traffic through an in-process channel between two threads */
+    shared_args args = {channel_create(CAPACITY), COUNT, 0};
+    time = getTime();
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void*)helper_shared_baseline_receive, &args);
+    for (size_t i = 0; i < COUNT; i++) {
+        mu_assert("test_shared_channel: Send failed", channel_send(args.channel, (void*)i) == SUCCESS);
+    }
+    channel_close_write(args.channel);
+    pthread_join(pid, NULL);
+    time = getTime() - time;
+    mu_assert("test_shared_channel: In-process receive lost messages", args.received == COUNT);
+    channel_destroy(args.channel);
+    printf("across processes: %.0f messages per second, in process: %.0f messages per second\n", shared_rate, (double)COUNT / convertTimeToSeconds(time));
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+    enum channel_status out;
+} bridge_args;
+
+void* helper_bridge_produce(bridge_args* myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 0; i < myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_send(myargs->channel, spill_message(i));
+    }
+    channel_close_write(myargs->channel);
+    return NULL;
+}
+
+// Sends count messages into src from another thread and receives them in order from dst, returns the seconds taken or -1
+double bridge_run(channel_t* src, channel_t* dst, size_t count) {
+    bridge_args args = {src, count, GENERIC_ERROR};
+    uint64_t time = getTime();
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void*)helper_bridge_produce, &args);
+    void* data;
+    size_t received = 0;
+    bool ordered = true;
+    char expected[32];
+    while (channel_receive(dst, &data) == SUCCESS) {
+        snprintf(expected, sizeof(expected), "Message%zu", received++);
+        ordered = ordered && string_equal(data, expected);
+        free(data);
+    }
+    pthread_join(pid, NULL);
+    time = getTime() - time;
+    return args.out == SUCCESS && ordered && received == count ? convertTimeToSeconds(time) : -1;
+}
+
+// Returns the average seconds from sending a message into src to receiving it from dst, one message at a time
+double bridge_latency(channel_t* src, channel_t* dst, size_t count) {
+    uint64_t time = getTime();
+    for (size_t i = 0; i < count; i++) {
+        void* data;
+        if (channel_send(src, spill_message(i)) != SUCCESS || channel_receive(dst, &data) != SUCCESS) {
+            return -1;
+        }
+        free(data);
+    }
+    return convertTimeToSeconds(getTime() - time) / (double)count;
+}
+
+char* test_channel_bridge() {
+    print_test_details(__func__, "Testing channel bridge over unix domain sockets");
+    const size_t COUNT = 100000;
+    const size_t PINGS = 2000;
+    channel_bridge_config_t config = {{spill_serialize_string, spill_deserialize_string, spill_release_string, NULL}, CHANNEL_FRAMING_DATAGRAM, 64, 32};
+    int TYPES[] = {SOCK_SEQPACKET, SOCK_STREAM};
+    enum channel_framing FRAMINGS[] = {CHANNEL_FRAMING_DATAGRAM, CHANNEL_FRAMING_LENGTH};
+    const char* NAMES[] = {"seqpacket", "stream"};
+
+    channel_t* unbuffered = channel_create(0);
+    mu_assert("test_channel_bridge: Bridge on an unbuffered channel was started", channel_bridge_sender(unbuffered, 0, &config) == NULL);
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+
+    for (size_t t = 0; t < 2; t++) {
+        int fds[2];
+        mu_assert("test_channel_bridge: Could not create socket pair", socketpair(AF_UNIX, TYPES[t], 0, fds) == 0);
+        config.framing = FRAMINGS[t];
+        channel_t* src = channel_create(256);
+        channel_t* dst = channel_create(256);
+        channel_bridge_t* sender = channel_bridge_sender(src, fds[0], &config);
+        channel_bridge_t* receiver = channel_bridge_receiver(dst, fds[1], &config);
+        mu_assert("test_channel_bridge: Could not start bridge", sender != NULL && receiver != NULL);
+
+        double latency = bridge_latency(src, dst, PINGS);
+        mu_assert("test_channel_bridge: Latency run failed", latency >= 0);
+        double seconds = bridge_run(src, dst, COUNT);
+        mu_assert("test_channel_bridge: Messages were lost or reordered", seconds >= 0);
+        printf("%s bridge: %.0f messages per second, %.2f us latency\n", NAMES[t], (double)COUNT / seconds, latency * 1e6);
+
+        size_t moved;
+        mu_assert("test_channel_bridge: Sender did not stop on close", channel_bridge_stop(sender, &moved) == CLOSED_ERROR);
+        mu_assert("test_channel_bridge: Sender moved the wrong count", moved == COUNT + PINGS);
+        mu_assert("test_channel_bridge: Receiver did not stop on shutdown", channel_bridge_stop(receiver, &moved) == CLOSED_ERROR);
+        mu_assert("test_channel_bridge: Receiver moved the wrong count", moved == COUNT + PINGS);
+        channel_close(src);
+        channel_close(dst);
+        channel_destroy(src);
+        channel_destroy(dst);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* The same traffic through one channel directly */
+    channel_t* direct = channel_create(256);
+    double latency = bridge_latency(direct, direct, PINGS);
+    double seconds = bridge_run(direct, direct, COUNT);
+    mu_assert("test_channel_bridge: Direct run failed", latency >= 0 && seconds >= 0);
+    printf("direct channel: %.0f messages per second, %.2f us latency\n", (double)COUNT / seconds, latency * 1e6);
+    channel_close(direct);
+    channel_destroy(direct);
+
+    /* A message larger than a frame stops the bridge and closes its channel */
+    int fds[2];
+    mu_assert("test_channel_bridge: Could not create socket pair", socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0);
+    config.framing = CHANNEL_FRAMING_DATAGRAM;
+    channel_t* src = channel_create(4);
+    channel_t* dst = channel_create(4);
+    channel_bridge_t* sender = channel_bridge_sender(src, fds[0], &config);
+    channel_bridge_t* receiver = channel_bridge_receiver(dst, fds[1], &config);
+    char* large = malloc(128);
+    memset(large, 'x', 127);
+    large[127] = '\0';
+    mu_assert("test_channel_bridge: Send failed", channel_send(src, large) == SUCCESS);
+    mu_assert("test_channel_bridge: Sender did not fail", channel_bridge_stop(sender, NULL) == GENERIC_ERROR);
+    mu_assert("test_channel_bridge: Send to a failed bridge succeeded", channel_send(src, NULL) == CLOSED_ERROR);
+    mu_assert("test_channel_bridge: Receiver did not stop", channel_bridge_stop(receiver, NULL) == CLOSED_ERROR);
+    void* data;
+    mu_assert("test_channel_bridge: Receive after the bridge stopped succeeded", channel_receive(dst, &data) == CLOSED_ERROR);
+    channel_close(dst);
+    channel_destroy(src);
+    channel_destroy(dst);
+    close(fds[0]);
+    close(fds[1]);
+    return NULL;
+}
+
 typedef char* (*test_fn_t)();
 typedef struct {
     char* name;
@@ -2065,6 +4387,31 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_select_mixed_size1_size0", test_select_mixed_size1_size0},
                   {"test_stress_size0", test_stress_size0},
                   {"test_stress_mixed_size1_size0", test_stress_mixed_size1_size0},
+                  {"test_select_fairness", test_select_fairness},
+                  {"test_select_until", test_select_until},
+                  {"test_send_receive_until", test_send_receive_until},
+                  {"test_select_lazy_send", test_select_lazy_send},
+                  {"test_send_balanced", test_send_balanced},
+                  {"test_batch_send_receive", test_batch_send_receive},
+                  {"test_send_multi", test_send_multi},
+                  {"test_broadcast", test_broadcast},
+                  {"test_send_keyed", test_send_keyed},
+                  {"test_watch", test_watch},
+                  {"test_channel_writer", test_channel_writer},
+                  {"test_channel_forward", test_channel_forward},
+                  {"test_close_write", test_close_write},
+                  {"test_endpoint_handles", test_endpoint_handles},
+                  {"test_channel_call", test_channel_call},
+                  {"test_msg_pool", test_msg_pool},
+                  {"test_channel_churn", test_channel_churn},
+                  {"test_channel_footprint", test_channel_footprint},
+                  {"test_mapped_channel", test_mapped_channel},
+                  {"test_msg_ref", test_msg_ref},
+                  {"test_numa_placement", test_numa_placement},
+                  {"test_channel_spill", test_channel_spill},
+                  {"test_log_channel", test_log_channel},
+                  {"test_shared_channel", test_shared_channel},
+                  {"test_channel_bridge", test_channel_bridge},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
@@ -0,0 +1,172 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "watch.h"
+
+// Number of failed snapshot attempts after which a reader yields to let a preempted writer finish
+#define WATCH_SPINS 64
+
+// Copies size bytes from value into the watch's words with relaxed atomic stores
+void watch_store_value(watch_t* watch, const void* value)
+{
+    const unsigned char* bytes = (const unsigned char*) value;
+    for (size_t i = 0; i < watch->words; i++) {
+        uint64_t word = 0;
+        size_t offset = i * sizeof(uint64_t);
+        size_t length = watch->size - offset < sizeof(uint64_t) ? watch->size - offset : sizeof(uint64_t);
+        memcpy(&word, bytes + offset, length);
+        __atomic_store_n(&watch->value[i], word, __ATOMIC_RELAXED);
+    }
+}
+
+// Copies size bytes out of the watch's words with relaxed atomic loads
+void watch_load_value(watch_t* watch, void* out)
+{
+    unsigned char* bytes = (unsigned char*) out;
+    for (size_t i = 0; i < watch->words; i++) {
+        uint64_t word = __atomic_load_n(&watch->value[i], __ATOMIC_RELAXED);
+        size_t offset = i * sizeof(uint64_t);
+        size_t length = watch->size - offset < sizeof(uint64_t) ? watch->size - offset : sizeof(uint64_t);
+        memcpy(bytes + offset, &word, length);
+    }
+}
+
+// Creates a new watch for values of size bytes, starting at version 0 with a copy of initial
+watch_t* watch_create(size_t size, const void* initial)
+{
+    if (size == 0) {
+        return NULL;
+    }
+
+    size_t words = (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    // aligned_alloc needs a multiple of the alignment
+    size_t bytes = sizeof(watch_t) + words * sizeof(uint64_t);
+    bytes = (bytes + WATCH_CACHE_LINE - 1) / WATCH_CACHE_LINE * WATCH_CACHE_LINE;
+    watch_t* watch = (watch_t*) aligned_alloc(WATCH_CACHE_LINE, bytes);
+    if (watch == NULL) {
+        return NULL;
+    }
+
+    watch->size = size;
+    watch->words = words;
+    atomic_init(&watch->sequence, 0);
+    pthread_mutex_init(&watch->mutex, NULL);
+    pthread_cond_init(&watch->cond_published, NULL);
+    atomic_init(&watch->readers_waiting, 0);
+    atomic_init(&watch->is_closed, false);
+    watch_store_value(watch, initial);
+
+    return watch;
+}
+
+// Publishes a copy of value as the next version
+enum channel_status watch_publish(watch_t* watch, const void* value)
+{
+    if (atomic_load_explicit(&watch->is_closed, memory_order_relaxed)) {
+        return CLOSED_ERROR;
+    }
+
+    // only the writer changes the sequence, so it can be read without synchronization
+    size_t sequence = atomic_load_explicit(&watch->sequence, memory_order_relaxed);
+    atomic_store_explicit(&watch->sequence, sequence + 1, memory_order_relaxed);
+    // keeps the value stores from becoming visible before the odd sequence
+    atomic_thread_fence(memory_order_release);
+    watch_store_value(watch, value);
+    atomic_store_explicit(&watch->sequence, sequence + 2, memory_order_release);
+
+    // pairs with the increment of readers_waiting in watch_wait, so either the reader sees the new sequence or we see the reader
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&watch->readers_waiting, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&watch->mutex);
+        pthread_cond_broadcast(&watch->cond_published);
+        pthread_mutex_unlock(&watch->mutex);
+    }
+
+    return SUCCESS;
+}
+
+// Takes a consistent snapshot of the value and returns its version
+size_t watch_snapshot(watch_t* watch, void* out)
+{
+    for (size_t attempt = 1; ; attempt++) {
+        size_t before = atomic_load_explicit(&watch->sequence, memory_order_acquire);
+        if ((before & 1) == 0) {
+            watch_load_value(watch, out);
+            // keeps the value loads from being reordered after the second sequence load
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&watch->sequence, memory_order_relaxed) == before) {
+                return before / 2;
+            }
+        }
+        if (attempt % WATCH_SPINS == 0) {
+            sched_yield();
+        }
+    }
+}
+
+// Copies a consistent snapshot of the latest value into out
+enum channel_status watch_read(watch_t* watch, void* out, size_t* version)
+{
+    size_t snapshot = watch_snapshot(watch, out);
+    if (version != NULL) {
+        *version = snapshot;
+    }
+    return SUCCESS;
+}
+
+// Waits until a version newer than *version is published, then copies a snapshot of it into out
+enum channel_status watch_wait(watch_t* watch, void* out, size_t* version)
+{
+    if (version == NULL) {
+        return GENERIC_ERROR;
+    }
+
+    if (atomic_load(&watch->sequence) / 2 == *version) {
+        pthread_mutex_lock(&watch->mutex);
+        atomic_fetch_add(&watch->readers_waiting, 1);
+        while (atomic_load(&watch->sequence) / 2 == *version && !atomic_load(&watch->is_closed)) {
+            pthread_cond_wait(&watch->cond_published, &watch->mutex);
+        }
+        atomic_fetch_sub(&watch->readers_waiting, 1);
+        pthread_mutex_unlock(&watch->mutex);
+    }
+
+    // the writer may have started the next version already, in which case the snapshot waits for it
+    size_t snapshot = watch_snapshot(watch, out);
+    if (snapshot == *version) {
+        return CLOSED_ERROR;
+    }
+    *version = snapshot;
+    return SUCCESS;
+}
+
+// Closes the watch and wakes up every waiting reader
+enum channel_status watch_close(watch_t* watch)
+{
+    pthread_mutex_lock(&watch->mutex);
+
+    if (atomic_load(&watch->is_closed)) {
+        pthread_mutex_unlock(&watch->mutex);
+        return CLOSED_ERROR;
+    }
+    atomic_store(&watch->is_closed, true);
+    pthread_cond_broadcast(&watch->cond_published);
+
+    pthread_mutex_unlock(&watch->mutex);
+
+    return SUCCESS;
+}
+
+// Frees all the memory allocated to the watch
+enum channel_status watch_destroy(watch_t* watch)
+{
+    if (!atomic_load(&watch->is_closed)) {
+        return DESTROY_ERROR;
+    }
+
+    pthread_cond_destroy(&watch->cond_published);
+    pthread_mutex_destroy(&watch->mutex);
+    free(watch);
+
+    return SUCCESS;
+}
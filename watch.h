@@ -0,0 +1,61 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "channel.h"
+
+#define WATCH_CACHE_LINE 64
+
+// Defines a watch: a single writer publishes the latest value of a fixed size state, and any number of readers take snapshots of it
+// The value is guarded by a sequence lock, so the writer never waits for readers and readers never take a lock to read
+typedef struct {
+    // size of the value in bytes, and in the 8 byte words it is stored as
+    size_t size;
+    size_t words;
+    // odd while the writer is copying a new value in, the number of publishes is sequence / 2
+    _Alignas(WATCH_CACHE_LINE) atomic_size_t sequence;
+    // only used by readers that wait for a new version
+    _Alignas(WATCH_CACHE_LINE) pthread_mutex_t mutex;
+    pthread_cond_t cond_published;
+    atomic_size_t readers_waiting;
+    atomic_bool is_closed;
+    // the value, only accessed through relaxed atomic word copies since readers may race with the writer
+    _Alignas(WATCH_CACHE_LINE) uint64_t value[];
+} watch_t;
+
+// Creates a new watch for values of size bytes, starting at version 0 with a copy of initial, and returns it to the caller
+// Returns NULL if size is 0 or on an allocation failure
+watch_t* watch_create(size_t size, const void* initial);
+
+// Publishes a copy of value as the next version
+// There must be a single writer, i.e. publish must not be called from several threads at once
+// This call never waits for readers, and its cost does not depend on how many readers there are
+// Returns SUCCESS if the value was published and CLOSED_ERROR if the watch is closed
+enum channel_status watch_publish(watch_t* watch, const void* value);
+
+// Copies a consistent snapshot of the latest value into out, retrying if the writer published while it was copied
+// version, unless NULL, is set to the version of the snapshot
+// This works on a closed watch as well, and returns SUCCESS
+enum channel_status watch_read(watch_t* watch, void* out, size_t* version);
+
+// Waits until a version newer than *version is published, then copies a snapshot of it into out and stores its version in *version
+// Returns immediately if a newer version is already available
+// Returns SUCCESS for a successful snapshot,
+// CLOSED_ERROR if the watch was closed and no newer version is available, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status watch_wait(watch_t* watch, void* out, size_t* version);
+
+// Closes the watch and wakes up every waiting reader
+// Returns SUCCESS if close is successful and CLOSED_ERROR if the watch is already closed
+enum channel_status watch_close(watch_t* watch);
+
+// Frees all the memory allocated to the watch
+// The caller is responsible for calling watch_close and waiting for all threads to finish before calling watch_destroy
+// Returns SUCCESS if destroy is successful and DESTROY_ERROR if the watch is still open
+enum channel_status watch_destroy(watch_t* watch);
+
+#endif // WATCH_H
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include "writer.h"
+
+// Creates a writer for the given channel that stages up to capacity messages
+channel_writer_t* channel_writer_create(channel_t* channel, size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    channel_writer_t* writer = (channel_writer_t*) malloc(sizeof(channel_writer_t));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->items = (void**) malloc(capacity * sizeof(void*));
+    if (writer->items == NULL) {
+        free(writer);
+        return NULL;
+    }
+    writer->channel = channel;
+    writer->capacity = capacity;
+    writer->count = 0;
+
+    return writer;
+}
+
+// Shared implementation of channel_writer_flush and channel_writer_try_flush
+// If block is true the call waits for room with a single channel_send whenever a batch finds the channel full
+enum channel_status channel_writer_drain(channel_writer_t* writer, bool block)
+{
+    size_t head = 0;
+    enum channel_status status = SUCCESS;
+
+    while (head < writer->count) {
+        size_t sent = 0;
+        status = channel_send_batch(writer->channel, &writer->items[head], writer->count - head, &sent);
+        head += sent;
+        if (status == CHANNEL_FULL && block) {
+            // about to block: everything that fit is already written, so only the next message waits for room
+            status = channel_send(writer->channel, writer->items[head]);
+            if (status == SUCCESS) {
+                head++;
+            }
+        }
+        if (status != SUCCESS) {
+            break;
+        }
+    }
+
+    // keep whatever was not written at the front, in order
+    writer->count -= head;
+    memmove(writer->items, &writer->items[head], writer->count * sizeof(void*));
+
+    return status;
+}
+
+// Stages data to be written to the writer's channel, flushing first if the stage is full
+enum channel_status channel_writer_send(channel_writer_t* writer, void* data)
+{
+    if (writer->count == writer->capacity) {
+        enum channel_status status = channel_writer_drain(writer, true);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+
+    writer->items[writer->count++] = data;
+    return SUCCESS;
+}
+
+// Writes every staged message to the channel in FIFO order, waiting for room if needed
+enum channel_status channel_writer_flush(channel_writer_t* writer)
+{
+    return channel_writer_drain(writer, true);
+}
+
+// Writes as many staged messages as the channel has room for, without waiting
+enum channel_status channel_writer_try_flush(channel_writer_t* writer)
+{
+    return channel_writer_drain(writer, false);
+}
+
+// Returns the number of messages that are staged and not written to the channel yet
+size_t channel_writer_pending(channel_writer_t* writer)
+{
+    return writer->count;
+}
+
+// Frees the writer without flushing it
+void channel_writer_destroy(channel_writer_t* writer)
+{
+    free(writer->items);
+    free(writer);
+}
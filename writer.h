@@ -0,0 +1,48 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+#include "channel.h"
+
+// Defines a producer handle that stages messages and writes them to its channel in bulk
+// Staging is private to the handle, so a writer must only be used by one thread at a time
+// Staged messages are not visible to receivers until they are flushed
+typedef struct {
+    channel_t* channel;
+    void** items;
+    size_t capacity;
+    size_t count;
+} channel_writer_t;
+
+// Creates a writer for the given channel that stages up to capacity messages, and returns it to the caller
+// Returns NULL if capacity is 0 or on an allocation failure
+channel_writer_t* channel_writer_create(channel_t* channel, size_t capacity);
+
+// Stages data to be written to the writer's channel
+// Once capacity messages are staged they are flushed, so this call only blocks when the channel has no room for them
+// Returns SUCCESS if data was staged,
+// CLOSED_ERROR if a flush found the channel closed, in which case data is not staged, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_writer_send(channel_writer_t* writer, void* data);
+
+// Writes every staged message to the channel in FIFO order, with as few lock acquisitions and wakeups as the channel's room allows
+// This is a blocking call that waits for room in the channel, so it should also be called before the producer waits on anything else
+// Returns SUCCESS if every staged message was written,
+// CLOSED_ERROR if the channel is closed, in which case the messages that were not written stay staged, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_writer_flush(channel_writer_t* writer);
+
+// Same as channel_writer_flush, except that it writes as many staged messages as the channel has room for and never waits
+// Returns SUCCESS if every staged message was written,
+// CHANNEL_FULL if some messages are still staged,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_writer_try_flush(channel_writer_t* writer);
+
+// Returns the number of messages that are staged and not written to the channel yet
+size_t channel_writer_pending(channel_writer_t* writer);
+
+// Frees the writer without flushing it, the caller owns any message that is still staged
+void channel_writer_destroy(channel_writer_t* writer);
+
+#endif // WRITER_H